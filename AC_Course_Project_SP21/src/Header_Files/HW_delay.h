@@ -10,6 +10,7 @@
 
 #include "em_timer.h"
 #include "em_cmu.h"
+#include "timebase.h"
 
 void timer_delay(uint32_t ms_delay);
 
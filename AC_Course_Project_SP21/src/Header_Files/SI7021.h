@@ -19,6 +19,7 @@
 #include "i2c.h"
 #include "brd_config.h"
 #include "app.h"
+#include "sensor.h"
 
 
 //***********************************************************************************
@@ -46,14 +47,41 @@
 #define RES_CONFIG				0x01
 #define RES_8_12_BIT			0x3B
 
+#define SI7021_WRITE_HEATER_REG	0x51
+#define SI7021_READ_HEATER_REG	0x11
+#define SI7021_USER_RES_MASK	0x81		// RES1 is D7, RES0 is D0
+#define SI7021_USER_HTRE		0x04		// on-chip heater enable
+#define SI7021_HEATER_MASK		0x0F		// heater current, 3.09 mA to 94.20 mA
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef enum {
+	Si7021ResRh12T14 = 0x00,		// power-on default
+	Si7021ResRh8T12 = 0x01,
+	Si7021ResRh10T13 = 0x80,
+	Si7021ResRh11T11 = 0x81
+} SI7021_RESOLUTION;
+
 //***********************************************************************************
 // function prototypes
 //***********************************************************************************
 void si7021_i2c_open(void);
 void si7021_read(uint32_t SI7021_read_cb);
+void si7021_arm(uint32_t SI7021_read_cb);
 void si7021_temp_read(uint32_t SI7021_read_cb);
+void si7021_measure_start(void);
+void si7021_fetch(uint32_t SI7021_read_cb);
+void si7021_set_resolution(SI7021_RESOLUTION resolution);
+SI7021_RESOLUTION si7021_get_resolution(void);
+void si7021_set_heater(bool enable, uint32_t level);
+uint32_t si7021_conversion_ms(void);
+uint32_t si7021_resolution_ms(SI7021_RESOLUTION resolution);
 float si7021_humidity_conversion();
 float temperature_calculation();
 bool i2c_test(uint32_t si7021_read_cb);
 
+extern const SENSOR_DESC si7021_humidity_sensor;
+extern const SENSOR_DESC si7021_temperature_sensor;
+
 #endif /* SRC_HEADER_FILES_SI7021_H_ */
@@ -22,6 +22,16 @@
 #define BLE_RX_DONE_CB			0x40
 #define VEML_CB					0x80
 #define SI7021_TEMP_READ_CB 	0x100
+#define SAMPLE_DONE_CB			0x200
+#define SENSOR_MEASURE_CB		0x400
+#define VEML_INT_CB				0x800
+#define SCHED_DUE_CB			0x1000
+#define SENSOR_READY_CB			0x2000
+#define BLE_LINK_CB				0x4000
+#define BLE_DRAIN_CB			0x8000
+#define QUERY_TX_CB				0x10000
+#define BURST_TICK_CB			0x20000
+#define BURST_READ_CB			0x40000
 
 /* Silicon Labs include statements */
 #include "em_cmu.h"
@@ -40,20 +50,104 @@
 #include "HW_delay.h"
 #include "stdio.h"
 #include "veml.h"
+#include "rate_ctrl.h"
+#include "timebase.h"
+#include "sensor.h"
+#include "sample_sched.h"
+#include "journal.h"
+#include "query.h"
+#include "rollup.h"
+#include "sample_codec.h"
+#include "report_filter.h"
+#include "filter.h"
+#include "flicker.h"
+#include "comfort.h"
+#include "energy_gov.h"
+#include "energy_levels.h"
+#include "supply.h"
 
 
 //***********************************************************************************
 // defined files
 //***********************************************************************************
-#define		PWM_PER				1.8		// PWM period in seconds
+#define		PWM_PER				(ENERGY_PERIOD_MS / 1000.0)	// PWM period in seconds
 #define		PWM_ACT_PER			0.25	// PWM active period in seconds
 
 #define		DELAY				2000	// scheduled_boot_up_cb timer delay
 #define		SYSTEM_BLOCK_EM		EM3
 
+// Runtime configuration, changed over BLE with the commands in cmd_parser.h
+#define		APP_SENSOR_SI7021	0x01
+#define		APP_SENSOR_VEML		0x02
+#define		APP_SENSOR_ALL		(APP_SENSOR_SI7021 | APP_SENSOR_VEML)
+
+#define		APP_PERIOD_MIN_MS	500		// must stay above PWM_ACT_PER and the sensor read chain
+#define		APP_PERIOD_MAX_MS	60000	// 16-bit LETIMER COMP0 at LETIMER_HZ, see app_period_max_ms()
+#define		APP_BATCH_MAX		8		// samples per BLE frame
+#define		APP_FRAME_SIZE		512		// bytes per BLE telemetry frame
+#define		APP_FRESH_MS		2000	// default age of a cached reading served to #READ
+#define		APP_DRAIN_FRAME_SIZE	2048	// bytes per BLE frame of journal backlog, see LEUART_TX_MAX_DESCRIPTORS
+#define		APP_JOURNAL_FLUSH_MS	60000	// longest a sample waits in RAM for the flash journal
+#define		APP_JOURNAL_LOW_MV		(ENERGY_CUTOFF_MV + 200)	// below this every sample is flushed
+
+// Adaptive sample rate, channel values are fixed point
+#define		RATE_CH_HUMIDITY		SENSOR_HUMIDITY			// 0.1 %RH
+#define		RATE_CH_TEMPERATURE		SENSOR_TEMPERATURE		// 0.1 F
+#define		RATE_CH_LIGHT			SENSOR_LIGHT			// lux
+#define		RATE_HUMIDITY_THR		10		// 1.0 %RH
+#define		RATE_TEMPERATURE_THR	5		// 0.5 F
+#define		RATE_LIGHT_THR			5		// lux
+#define		RATE_LIGHT_THR_PCT		10		// %
+#define		RATE_STABLE_SAMPLES		5		// stable samples before the period doubles
+#define		RATE_MAX_PERIOD_MS		28800	// 16 x PWM_PER
+
+// Report-on-change deadbands, in the rate controller's channel units
+#define		REPORT_HUMIDITY_BAND	5		// 0.5 %RH
+#define		REPORT_TEMPERATURE_BAND	2		// 0.2 F
+#define		REPORT_LIGHT_BAND		1		// lux
+#define		REPORT_LIGHT_BAND_PCT	5		// %
+#define		REPORT_MAX_SILENCE_MS	60000	// heartbeat, every reading is reported at least this often
+
+// Smoothing of the humidity that drives the LED1 threshold, in 0.1 %RH
+#define		LED_HUMIDITY_THR		300		// 30.0 %RH
+#define		LED_FILTER				FilterMedian5
+#define		LED_FILTER_EMA_ALPHA	8192	// 0.25, Q15
+#define		LED_FILTER_BOXCAR_TAPS	4
+
+#define		BURST_SAMPLES			256		// light readings per #BURST, 6.4 s at 25 ms
+
+// Comfort metrics are derived from one humidity and temperature pair
+#define		APP_COMFORT_SENSORS		((1 << SENSOR_HUMIDITY) | (1 << SENSOR_TEMPERATURE))
+
+// VEML7700 setup, a PSM refresh of IT + 500 ms, 600 ms here and up to 1300 ms once
+// auto-ranged to 800 ms, keeps up with PWM_PER and SCHED_VEML_PERIOD_MS.  Periods
+// shorter than the refresh, down to APP_PERIOD_MIN_MS, re-read the last conversion.
+#define		VEML_DEFAULT_GAIN		VemlGain1
+#define		VEML_DEFAULT_IT			VemlIt100
+#define		VEML_PSM_ENABLED		true
+#define		VEML_DEFAULT_PSM		VemlPsm500
+
+// VEML threshold interrupt, the LETIMER0 only runs a heartbeat sample
+#define		VEML_WINDOW_PCT			10		// interrupt once the light moves this far
+#define		VEML_HEARTBEAT_MS		30000	// LETIMER0 period with the VEML interrupt active
+
+// Multi-rate schedule, humidity and temperature drift slowly while light changes in seconds
+#define		SCHED_SI7021_PERIOD_MS	10000
+#define		SCHED_SI7021_PHASE_MS	0
+#define		SCHED_VEML_PERIOD_MS	2000
+#define		SCHED_VEML_PHASE_MS		0		// every fifth light sample shares the SI7021 wake
+
 //***********************************************************************************
 // global variables
 //***********************************************************************************
+typedef struct {
+	uint32_t		period_ms;			// LETIMER0 sample period
+	uint32_t		batch_size;			// samples collected before a BLE frame is sent
+	uint32_t		sensor_en;			// APP_SENSOR_xxx bit mask of sensors sampled
+	uint32_t		si7021_period_ms;	// SI7021 period of the multi-rate schedule
+	uint32_t		veml_period_ms;		// VEML7700 period of the multi-rate schedule
+	uint32_t		fresh_ms;			// freshness window of the sensor cache
+} APP_CONFIG;
 
 
 //***********************************************************************************
@@ -67,7 +161,18 @@ void scheduled_letimer0_uf_cb(void);
 void scheduled_si7021_humidity_cb(void);
 void scheduled_si7021_temp_cb(void);
 void scheduled_veml_read_cb(void);
+void scheduled_sample_done_cb(void);
+void scheduled_sensor_measure_cb(void);
+void scheduled_veml_int_cb(void);
+void scheduled_sched_due_cb(void);
+void scheduled_sensor_ready_cb(void);
+void scheduled_ble_link_cb(void);
+void scheduled_ble_drain_cb(void);
+void scheduled_query_tx_cb(void);
+void scheduled_burst_tick_cb(void);
+void scheduled_burst_read_cb(void);
 void scheduled_boot_up_cb(void);
 void scheduled_ble_tx_done_cb(void);
+void scheduled_ble_rx_done_cb(void);
 
 #endif
@@ -17,6 +17,7 @@
 // Driver functions
 #include "leuart.h"
 #include "gpio.h"
+#include "cmd_parser.h"
 
 
 //***********************************************************************************
@@ -30,6 +31,11 @@
 #define HM10_PARITY			leuartNoParity
 #define HM10_REFFREQ		0					// use reference clock
 #define HM10_STOPBITS		leuartStopbits1
+#define HM10_TX_LDMA		true				// one LDMA done + one TXC interrupt per write
+#define HM10_RX_LDMA		true				// received bytes land in the LEUART RX circular buffer
+#define HM10_RX_BLOCK		true				// receiver ignores everything outside a command frame
+#define HM10_STARTFRAME		CMD_START_CHAR		// unblocks the receiver
+#define HM10_SIGFRAME		CMD_END_CHAR		// wakes the CPU once a command is complete
 
 #define LEUART0_TX_ROUTE	LEUART_ROUTELOC0_TXLOC_LOC18
 #define LEUART0_RX_ROUTE	LEUART_ROUTELOC0_RXLOC_LOC18   	// Route to ...
@@ -45,6 +51,13 @@
 //***********************************************************************************
 void ble_open(uint32_t tx_event, uint32_t rx_event);
 void ble_write(char *string);
+bool ble_write_segments(const LEUART_TX_SEGMENT *segments, uint32_t num_segments, uint32_t release_evt);
+
+bool ble_read_command(BLE_COMMAND *cmd);
+
+void ble_link_open(uint32_t link_event);
+bool ble_connected(void);
+void ble_traffic(uint32_t *tx_bytes, uint32_t *tx_writes, uint32_t *rx_bytes);
 
 bool ble_test(char *mod_name);
 
@@ -80,6 +80,12 @@
 #define		VEML_SDA_ROUTE			I2C_ROUTELOC0_SDALOC_LOC8
 
 #define 	VEML_DRIVE_STRENGTH		gpioDriveStrengthWeakAlternateWeak
+
+// Open drain, active low threshold interrupt, pulled up on the expansion header
+#define		VEML_INT_PORT			gpioPortD
+#define		VEML_INT_PIN			8u
+#define		VEML_INT_GPIOMODE		gpioModeInputPullFilter
+#define		VEML_INT_DEFAULT		true	// pull up
 #define 	VEML_SENSOR_GPIOMODE	gpioModeWiredAnd
 #define 	VEML_I2C_DEFAULT		true
 
@@ -97,6 +103,12 @@
 
 #define 	LEUART0_DRIVE_STRENGTH	gpioDriveStrengthStrongAlternateWeak
 
+// Module STATE output, high while a central is connected (HM-10 set to AT+PIO11)
+#define		BLE_STATE_PORT			gpioPortD
+#define		BLE_STATE_PIN			12u
+#define		BLE_STATE_GPIOMODE		gpioModeInputPullFilter
+#define		BLE_STATE_DEFAULT		false	// pull down, reads disconnected without the module
+
 //***********************************************************************************
 // global variables
 //***********************************************************************************
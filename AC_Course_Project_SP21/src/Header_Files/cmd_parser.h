@@ -0,0 +1,83 @@
+/*
+ * cmd_parser.h
+ *
+ *  Created on: May 5, 2021
+ *      Author: adamp
+ */
+
+#ifndef SRC_HEADER_FILES_CMD_PARSER_H_
+#define SRC_HEADER_FILES_CMD_PARSER_H_
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#include "em_assert.h"
+
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+// Command frame: CMD_START_CHAR <key> [= <decimal value>] CMD_END_CHAR, e.g. "#PER=2500\n"
+#define CMD_START_CHAR			'#'
+#define CMD_END_CHAR			'\n'
+#define CMD_VALUE_CHAR			'='
+#define CMD_KEY_MAX				8
+
+#define CMD_VALUE_MAX			1000000		// values are clamped to this bound
+
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef enum {
+	CmdInvalid,
+	CmdSamplePeriod,		// #PER=<ms>
+	CmdBatchSize,			// #BATCH=<samples per frame>
+	CmdSensorEnable,		// #SENS=<bit mask of APP_SENSOR_xxx>
+	CmdResolution,			// #RES=<SI7021 humidity bits, 12, 11, 10 or 8>
+	CmdHeater,				// #HEAT=<0 off, 1 to 16 on at heater level value - 1>
+	CmdSi7021Period,		// #HPER=<ms between SI7021 samples of the multi-rate schedule>
+	CmdVemlPeriod,			// #LPER=<ms between VEML7700 samples of the multi-rate schedule>
+	CmdRead,				// #READ=<SENSOR_xxx index>, answered from the cache when fresh
+	CmdFreshness,			// #FRESH=<ms a cached reading is served for>
+	CmdResume,				// #RESUME=<journal record number to send the backlog from>
+	CmdLast,				// #LAST=<n>, the last n journal records
+	CmdHistory,				// #HIST=<s>, the journal records of the last s seconds
+	CmdAggregate,			// #AGG=<s>, min, max and mean of every reading over the last s seconds
+	CmdRollup,				// #ROLL=<0 minutes, 1 hours, 2 days>, the rollup buckets of a tier
+	CmdPacked,				// #PACK=<n>, the last n journal records delta packed, and the packing ratio
+	CmdHumidityBand,		// #RHBAND=<0.1 %RH>, humidity change that is reported
+	CmdTemperatureBand,		// #FBAND=<0.1 F>, temperature change that is reported
+	CmdLightBand,			// #LUXBAND=<%>, light change that is reported
+	CmdSilence,				// #SILENCE=<s>, longest time a reading goes unreported, 0 for no heartbeat
+	CmdFilter,				// #FILT=<FILTER_TYPE>, smoothing of the humidity that drives LED1
+	CmdBurst,				// #BURST=<n>, n light readings as fast as the VEML makes them, then their flicker
+	CmdLifetime,			// #LIFE=<days>, battery life the energy governor aims for, 0 for no target
+	CmdBattery,				// #BATT=<mWh>, a new battery was fitted, the governor starts over
+	CmdEnergy				// #ENERGY, governor level, power, budget, energy used and supply voltage
+} CMD_ID;
+
+typedef struct {
+	CMD_ID					id;
+	uint32_t				value;
+	bool					has_value;
+} BLE_COMMAND;
+
+typedef struct {
+	uint32_t				state;
+	char					key[CMD_KEY_MAX];
+	uint32_t				key_len;
+	uint32_t				value;
+	bool					has_value;
+} CMD_PARSER;
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void cmd_parser_init(CMD_PARSER *parser);
+bool cmd_parser_feed(CMD_PARSER *parser, char c, BLE_COMMAND *cmd);
+
+#endif /* SRC_HEADER_FILES_CMD_PARSER_H_ */
@@ -0,0 +1,52 @@
+/*
+ * comfort.h
+ *
+ *  Created on: May 23, 2021
+ *      Author: adamp
+ */
+
+#ifndef SRC_HEADER_FILES_COMFORT_H_
+#define SRC_HEADER_FILES_COMFORT_H_
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#include "em_device.h"
+#include "em_assert.h"
+
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define COMFORT_BENCH_CALLS		64			// calls per comfort_benchmark() run
+
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef enum {
+	ComfortDewPoint,
+	ComfortHeatIndex,
+	ComfortAbsHumidity,
+	ComfortMetrics
+} COMFORT_METRIC;
+
+typedef struct {
+	int32_t			dew_point;			// 0.1 F
+	int32_t			heat_index;			// 0.1 F
+	int32_t			abs_humidity;		// 0.01 g/m3
+} COMFORT;
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+int32_t comfort_dew_point(int32_t humidity, int32_t temperature);
+int32_t comfort_heat_index(int32_t humidity, int32_t temperature);
+int32_t comfort_abs_humidity(int32_t humidity, int32_t temperature);
+void comfort_compute(int32_t humidity, int32_t temperature, COMFORT *comfort);
+uint32_t comfort_benchmark(COMFORT_METRIC metric);
+
+#endif /* SRC_HEADER_FILES_COMFORT_H_ */
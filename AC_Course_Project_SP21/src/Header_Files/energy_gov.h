@@ -0,0 +1,81 @@
+/*
+ * energy_gov.h
+ *
+ *  Created on: May 24, 2021
+ *      Author: adamp
+ */
+
+#ifndef SRC_HEADER_FILES_ENERGY_GOV_H_
+#define SRC_HEADER_FILES_ENERGY_GOV_H_
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+
+
+/* The developer's include statements */
+
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define ENERGY_EMS					4			// EM0 to EM3
+#define ENERGY_GOV_MAX_LEVELS		8
+#define ENERGY_GOV_HEADROOM_PCT		90			// a richer level must fit this share of the budget
+#define ENERGY_GOV_FORGET_SHIFT		4			// untried levels forget 1/16 of their power a window
+
+#define ENERGY_NJ_PER_MWH			3600000000ULL
+#define ENERGY_MS_PER_DAY			86400000ULL
+
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+// Currents drawn from the battery, charges are in nC (uA x ms)
+typedef struct {
+	uint32_t		em_ua[ENERGY_EMS];		// MCU in each energy mode
+	uint32_t		base_ua;				// everything that draws all the time, the radio module idle
+	uint32_t		tx_byte_nc;				// radio charge of one byte sent
+	uint32_t		tx_write_nc;			// connection event overhead of one write
+	uint32_t		rx_byte_nc;				// radio charge of one byte received
+	uint32_t		nominal_mv;				// supply used while no reading is available
+} ENERGY_MODEL;
+
+// Running totals of everything that costs energy, they only ever count up
+typedef struct {
+	uint64_t		time_ms;
+	uint64_t		em_ms[ENERGY_EMS];		// residency in each energy mode
+	uint32_t		tx_bytes;
+	uint32_t		tx_writes;
+	uint32_t		rx_bytes;
+	uint64_t		sensor_nc;				// charge of the sensor conversions
+	uint32_t		supply_mv;				// last supply reading, 0 if none
+} ENERGY_METER;
+
+typedef struct {
+	const ENERGY_MODEL	*model;
+	uint64_t		start_ms;				// the battery was new
+	uint64_t		capacity_nj;			// usable energy of the new battery
+	uint32_t		lifetime_days;			// target, 0 leaves the governor at level 0
+	uint32_t		cutoff_mv;				// supply the battery is empty at
+	uint64_t		used_nj;				// estimated energy drawn since start_ms
+	uint32_t		levels;					// operating points, 0 richest, levels - 1 leanest
+	uint32_t		level;
+	uint32_t		power_uw;				// average power of the last window
+	uint32_t		budget_uw;				// average power the rest of the target allows
+	uint32_t		level_uw[ENERGY_GOV_MAX_LEVELS];	// last known power of each level, 0 if unknown
+	ENERGY_METER	last;					// meter at the start of the window
+} ENERGY_GOV;
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void energy_gov_init(ENERGY_GOV *gov, const ENERGY_MODEL *model, uint32_t levels, const ENERGY_METER *meter);
+void energy_gov_target(ENERGY_GOV *gov, uint32_t capacity_mwh, uint32_t lifetime_days, uint32_t cutoff_mv);
+bool energy_gov_update(ENERGY_GOV *gov, const ENERGY_METER *meter);
+uint32_t energy_gov_days_left(const ENERGY_GOV *gov);
+
+#endif /* SRC_HEADER_FILES_ENERGY_GOV_H_ */
@@ -0,0 +1,83 @@
+/*
+ * energy_levels.h
+ *
+ *  Created on: May 24, 2021
+ *      Author: adamp
+ */
+
+#ifndef SRC_HEADER_FILES_ENERGY_LEVELS_H_
+#define SRC_HEADER_FILES_ENERGY_LEVELS_H_
+
+/* System include statements */
+#include <stdint.h>
+
+/* Silicon Labs include statements */
+
+
+/* The developer's include statements */
+#include "energy_gov.h"
+
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+// Energy budget governor of app.c, shared with energy_gov_sim.c so both run the same
+// governor.  Nothing here may depend on emlib.  The currents are datasheet estimates
+// for this board to calibrate.
+#define		ENERGY_PERIOD_MS		1800	// sample period of level 0, PWM_PER
+#define		ENERGY_BATTERY_MWH		6000	// 2 x AA alkaline, 2000 mAh usable at 3.0 V
+#define		ENERGY_LIFETIME_DAYS	365
+#define		ENERGY_CUTOFF_MV		2000	// AVDD of an empty pair of cells under load
+#define		ENERGY_WINDOW_MS		600000	// energy charged and the level revisited this often
+#define		ENERGY_LEVELS			6
+#define		ENERGY_EM0_UA			1400	// HFRCO core running
+#define		ENERGY_EM1_UA			600		// core sleeping, LDMA and I2C running
+#define		ENERGY_EM2_UA			4		// RTCC, LETIMER0 and LEUART0 on the LFXO and ULFRCO
+#define		ENERGY_EM3_UA			3
+#define		ENERGY_BASE_UA			150		// HM-18 connected and idle, VEML7700 in power saving mode
+#define		ENERGY_TX_BYTE_NC		3000	// HM-18 awake for a byte of 9600 baud UART, then on air
+#define		ENERGY_TX_WRITE_NC		12000	// connection event of a write
+#define		ENERGY_RX_BYTE_NC		3000
+#define		ENERGY_SI7021_UA		150		// while converting
+#define		ENERGY_NOMINAL_MV		3000
+
+// RES1:RES0 bits of SI7021 user register 1, the values of SI7021_RESOLUTION
+#define		ENERGY_RES_RH12_T14		0x00
+#define		ENERGY_RES_RH8_T12		0x01
+#define		ENERGY_RES_RH11_T11		0x81
+
+#define		ENERGY_MODEL_DEFAULT															\
+{																							\
+	{ ENERGY_EM0_UA, ENERGY_EM1_UA, ENERGY_EM2_UA, ENERGY_EM3_UA }, ENERGY_BASE_UA,		\
+	ENERGY_TX_BYTE_NC, ENERGY_TX_WRITE_NC, ENERGY_RX_BYTE_NC, ENERGY_NOMINAL_MV				\
+}
+
+// Operating points from richest to leanest, conversion_ms is si7021_resolution_ms()
+// of the resolution and checked against it by the TDD tests of app.c
+#define		ENERGY_LEVEL_TABLE					\
+{												\
+	{ 1, 1, ENERGY_RES_RH12_T14, 23 },			\
+	{ 2, 2, ENERGY_RES_RH12_T14, 23 },			\
+	{ 4, 4, ENERGY_RES_RH11_T11, 10 },			\
+	{ 8, 8, ENERGY_RES_RH8_T12, 7 },			\
+	{ 16, 8, ENERGY_RES_RH8_T12, 7 },			\
+	{ 32, 8, ENERGY_RES_RH8_T12, 7 }			\
+}
+
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef struct {
+	uint32_t		period_mult;			// sample period stretch
+	uint32_t		batch_size;				// least samples per BLE frame
+	uint32_t		resolution;				// ENERGY_RES_xxx, a SI7021_RESOLUTION
+	uint32_t		conversion_ms;			// SI7021 humidity and temperature at the resolution
+} ENERGY_LEVEL;
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+
+#endif /* SRC_HEADER_FILES_ENERGY_LEVELS_H_ */
@@ -0,0 +1,34 @@
+/*
+ * fft.h
+ *
+ *  Created on: May 22, 2021
+ *      Author: adamp
+ */
+
+#ifndef SRC_HEADER_FILES_FFT_H_
+#define SRC_HEADER_FILES_FFT_H_
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#include "em_assert.h"
+
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define FFT_SIZE_MAX			256			// 4^4, the sine table resolution
+#define FFT_SIN_QUARTER			(FFT_SIZE_MAX / 4)
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void fft_radix4_q15(int16_t *data, uint32_t size);
+int16_t fft_sin_q15(uint32_t k);
+int16_t fft_cos_q15(uint32_t k);
+void fft_hann_q15(int16_t *samples, uint32_t size);
+
+#endif /* SRC_HEADER_FILES_FFT_H_ */
@@ -0,0 +1,64 @@
+/*
+ * filter.h
+ *
+ *  Created on: May 21, 2021
+ *      Author: adamp
+ */
+
+#ifndef SRC_HEADER_FILES_FILTER_H_
+#define SRC_HEADER_FILES_FILTER_H_
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+/* Silicon Labs include statements */
+#include "em_device.h"
+#include "em_assert.h"
+
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define FILTER_TAPS_MAX			16		// longest boxcar window
+#define FILTER_CHUNK			32		// samples filtered per pass of the work buffer
+#define FILTER_BENCH_SAMPLES	256		// samples per filter_benchmark() run
+#define FILTER_TEST_SAMPLES		64		// samples per filter_test() stream, two chunks
+
+#define FILTER_EMA_ONE			32768	// EMA weight of 1.0, Q15
+
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef enum {
+	FilterNone,
+	FilterEma,					// param: weight of the new sample, Q15
+	FilterBoxcar,				// param: window length, 2 to FILTER_TAPS_MAX
+	FilterMedian3,
+	FilterMedian5,
+	FilterTypes
+} FILTER_TYPE;
+
+// One stream of int16 readings in fixed point channel units
+typedef struct {
+	FILTER_TYPE		type;
+	uint32_t		taps;						// window length, 1 for EMA
+	uint32_t		alpha;						// EMA weight, Q15
+	int32_t			ema;						// EMA output, Q8
+	bool			primed;						// the history holds real samples
+	int16_t			hist[FILTER_TAPS_MAX - 1];	// last taps - 1 inputs, oldest first
+} FILTER;
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void filter_init(FILTER *filter, FILTER_TYPE type, uint32_t param);
+void filter_batch(FILTER *filter, const int16_t *in, int16_t *out, uint32_t count);
+int16_t filter_step(FILTER *filter, int16_t in);
+uint32_t filter_benchmark(FILTER_TYPE type, uint32_t param);
+bool filter_test(void);
+
+#endif /* SRC_HEADER_FILES_FILTER_H_ */
@@ -0,0 +1,51 @@
+/*
+ * flicker.h
+ *
+ *  Created on: May 22, 2021
+ *      Author: adamp
+ */
+
+#ifndef SRC_HEADER_FILES_FLICKER_H_
+#define SRC_HEADER_FILES_FLICKER_H_
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#include "em_assert.h"
+
+/* The developer's include statements */
+#include "fft.h"
+
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define FLICKER_SAMPLES_MIN		16
+#define FLICKER_SAMPLES_MAX		FFT_SIZE_MAX
+
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef struct {
+	uint32_t		samples;
+	uint32_t		period_ms;
+	uint32_t		mean;					// counts
+	uint32_t		min;
+	uint32_t		max;
+	uint32_t		flicker_index;			// x1000, area above the mean over the total area
+	uint32_t		percent_flicker;		// x10, (max - min) / (max + min)
+	uint32_t		peak_mhz;				// dominant frequency, 0 for a steady light
+	uint32_t		bin_mhz;				// frequency resolution
+	uint32_t		peak_share_pct;			// power of the dominant peak out of all the AC power
+} FLICKER_RESULT;
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void flicker_analyze(const uint16_t *counts, uint32_t samples, uint32_t period_ms, FLICKER_RESULT *result);
+
+#endif /* SRC_HEADER_FILES_FLICKER_H_ */
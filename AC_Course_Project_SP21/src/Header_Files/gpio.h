@@ -14,10 +14,12 @@
 
 /* The developer's include statements */
 #include "brd_config.h"
+#include "scheduler.h"
 
 //***********************************************************************************
 // defined files
 //***********************************************************************************
+#define GPIO_NUM_EXT_INT		16		// one external interrupt per pin number
 
 //***********************************************************************************
 // global variables
@@ -28,5 +30,10 @@
 // function prototypes
 //***********************************************************************************
 void gpio_open(void);
+void gpio_irq_open(GPIO_Port_TypeDef port, uint32_t pin, bool rising, bool falling, uint32_t irq_cb);
+void gpio_irq_close(uint32_t pin);
+
+void GPIO_EVEN_IRQHandler(void);
+void GPIO_ODD_IRQHandler(void);
 
 #endif
@@ -19,11 +19,15 @@
 
 #include "sleep_routines.h"
 #include "scheduler.h"
+#include "ldma.h"
+#include "sample_store.h"
 
 #define I2C_EM_BLOCK		EM2
 #define I2C_READ			true
 #define I2C_WRITE			false
+#define I2C_NO_REGISTER		0xFFFFFFFF		// read without writing a register or command first
 
+#define I2C_BYTES_0			0		// write the command byte only
 #define I2C_BYTES_1			1
 #define I2C_BYTES_2			2
 
@@ -50,6 +54,7 @@ typedef struct {
 	uint32_t				num_transfer_bytes;
 	uint32_t				bytes_transfered;
 	uint32_t				*data;
+	SAMPLE_RECORD			*record;			// published at the stop when data was staged in it
 	uint32_t				si_cb;
 	volatile bool			i2c_busy;
 } I2C_STATE_MACHINE;
@@ -60,6 +65,10 @@ void I2C0_IRQHandler(void);
 void I2C1_IRQHandler(void);
 
 void i2c_start(I2C_TypeDef *i2cx, uint32_t slave_address, uint32_t slave_register, bool read_write, uint32_t *data, uint32_t si_read_cb, uint32_t num_bytes);
+void i2c_arm(I2C_TypeDef *i2cx, uint32_t slave_address, uint32_t slave_register, bool read_write, uint32_t *data, uint32_t si_read_cb, uint32_t num_bytes);
+void i2c_read_record(I2C_TypeDef *i2cx, uint32_t slave_address, uint32_t slave_register, SAMPLE_RECORD *record, uint32_t read_cb, uint32_t num_bytes);
+void i2c_arm_record(I2C_TypeDef *i2cx, uint32_t slave_address, uint32_t slave_register, SAMPLE_RECORD *record, uint32_t read_cb, uint32_t num_bytes);
+void i2c_hw_trigger_open(I2C_TypeDef *i2cx, uint32_t ldma_ch, uint32_t ldma_signal, uint32_t slave_address);
 bool check_busy(I2C_TypeDef * i2c);
 
 #endif /* SRC_HEADER_FILES_I2C_H_ */
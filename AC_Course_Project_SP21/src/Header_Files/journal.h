@@ -0,0 +1,90 @@
+/*
+ * journal.h
+ *
+ *  Created on: May 18, 2021
+ *      Author: adamp
+ */
+
+#ifndef SRC_HEADER_FILES_JOURNAL_H_
+#define SRC_HEADER_FILES_JOURNAL_H_
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#include "em_device.h"
+#include "em_msc.h"
+#include "em_assert.h"
+
+/* The developer's include statements */
+#include "timebase.h"
+
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+// The journal owns the last JOURNAL_PAGES pages of the main flash, the image must end below
+// JOURNAL_BASE_ADDR.
+#define JOURNAL_PAGES				32
+#define JOURNAL_PAGE_SIZE			FLASH_PAGE_SIZE
+#define JOURNAL_BASE_ADDR			(FLASH_BASE + FLASH_SIZE - JOURNAL_PAGES * JOURNAL_PAGE_SIZE)
+#define JOURNAL_MAGIC				0x4A524E4CUL	// "JRNL"
+
+#define JOURNAL_RECORDS_PER_PAGE	((JOURNAL_PAGE_SIZE - sizeof(JOURNAL_PAGE_HDR)) / sizeof(JOURNAL_RECORD))
+#define JOURNAL_NONE				0xFFFFFFFFUL	// no record number
+
+// JOURNAL_RECORD.present bits
+#define JOURNAL_HUMIDITY			0x01
+#define JOURNAL_TEMPERATURE			0x02
+#define JOURNAL_LIGHT				0x04
+
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+// One sample in fixed point, 16 bytes so a page holds a whole number of records
+typedef struct {
+	uint32_t				time_ms;			// timebase at the launch of the sample, since boot
+	int16_t					humidity;			// 0.1 %RH
+	int16_t					temperature;		// 0.1 F
+	uint32_t				light;				// lux
+	uint8_t					present;			// JOURNAL_xxx bits of the readings taken
+	uint8_t					boot;				// boot count, time_ms restarts with every boot
+	uint16_t				check;				// detects a record cut short by a reset
+} JOURNAL_RECORD;
+
+typedef struct {
+	uint32_t				magic;
+	uint32_t				seq;				// page sequence number, the ring index is seq % JOURNAL_PAGES
+	uint32_t				seq_inv;			// ~seq, a header cut short by a reset fails the compare
+	uint32_t				reserved;
+} JOURNAL_PAGE_HDR;
+
+typedef struct {
+	JOURNAL_PAGE_HDR		hdr;
+	JOURNAL_RECORD			rec[JOURNAL_RECORDS_PER_PAGE];
+} JOURNAL_PAGE;
+
+typedef struct {
+	uint32_t				records;			// records appended since boot
+	uint32_t				bytes_programmed;	// bytes written to flash since boot, headers included
+	uint32_t				pages_erased;
+	uint32_t				mount_probes;		// headers and records read by the last mount
+	uint32_t				mount_ms;
+} JOURNAL_STATS;
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void journal_open(void);
+void journal_append(JOURNAL_RECORD *record);
+void journal_flush(void);
+uint32_t journal_first(void);
+uint32_t journal_next(void);
+bool journal_read(uint32_t number, JOURNAL_RECORD *record);
+const JOURNAL_STATS *journal_stats(void);
+uint8_t journal_boot_count(void);
+
+#endif /* SRC_HEADER_FILES_JOURNAL_H_ */
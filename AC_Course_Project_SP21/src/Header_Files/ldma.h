@@ -0,0 +1,50 @@
+/*
+ * ldma.h
+ *
+ *  Created on: May 3, 2021
+ *      Author: adamp
+ */
+
+#ifndef SRC_HEADER_FILES_LDMA_H_
+#define SRC_HEADER_FILES_LDMA_H_
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#include "em_ldma.h"
+#include "em_cmu.h"
+#include "em_assert.h"
+#include "em_core.h"
+#include "em_prs.h"
+
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+// Channel assignments, one owner per channel
+#define LDMA_LEUART0_TX_CH		0
+#define LDMA_LEUART0_RX_CH		1
+#define LDMA_I2C1_TRIG_CH		2
+#define LDMA_I2C0_TRIG_CH		3
+
+#define LDMA_NUM_CH				DMA_CHAN_COUNT
+
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef void (*LDMA_DONE_CB)(uint32_t channel);
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void ldma_open(void);
+void ldma_channel_open(uint32_t channel, LDMA_DONE_CB done_cb);
+void ldma_prs_request_open(uint32_t request, uint32_t prs_ch);
+
+void LDMA_IRQHandler(void);
+
+#endif /* SRC_HEADER_FILES_LDMA_H_ */
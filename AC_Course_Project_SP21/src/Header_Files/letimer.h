@@ -12,16 +12,22 @@
 #include "em_gpio.h"
 #include "em_cmu.h"
 #include "em_assert.h"
+#include "em_prs.h"
 
 /* The developer's include statements */
 #include "scheduler.h"
 #include "sleep_routines.h"
+#include "timebase.h"
 
 //***********************************************************************************
 // defined files
 //***********************************************************************************
-#define LETIMER_HZ		1000			// Utilizing ULFRCO oscillator for LETIMERs
+#define LETIMER_HZ		1000			// Utilizing ULFRCO oscillator for LETIMERs, nominal frequency
+#define LETIMER_CAL_TICKS	250			// ULFRCO ticks measured against the timebase
+#define LETIMER_HZ_MIN		500			// calibration results outside this range are rejected
+#define LETIMER_HZ_MAX		2000
 #define LETIMER_EM 		EM4 			// Using the ULFRCO, block from entering Energy Mode 4
+#define LETIMER_PRS_CH		0				// PRS channel carrying the LETIMER0 underflow
 
 //***********************************************************************************
 // global variables
@@ -49,6 +55,11 @@ typedef struct {
 //***********************************************************************************
 void letimer_pwm_open(LETIMER_TypeDef *letimer, APP_LETIMER_PWM_TypeDef *app_letimer_struct);
 void letimer_start(LETIMER_TypeDef *letimer, bool enable);
+void letimer_pwm_set_period(LETIMER_TypeDef *letimer, float period, float active_period);
+uint32_t letimer_ulfrco_calibrate(LETIMER_TypeDef *letimer);
+uint32_t letimer_clock_hz(void);
+uint32_t letimer_period_max_ms(void);
+void letimer_prs_open(LETIMER_TypeDef *letimer, uint32_t prs_ch);
 
 void LETIMER0_IRQHandler(void);
 
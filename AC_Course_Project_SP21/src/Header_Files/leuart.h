@@ -6,6 +6,7 @@
 
 #include "em_leuart.h"
 #include "sleep_routines.h"
+#include "ldma.h"
 
 
 //***********************************************************************************
@@ -15,6 +16,15 @@
 #define LEUART_TX_EM		EM3
 #define LEUART_RX_EM		EM3
 
+#define LEUART_TX_MAX_SEGMENTS	4		// scatter list entries held by the state machine
+
+// With tx_ldma_en a segment is split across linked LDMA descriptors, one for every
+// LEUART_LDMA_XFER_MAX bytes, and leuart_start_segments() refuses a scatter list that
+// needs more than LEUART_TX_MAX_DESCRIPTORS of them.  The TXBL path has no limit.
+#define LEUART_LDMA_XFER_MAX		2048	// bytes one descriptor moves, XFERCNT + 1
+#define LEUART_TX_MAX_DESCRIPTORS	8
+#define LEUART_RX_BUFFER_SIZE	128		// circular buffer the RX LDMA channel drains RXDATA into
+
 /***************************************************************************//**
  * @addtogroup leuart
  * @{
@@ -40,6 +50,8 @@ typedef struct {
 	bool						tx_en;
 	uint32_t					rx_done_evt;
 	uint32_t					tx_done_evt;
+	bool						tx_ldma_en;		// feed TXDATA by LDMA instead of TXBL interrupts
+	bool						rx_ldma_en;		// drain RXDATA by LDMA into the circular buffer
 } LEUART_OPEN_STRUCT;
 
 
@@ -49,13 +61,20 @@ typedef struct {
 // global variables
 //***********************************************************************************
 
+typedef struct {
+	const char					*data;			// caller owned, must stay valid until release
+	uint32_t					length;
+} LEUART_TX_SEGMENT;
+
 typedef struct {
 	uint32_t					state;
 	LEUART_TypeDef				*leuart;
-	uint32_t					count;
-	uint32_t					length;
-	uint32_t					callback;
-	char						string[80];
+	uint32_t					count;			// bytes sent from the current segment
+	uint32_t					length;			// length of the current segment
+	uint32_t					callback;		// release event, raised on TXC
+	LEUART_TX_SEGMENT			segments[LEUART_TX_MAX_SEGMENTS];
+	uint32_t					num_segments;
+	uint32_t					segment;		// index of the current segment
 	volatile bool				busy;
 } LEUART_STATE_MACHINE;
 
@@ -72,8 +91,11 @@ enum leurat_defined_states {
 //***********************************************************************************
 void leuart_open(LEUART_TypeDef *leuart, LEUART_OPEN_STRUCT *leuart_settings);
 void LEUART0_IRQHandler(void);
-void leuart_start(LEUART_TypeDef *leuart, char *string, uint32_t string_len);
+void leuart_start(LEUART_TypeDef *leuart, const char *string, uint32_t string_len);
+bool leuart_start_segments(LEUART_TypeDef *leuart, const LEUART_TX_SEGMENT *segments, uint32_t num_segments, uint32_t release_evt);
 bool leuart_tx_busy(LEUART_TypeDef *leuart);
+uint32_t leuart_rx_available(LEUART_TypeDef *leuart);
+uint32_t leuart_rx_read(LEUART_TypeDef *leuart, char *dest, uint32_t max_len);
 
 uint32_t leuart_status(LEUART_TypeDef *leuart);
 void leuart_cmd_write(LEUART_TypeDef *leuart, uint32_t cmd_update);
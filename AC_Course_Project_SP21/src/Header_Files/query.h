@@ -0,0 +1,56 @@
+/*
+ * query.h
+ *
+ *  Created on: May 18, 2021
+ *      Author: adamp
+ */
+
+#ifndef SRC_HEADER_FILES_QUERY_H_
+#define SRC_HEADER_FILES_QUERY_H_
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* The developer's include statements */
+#include "journal.h"
+
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+// Sample time key, ordered like the record numbers as long as fewer than 256 boots
+// share the journal ring
+#define QUERY_KEY(boot, time_ms)	(((uint64_t) (boot) << 32) | (time_ms))
+
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef enum {
+	QueryHumidity,					// 0.1 %RH
+	QueryTemperature,				// 0.1 F
+	QueryLight						// lux
+} QUERY_FIELD;
+
+typedef struct {
+	uint32_t				count;		// records that had the reading
+	int32_t					min;
+	int32_t					max;
+	int64_t					sum;
+	uint32_t				first;		// record numbers aggregated, first to end - 1
+	uint32_t				end;
+} QUERY_AGG;
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+uint64_t query_key(const JOURNAL_RECORD *record);
+uint32_t query_lower_bound(uint64_t key);
+void query_last_n(uint32_t n, uint32_t *first, uint32_t *end);
+void query_range(uint64_t from, uint64_t to, uint32_t *first, uint32_t *end);
+void query_aggregate(uint32_t first, uint32_t end, QUERY_FIELD field, QUERY_AGG *agg);
+int32_t query_mean(const QUERY_AGG *agg);
+
+#endif /* SRC_HEADER_FILES_QUERY_H_ */
@@ -0,0 +1,55 @@
+/*
+ * rate_ctrl.h
+ *
+ *  Created on: May 7, 2021
+ *      Author: adamp
+ */
+
+#ifndef SRC_HEADER_FILES_RATE_CTRL_H_
+#define SRC_HEADER_FILES_RATE_CTRL_H_
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#include "em_assert.h"
+
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define RATE_CTRL_MAX_CH		4
+
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef struct {
+	int32_t			abs_threshold;		// change in channel units that counts as "fast"
+	uint32_t		rel_threshold_pct;	// or this percentage of the last value, if larger
+	int32_t			last_value;
+	bool			has_last;
+} RATE_CTRL_CH;
+
+typedef struct {
+	uint32_t		min_period_ms;		// period used while readings change
+	uint32_t		max_period_ms;		// longest period reached while readings are stable
+	uint32_t		period_ms;			// current period
+	uint32_t		stable_needed;		// stable samples before the period is stretched
+	uint32_t		stable_count;
+	bool			changed;			// a channel moved past its threshold this sample
+	RATE_CTRL_CH	ch[RATE_CTRL_MAX_CH];
+} RATE_CTRL;
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void rate_ctrl_init(RATE_CTRL *ctrl, uint32_t min_period_ms, uint32_t max_period_ms, uint32_t stable_needed);
+void rate_ctrl_channel_set(RATE_CTRL *ctrl, uint32_t ch, int32_t abs_threshold, uint32_t rel_threshold_pct);
+void rate_ctrl_observe(RATE_CTRL *ctrl, uint32_t ch, int32_t value);
+int32_t rate_ctrl_excess(int32_t reference, int32_t value, int32_t abs_band, uint32_t rel_band_pct);
+bool rate_ctrl_update(RATE_CTRL *ctrl);
+
+#endif /* SRC_HEADER_FILES_RATE_CTRL_H_ */
@@ -0,0 +1,51 @@
+/*
+ * report_filter.h
+ *
+ *  Created on: May 20, 2021
+ *      Author: adamp
+ */
+
+#ifndef SRC_HEADER_FILES_REPORT_FILTER_H_
+#define SRC_HEADER_FILES_REPORT_FILTER_H_
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#include "em_assert.h"
+
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define REPORT_FILTER_MAX_CH	4
+
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef struct {
+	int32_t			abs_band;			// change in channel units that is reported
+	uint32_t		rel_band_pct;		// or this percentage of the last reported value, if larger
+	int32_t			reported;			// last value sent
+	uint64_t		reported_ms;		// when it was sent
+	bool			has_reported;
+} REPORT_FILTER_CH;
+
+typedef struct {
+	uint32_t			max_silence_ms;	// heartbeat, a channel is reported at least this often
+	uint32_t			passed;			// readings reported since init
+	uint32_t			suppressed;		// readings inside their deadband since init
+	REPORT_FILTER_CH	ch[REPORT_FILTER_MAX_CH];
+} REPORT_FILTER;
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void report_filter_init(REPORT_FILTER *filter, uint32_t max_silence_ms);
+void report_filter_channel_set(REPORT_FILTER *filter, uint32_t ch, int32_t abs_band, uint32_t rel_band_pct);
+bool report_filter_check(REPORT_FILTER *filter, uint32_t ch, int32_t value, uint64_t time_ms);
+
+#endif /* SRC_HEADER_FILES_REPORT_FILTER_H_ */
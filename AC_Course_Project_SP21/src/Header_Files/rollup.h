@@ -0,0 +1,73 @@
+/*
+ * rollup.h
+ *
+ *  Created on: May 19, 2021
+ *      Author: adamp
+ */
+
+#ifndef SRC_HEADER_FILES_ROLLUP_H_
+#define SRC_HEADER_FILES_ROLLUP_H_
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#include "em_assert.h"
+
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define ROLLUP_MAX_CH			4
+
+#define ROLLUP_MINUTE_DEPTH		60			// closed buckets kept per tier
+#define ROLLUP_HOUR_DEPTH		24
+#define ROLLUP_DAY_DEPTH		7
+
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef enum {
+	RollupMinute,
+	RollupHour,
+	RollupDay,
+	RollupTiers
+} ROLLUP_TIER_ID;
+
+// One channel over one bucket, in the channel's fixed point units
+typedef struct {
+	uint32_t		count;
+	int32_t			min;
+	int32_t			max;
+	int32_t			last;
+	int64_t			sum;
+} ROLLUP_STAT;
+
+typedef struct {
+	uint32_t		index;				// bucket number, start time / tier period
+	ROLLUP_STAT		ch[ROLLUP_MAX_CH];
+} ROLLUP_BUCKET;
+
+typedef struct {
+	uint32_t		period_ms;
+	uint32_t		depth;
+	ROLLUP_BUCKET	*ring;				// closed buckets, oldest overwritten first
+	uint32_t		head;				// ring slot the next closed bucket goes to
+	uint32_t		closed;				// closed buckets in the ring
+	bool			started;
+	ROLLUP_BUCKET	open;				// bucket the samples are added to
+} ROLLUP_TIER;
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void rollup_open(void);
+uint32_t rollup_add(uint32_t ch, int32_t value, uint64_t time_ms);
+const ROLLUP_BUCKET *rollup_get(ROLLUP_TIER_ID tier, uint32_t age);
+uint32_t rollup_tier_ms(ROLLUP_TIER_ID tier);
+int32_t rollup_mean(const ROLLUP_STAT *stat);
+
+#endif /* SRC_HEADER_FILES_ROLLUP_H_ */
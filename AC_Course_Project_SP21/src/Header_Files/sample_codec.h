@@ -0,0 +1,54 @@
+/*
+ * sample_codec.h
+ *
+ *  Created on: May 20, 2021
+ *      Author: adamp
+ */
+
+#ifndef SRC_HEADER_FILES_SAMPLE_CODEC_H_
+#define SRC_HEADER_FILES_SAMPLE_CODEC_H_
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+
+
+/* The developer's include statements */
+
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define CODEC_MAX_CH			4
+
+// Worst case of one sample: 64-bit time token, present mask, a 32-bit delta per channel
+#define CODEC_VARINT_MAX_32		5
+#define CODEC_VARINT_MAX_64		10
+#define CODEC_MAX_SAMPLE_BYTES	(CODEC_VARINT_MAX_64 + 1 + CODEC_MAX_CH * CODEC_VARINT_MAX_32)
+
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+// Stream state, the encoder and the decoder of a stream keep identical copies
+typedef struct {
+	uint32_t		channels;
+	uint64_t		time_ms;				// time of the previous sample
+	int64_t			delta_ms;				// time step of the previous sample
+	uint8_t			present;				// channel mask of the previous sample
+	int32_t			value[CODEC_MAX_CH];	// last value of every channel
+	uint32_t		samples;				// samples through the stream since the reset
+	uint32_t		bytes;					// packed bytes of those samples
+} CODEC_STATE;
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void codec_reset(CODEC_STATE *state, uint32_t channels);
+uint32_t codec_encode(CODEC_STATE *state, uint64_t time_ms, uint8_t present, const int32_t *value, uint8_t *out);
+uint32_t codec_decode(CODEC_STATE *state, const uint8_t *in, uint32_t len, uint64_t *time_ms, uint8_t *present, int32_t *value);
+
+#endif /* SRC_HEADER_FILES_SAMPLE_CODEC_H_ */
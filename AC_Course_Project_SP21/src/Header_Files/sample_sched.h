@@ -0,0 +1,49 @@
+/*
+ * sample_sched.h
+ *
+ *  Created on: May 17, 2021
+ *      Author: adamp
+ */
+
+#ifndef SRC_HEADER_FILES_SAMPLE_SCHED_H_
+#define SRC_HEADER_FILES_SAMPLE_SCHED_H_
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#include "em_assert.h"
+
+/* The developer's include statements */
+#include "timebase.h"
+
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define SAMPLE_SCHED_MAX		4			// schedule entries, one per sensor group
+#define SAMPLE_SCHED_MERGE_MS	50			// due times this close together share one wake
+
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef struct {
+	uint32_t				groups;				// APP_SENSOR_xxx bits sampled by the entry, 0 if unused
+	uint32_t				period_ms;
+	uint32_t				phase_ms;			// offset of the first sample from the schedule start
+	uint64_t				next_due;			// timebase tick of the next sample
+} SAMPLE_SCHED_ENTRY;
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void sample_sched_open(uint32_t due_cb);
+void sample_sched_set(uint32_t groups, uint32_t period_ms, uint32_t phase_ms);
+void sample_sched_stretch(uint32_t num, uint32_t den);
+void sample_sched_start(void);
+uint32_t sample_sched_due(void);
+
+#endif /* SRC_HEADER_FILES_SAMPLE_SCHED_H_ */
@@ -0,0 +1,48 @@
+/*
+ * sample_store.h
+ *
+ *  Created on: May 17, 2021
+ *      Author: adamp
+ */
+
+#ifndef SRC_HEADER_FILES_SAMPLE_STORE_H_
+#define SRC_HEADER_FILES_SAMPLE_STORE_H_
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#include "em_device.h"
+#include "em_assert.h"
+
+/* The developer's include statements */
+#include "timebase.h"
+
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef struct {
+	uint32_t				raw;				// raw reading as received from the device
+	uint64_t				ticks;				// timebase when the read completed
+} SAMPLE_SLOT;
+
+// Written by one interrupt, read from the main loop.  The writer fills the slot that is
+// not published and publishes it by bumping seq, whose low bit selects the published slot.
+typedef struct {
+	volatile uint32_t		seq;
+	SAMPLE_SLOT				slot[2];
+} SAMPLE_RECORD;
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void sample_store_init(SAMPLE_RECORD *record);
+uint32_t *sample_store_stage(SAMPLE_RECORD *record);
+void sample_store_publish(SAMPLE_RECORD *record);
+uint32_t sample_store_read(const SAMPLE_RECORD *record, uint64_t *ticks);
+uint32_t sample_store_seq(const SAMPLE_RECORD *record);
+
+#endif /* SRC_HEADER_FILES_SAMPLE_STORE_H_ */
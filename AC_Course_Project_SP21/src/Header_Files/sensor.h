@@ -0,0 +1,81 @@
+/*
+ * sensor.h
+ *
+ *  Created on: May 16, 2021
+ *      Author: adamp
+ */
+
+#ifndef SRC_HEADER_FILES_SENSOR_H_
+#define SRC_HEADER_FILES_SENSOR_H_
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#include "em_i2c.h"
+#include "em_assert.h"
+
+/* The developer's include statements */
+#include "scheduler.h"
+#include "timebase.h"
+
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+// Registry order, also the index of a reading in SENSOR_SAMPLE.value
+#define SENSOR_HUMIDITY			0
+#define SENSOR_TEMPERATURE		1
+#define SENSOR_LIGHT			2
+#define SENSOR_NUM				3
+
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef struct {
+	const char				*name;
+	const char				*format;					// telemetry line for one converted reading
+	I2C_TypeDef				*bus;						// readings on one bus are taken in registry order
+	uint32_t				group;						// APP_SENSOR_xxx bit that enables the reading
+	uint32_t				done_cb;					// event raised once read() has the raw data
+	void					(*open)(void);				// 0 if another entry opens the device
+	void					(*start_measure)(void);		// 0 if the device converts continuously
+	uint32_t				(*measure_time_ms)(void);	// worst case time from start_measure() to data
+	void					(*read)(uint32_t done_cb);
+	float					(*convert)(void);
+} SENSOR_DESC;
+
+typedef struct {
+	bool					open;
+	uint32_t				launched;					// registry bits read for this sample
+	uint32_t				pending;					// registry bits still on the bus
+	uint64_t				start_ticks;				// timebase at launch, shared by every reading
+	uint64_t				done_ticks;					// timebase when the last bus finished
+	float					value[SENSOR_NUM];
+} SENSOR_SAMPLE;
+
+typedef struct {
+	bool					valid;
+	float					value;						// last converted reading
+	uint64_t				ticks;						// timebase at the launch of its sample
+} SENSOR_CACHE;
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void sensor_open(uint32_t measure_cb, uint32_t sample_done_cb, bool pipeline);
+const SENSOR_DESC *sensor_get(uint32_t index);
+bool sensor_sample_start(uint32_t groups);
+bool sensor_sample_open(uint32_t groups);
+void sensor_measure_done(void);
+void sensor_read_done(uint32_t done_cb);
+const SENSOR_SAMPLE *sensor_sample(void);
+void sensor_sample_release(void);
+bool sensor_cached(uint32_t index, uint32_t max_age_ms, float *value);
+const SENSOR_CACHE *sensor_cache(uint32_t index);
+bool sensor_request(uint32_t index, uint32_t max_age_ms, uint32_t ready_cb);
+
+#endif /* SRC_HEADER_FILES_SENSOR_H_ */
@@ -39,5 +39,6 @@ void sleep_block_mode(uint32_t EM);
 void sleep_unblock_mode(uint32_t EM);
 void enter_sleep(void);
 uint32_t current_block_energy_mode(void);
+uint64_t sleep_residency_ms(uint32_t EM);
 
 #endif /* SRC_HEADER_FILES_SLEEP_ROUTINES_H_ */
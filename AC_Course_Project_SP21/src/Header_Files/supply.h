@@ -0,0 +1,37 @@
+/*
+ * supply.h
+ *
+ *  Created on: May 24, 2021
+ *      Author: adamp
+ */
+
+#ifndef SRC_HEADER_FILES_SUPPLY_H_
+#define SRC_HEADER_FILES_SUPPLY_H_
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#include "em_adc.h"
+#include "em_cmu.h"
+#include "em_assert.h"
+
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define SUPPLY_ADC				ADC0
+#define SUPPLY_ADC_CLOCK		cmuClock_ADC0
+#define SUPPLY_ADC_HZ			1000000		// ADC clock from HFPERCLK
+#define SUPPLY_REF_MV			5000		// the 5 V reference, full scale of an AVDD conversion
+#define SUPPLY_FULL_SCALE		4096		// 12-bit conversion
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void supply_open(void);
+uint32_t supply_mv(void);
+
+#endif /* SRC_HEADER_FILES_SUPPLY_H_ */
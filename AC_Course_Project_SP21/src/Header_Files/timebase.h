@@ -0,0 +1,53 @@
+/*
+ * timebase.h
+ *
+ *  Created on: May 9, 2021
+ *      Author: adamp
+ */
+
+#ifndef SRC_HEADER_FILES_TIMEBASE_H_
+#define SRC_HEADER_FILES_TIMEBASE_H_
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#include "em_rtcc.h"
+#include "em_cmu.h"
+#include "em_core.h"
+#include "em_assert.h"
+
+/* The developer's include statements */
+#include "sleep_routines.h"
+#include "scheduler.h"
+
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define TIMEBASE_HZ				32768		// LFXO feeding the RTCC through LFE, no prescaler
+#define TIMEBASE_EM				EM3			// LFXO stops in EM3
+#define TIMEBASE_DELAY_CC		1			// RTCC compare channel used by timebase_delay_ms()
+#define TIMEBASE_ALARM_CC		2			// RTCC compare channel used by timebase_alarm_ms()
+#define TIMEBASE_SCHED_CC		0			// RTCC compare channel of the sample schedule
+#define TIMEBASE_NUM_CC			3
+
+#define TIMEBASE_MS_TO_TICKS(ms)	(((uint64_t) (ms) * TIMEBASE_HZ + 999) / 1000)
+#define TIMEBASE_TICKS_TO_MS(t)		(((uint64_t) (t) * 125) >> 12)		// 1000 / 32768 = 125 / 4096
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void timebase_open(void);
+bool timebase_is_open(void);
+uint64_t timebase_ticks(void);
+uint64_t timebase_ms(void);
+void timebase_delay_ms(uint32_t ms_delay);
+void timebase_alarm_ms(uint32_t ms_delay, uint32_t alarm_cb);
+void timebase_alarm_at(uint32_t cc, uint64_t deadline, uint32_t alarm_cb);
+
+void RTCC_IRQHandler(void);
+
+#endif /* SRC_HEADER_FILES_TIMEBASE_H_ */
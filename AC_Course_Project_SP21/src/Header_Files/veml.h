@@ -17,6 +17,7 @@
 #include "brd_config.h"
 #include "HW_delay.h"
 #include "app.h"
+#include "sensor.h"
 
 
 //***********************************************************************************
@@ -35,15 +36,80 @@
 #define VEML_ADDR				0x48
 #define VEML_READ				4
 #define VEML_CONFIG				0x00
+#define VEML_PSM				0x03
+#define VEML_ALS_WH				0x01
+#define VEML_ALS_WL				0x02
+#define VEML_ALS_INT			0x06
+
+#define VEML_CONF_GAIN_SHIFT	11			// ALS_GAIN, ALS_CONF_0 bits 12:11
+#define VEML_CONF_IT_SHIFT		6			// ALS_IT, ALS_CONF_0 bits 9:6
+#define VEML_CONF_PERS_SHIFT	4			// ALS_PERS, ALS_CONF_0 bits 5:4
+#define VEML_CONF_INT_EN		0x02		// ALS_INT_EN
+#define VEML_PERS_2				1			// 2 readings outside the window before the interrupt
+#define VEML_INT_TH_HIGH		0x4000		// ALS_INT, high threshold crossed
+#define VEML_INT_TH_LOW			0x8000		// ALS_INT, low threshold crossed
+#define VEML_WINDOW_MIN			10			// counts, keeps a dark window from closing to zero width
+#define VEML_PSM_MODE_SHIFT		1			// PSM, bits 2:1
+#define VEML_PSM_EN				0x01
+
+#define VEML_RES_MAX			0.0036		// lux per count at gain x2 and 800 ms
+#define VEML_LINEAR_LUX			1000.0		// readings above this get the datasheet correction
+
+#define VEML_RANGE_HIGH			60000		// counts, step towards less sensitive above
+#define VEML_RANGE_LOW			1000		// counts, step towards more sensitive below
+#define VEML_RANGE_DEFAULT		4			// gain x1, 100 ms
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef enum {
+	VemlGain1 = 0,
+	VemlGain2 = 1,
+	VemlGain1_8 = 2,
+	VemlGain1_4 = 3
+} VEML_GAIN;
+
+typedef enum {
+	VemlIt25 = 0x0C,
+	VemlIt50 = 0x08,
+	VemlIt100 = 0x00,
+	VemlIt200 = 0x01,
+	VemlIt400 = 0x02,
+	VemlIt800 = 0x03
+} VEML_IT;
+
+typedef enum {
+	VemlPsm500 = 0,				// ms added between measurements
+	VemlPsm1000 = 1,
+	VemlPsm2000 = 2,
+	VemlPsm4000 = 3
+} VEML_PSM_MODE;
 
 //***********************************************************************************
 // function prototypes
 //***********************************************************************************
 void veml_i2c_open(void);
+void veml_open(void);
 void veml_read(uint32_t veml_read_cb);
-void veml_write(void);
+void veml_arm(uint32_t veml_read_cb);
+void veml_write(uint32_t reg, uint32_t value);
+void veml_configure(VEML_GAIN gain, VEML_IT it);
+void veml_set_psm(bool enable, VEML_PSM_MODE mode);
+bool veml_autorange(void);
+void veml_window_set(uint32_t low, uint32_t high);
+void veml_window_center(uint32_t pct);
+void veml_window_close(void);
+uint32_t veml_int_status(void);
+uint32_t veml_integration_ms(void);
+uint32_t veml_burst_begin(void);
+void veml_burst_end(void);
+void veml_burst_read(uint32_t done_cb);
+uint32_t veml_counts(void);
+float veml_lux_per_count(void);
 float compute_lux(void);
 
+extern const SENSOR_DESC veml_light_sensor;
+
 
 
 #endif /* SRC_HEADER_FILES_VEML_H_ */
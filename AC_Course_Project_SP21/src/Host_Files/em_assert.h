@@ -0,0 +1,15 @@
+/*
+ * em_assert.h
+ *
+ *  Host stand-in for the emlib header, used by the host builds of the *_sim.c
+ *  programs only.  Host_Files is not on the firmware include path.
+ */
+
+#ifndef HOST_FILES_EM_ASSERT_H_
+#define HOST_FILES_EM_ASSERT_H_
+
+#include <assert.h>
+
+#define EFM_ASSERT(expr)		assert(expr)
+
+#endif /* HOST_FILES_EM_ASSERT_H_ */
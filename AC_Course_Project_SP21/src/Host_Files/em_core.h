@@ -0,0 +1,14 @@
+/*
+ * em_core.h
+ *
+ *  Host stand-in for the emlib header, a host program has no interrupts to mask.
+ */
+
+#ifndef HOST_FILES_EM_CORE_H_
+#define HOST_FILES_EM_CORE_H_
+
+#define CORE_DECLARE_IRQ_STATE		int irq_state_ = 0
+#define CORE_ENTER_CRITICAL()		(void) irq_state_
+#define CORE_EXIT_CRITICAL()		(void) irq_state_
+
+#endif /* HOST_FILES_EM_CORE_H_ */
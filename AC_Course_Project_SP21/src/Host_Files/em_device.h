@@ -0,0 +1,37 @@
+/*
+ * em_device.h
+ *
+ *  Host stand-in for the emlib header.  The flash is the region host_flash_open()
+ *  maps from a file, only as large as the journal, and the DWT cycle counter is a
+ *  plain variable that never counts.
+ */
+
+#ifndef HOST_FILES_EM_DEVICE_H_
+#define HOST_FILES_EM_DEVICE_H_
+
+#include <stdint.h>
+
+#define FLASH_PAGE_SIZE			2048
+#define FLASH_SIZE				(32 * FLASH_PAGE_SIZE)
+#define FLASH_BASE				((uintptr_t) host_flash)
+
+extern uint8_t *host_flash;
+
+typedef struct {
+	volatile uint32_t	CTRL;
+	volatile uint32_t	CYCCNT;
+} DWT_Type;
+
+typedef struct {
+	volatile uint32_t	DEMCR;
+} CoreDebug_Type;
+
+static DWT_Type			host_dwt __attribute__((unused));
+static CoreDebug_Type	host_core_debug __attribute__((unused));
+
+#define DWT							(&host_dwt)
+#define CoreDebug					(&host_core_debug)
+#define DWT_CTRL_CYCCNTENA_Msk		0x1
+#define CoreDebug_DEMCR_TRCENA_Msk	0x01000000
+
+#endif /* HOST_FILES_EM_DEVICE_H_ */
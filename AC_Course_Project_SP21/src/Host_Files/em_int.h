@@ -0,0 +1,10 @@
+/*
+ * em_int.h
+ *
+ *  Host stand-in for the emlib header, nothing in it is used on the host.
+ */
+
+#ifndef HOST_FILES_EM_INT_H_
+#define HOST_FILES_EM_INT_H_
+
+#endif /* HOST_FILES_EM_INT_H_ */
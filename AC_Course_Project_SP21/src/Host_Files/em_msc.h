@@ -0,0 +1,23 @@
+/*
+ * em_msc.h
+ *
+ *  Host stand-in for the emlib header.  journal_sim.c programs the mapped flash file
+ *  with the semantics of NOR flash: an erase sets every bit and a write can only
+ *  clear bits.
+ */
+
+#ifndef HOST_FILES_EM_MSC_H_
+#define HOST_FILES_EM_MSC_H_
+
+#include <stdint.h>
+
+typedef enum {
+	mscReturnOk = 0,
+	mscReturnInvalidAddr = -1
+} MSC_Status_TypeDef;
+
+void MSC_Init(void);
+MSC_Status_TypeDef MSC_ErasePage(uint32_t *startAddress);
+MSC_Status_TypeDef MSC_WriteWord(uint32_t *address, void const *data, uint32_t numBytes);
+
+#endif /* HOST_FILES_EM_MSC_H_ */
@@ -0,0 +1,10 @@
+/*
+ * em_rtcc.h
+ *
+ *  Host stand-in for the emlib header, nothing in it is used on the host.
+ */
+
+#ifndef HOST_FILES_EM_RTCC_H_
+#define HOST_FILES_EM_RTCC_H_
+
+#endif /* HOST_FILES_EM_RTCC_H_ */
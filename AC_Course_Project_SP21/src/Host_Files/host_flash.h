@@ -0,0 +1,21 @@
+/*
+ * host_flash.h
+ *
+ *  Flash and timebase of the host builds, implemented in journal_sim.c.
+ */
+
+#ifndef HOST_FILES_HOST_FLASH_H_
+#define HOST_FILES_HOST_FLASH_H_
+
+#include <stdint.h>
+#include <setjmp.h>
+
+#define HOST_FLASH_NEVER		-1
+
+extern jmp_buf host_flash_cut;
+
+void host_flash_open(const char *path);
+void host_flash_close(void);
+void host_flash_cut_after(int32_t words);
+
+#endif /* HOST_FILES_HOST_FLASH_H_ */
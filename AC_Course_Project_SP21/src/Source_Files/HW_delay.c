@@ -32,6 +32,12 @@
 //***********************************************************************************
 
 void timer_delay(uint32_t ms_delay){
+	// Sleep on the RTCC timebase when it is running instead of spinning on TIMER0
+	if (timebase_is_open()) {
+		timebase_delay_ms(ms_delay);
+		return;
+	}
+
 	uint32_t timer_clk_freq = CMU_ClockFreqGet(cmuClock_HFPER);
 	uint32_t delay_count = ms_delay *(timer_clk_freq/1000) / 1024;
 	CMU_ClockEnable(cmuClock_TIMER0, true);
@@ -19,11 +19,56 @@
 //***********************************************************************************
 // Private variables
 //***********************************************************************************
-static uint32_t humidity_data;
+static uint32_t reg_data;					// user register accesses of the self test
+static SAMPLE_RECORD rh_record;				// published by the I2C1 interrupt
+static SAMPLE_RECORD temp_record;
+static bool		measure_started;
+
+static uint32_t	user_reg;
+static bool		user_reg_valid;
+static uint32_t	config_data;
+
+// Maximum conversion times from the datasheet in 0.1 ms, indexed by RES1:RES0.
+// A humidity measurement is followed by a temperature conversion, so both count.
+static const uint8_t conv_rh_time[4] = { 120, 31, 45, 70 };
+static const uint8_t conv_temp_time[4] = { 108, 38, 62, 24 };
+
+//***********************************************************************************
+// Sensor descriptors
+//***********************************************************************************
+const SENSOR_DESC si7021_humidity_sensor = {
+	.name = "humidity",
+	.format = "humidity = %.1f%%\n",
+	.bus = SI7021_I2C,
+	.group = APP_SENSOR_SI7021,
+	.done_cb = SI7021_READ_CB,
+	.open = si7021_i2c_open,
+	.start_measure = si7021_measure_start,
+	.measure_time_ms = si7021_conversion_ms,
+	.read = si7021_fetch,
+	.convert = si7021_humidity_conversion
+};
+
+// Read from the humidity measurement, so it has to follow it on the bus
+const SENSOR_DESC si7021_temperature_sensor = {
+	.name = "temperature",
+	.format = "temperature = %.1f F\n",
+	.bus = SI7021_I2C,
+	.group = APP_SENSOR_SI7021,
+	.done_cb = SI7021_TEMP_READ_CB,
+	.open = 0,
+	.start_measure = 0,
+	.measure_time_ms = 0,
+	.read = si7021_temp_read,
+	.convert = temperature_calculation
+};
 
 //***********************************************************************************
 // Private function prototypes
 //***********************************************************************************
+static uint32_t si7021_user_reg_get(void);
+static void si7021_config_write(uint32_t reg, uint32_t value);
+static uint32_t si7021_res_index(uint32_t reg);
 
 
 //***********************************************************************************
@@ -45,6 +90,9 @@ static uint32_t humidity_data;
 void si7021_i2c_open() {
 	I2C_OPEN_STRUCT i2c_init_values;
 
+	sample_store_init(&rh_record);
+	sample_store_init(&temp_record);
+
 	i2c_init_values.enable = SI7021_ENABLE;
 	i2c_init_values.master = SI7021_MASTER;
 	i2c_init_values.refFreq = SI7021_REF_FREQ;
@@ -73,8 +121,49 @@ void si7021_i2c_open() {
  *
  ******************************************************************************/
 void si7021_read(uint32_t SI7021_read_cb) {
-	i2c_start(SI7021_I2C, SI7021_SLAVE_ADDRESS, SI7021_COMMAND, true, &humidity_data, SI7021_READ_CB, I2C_BYTES_2);
-	timer_delay(15);
+	i2c_read_record(SI7021_I2C, SI7021_SLAVE_ADDRESS, SI7021_COMMAND, &rh_record, SI7021_READ_CB, I2C_BYTES_2);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   SI7021 Fetch Function
+ *
+ * @details
+ * 	 Reads the result of the conversion si7021_measure_start() began without sending a command, polling with
+ * 	 NACKs if it is still converting.  If no conversion is outstanding, for example because a configuration
+ * 	 write dropped it, this falls back to si7021_read().
+ *
+ * @note
+ *   This function does not have any return values. The input value is the external device
+ *   callback in the event to be serviced.
+ *
+ ******************************************************************************/
+void si7021_fetch(uint32_t SI7021_read_cb) {
+	if(measure_started) {
+		measure_started = false;
+		i2c_read_record(SI7021_I2C, SI7021_SLAVE_ADDRESS, I2C_NO_REGISTER, &rh_record, SI7021_READ_CB, I2C_BYTES_2);
+	} else {
+		si7021_read(SI7021_read_cb);
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   SI7021 Armed Read Function
+ *
+ * @details
+ * 	 Calls i2c_arm with the same values as si7021_read so the next hardware trigger of I2C1
+ * 	 starts the humidity read without the CPU.
+ *
+ * @note
+ *   This function does not have any return values. The input value is the external device
+ *   callback in the event to be serviced.
+ *
+ ******************************************************************************/
+void si7021_arm(uint32_t SI7021_read_cb) {
+	i2c_arm_record(SI7021_I2C, SI7021_SLAVE_ADDRESS, SI7021_COMMAND, &rh_record, SI7021_READ_CB, I2C_BYTES_2);
 }
 
 
@@ -91,10 +180,144 @@ void si7021_read(uint32_t SI7021_read_cb) {
  *
  ******************************************************************************/
 void si7021_temp_read(uint32_t SI7021_read_cb) {
-	i2c_start(SI7021_I2C, SI7021_SLAVE_ADDRESS, TEMP_FROM_RH, true, &humidity_data, SI7021_TEMP_READ_CB, I2C_BYTES_2);
-	timer_delay(15);
+	i2c_read_record(SI7021_I2C, SI7021_SLAVE_ADDRESS, TEMP_FROM_RH, &temp_record, SI7021_TEMP_READ_CB, I2C_BYTES_2);
+}
+
+/***************************************************************************//**
+ * @brief
+ *   SI7021 Measure Start Function
+ *
+ * @details
+ * 	 Sends the no hold humidity measure command on its own so the conversion runs while the board
+ * 	 sleeps, and si7021_fetch() only has to read the result.  When the sensor engine pipelines the
+ * 	 conversion the reading is up to one sample period older than the tick that fetched it.
+ *
+ * @note
+ *   The SI7021 bus must be idle.  No callback event is raised for this transaction.
+ *
+ ******************************************************************************/
+void si7021_measure_start(void) {
+	i2c_start(SI7021_I2C, SI7021_SLAVE_ADDRESS, SI7021_COMMAND, false, 0, 0, I2C_BYTES_0);
+	measure_started = true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   SI7021 Set Resolution Function
+ *
+ * @details
+ * 	 Writes the RES1:RES0 bits of user register 1, keeping the other bits from the cached copy so the
+ * 	 reserved bits are written back as read.  Nothing is sent if the resolution is already set.
+ *
+ * @note
+ *   Blocks until the write has completed, call it between samples.
+ *
+ * @param[in] resolution
+ *   humidity and temperature resolution pair
+ *
+ ******************************************************************************/
+void si7021_set_resolution(SI7021_RESOLUTION resolution) {
+	uint32_t reg = si7021_user_reg_get();
+
+	if((reg & SI7021_USER_RES_MASK) == (uint32_t) resolution) {
+		return;
+	}
+
+	reg = (reg & ~SI7021_USER_RES_MASK) | (uint32_t) resolution;
+	si7021_config_write(SI7021_WRITE_USER_REG, reg);
+	user_reg = reg;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   SI7021 Get Resolution Function
+ *
+ * @return
+ *   the resolution pair in the cached user register 1
+ *
+ ******************************************************************************/
+SI7021_RESOLUTION si7021_get_resolution(void) {
+	return (SI7021_RESOLUTION) (si7021_user_reg_get() & SI7021_USER_RES_MASK);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   SI7021 Set Heater Function
+ *
+ * @details
+ * 	 Sets the heater current in the heater control register and then the HTRE bit of user register 1.
+ * 	 The heater raises the sensor temperature, so humidity readings taken with it on read low.
+ *
+ * @note
+ *   Blocks until the writes have completed, call it between samples.
+ *
+ * @param[in] enable
+ *   true turns the heater on
+ *
+ * @param[in] level
+ *   heater current setting 0 to 15, ignored when enable is false
+ *
+ ******************************************************************************/
+void si7021_set_heater(bool enable, uint32_t level) {
+	uint32_t reg = si7021_user_reg_get();
+
+	if(enable) {
+		EFM_ASSERT(level <= SI7021_HEATER_MASK);
+		si7021_config_write(SI7021_WRITE_HEATER_REG, level & SI7021_HEATER_MASK);
+		reg |= SI7021_USER_HTRE;
+	} else {
+		reg &= ~SI7021_USER_HTRE;
+	}
+
+	if(reg != user_reg) {
+		si7021_config_write(SI7021_WRITE_USER_REG, reg);
+		user_reg = reg;
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   SI7021 Conversion Time Function
+ *
+ * @details
+ * 	 Looks up the worst case time of a humidity measurement, including the temperature conversion that
+ * 	 follows it, at the cached resolution.
+ *
+ * @return
+ *   conversion time in milliseconds, rounded up
+ *
+ ******************************************************************************/
+uint32_t si7021_conversion_ms(void) {
+	return si7021_resolution_ms(si7021_get_resolution());
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   SI7021 Resolution Time Function
+ *
+ * @details
+ * 	 Looks up the worst case time of a humidity measurement, including the temperature conversion that
+ * 	 follows it, at a resolution that need not be the one set.
+ *
+ * @param[in] resolution
+ *   humidity and temperature resolution pair
+ *
+ * @return
+ *   conversion time in milliseconds, rounded up
+ *
+ ******************************************************************************/
+uint32_t si7021_resolution_ms(SI7021_RESOLUTION resolution) {
+	uint32_t index = si7021_res_index((uint32_t) resolution);
+
+	return (conv_rh_time[index] + conv_temp_time[index] + 9) / 10;
 }
 
+
 /***************************************************************************//**
  * @brief
  *   SI7021 Humidity Conversion Function
@@ -108,7 +331,7 @@ void si7021_temp_read(uint32_t SI7021_read_cb) {
  *
  ******************************************************************************/
 float si7021_humidity_conversion() {
-	float result = humidity_data;
+	float result = sample_store_read(&rh_record, 0);
 	result = (125.0 * result) / 65536.0 - 6.0;
 	return result;
 }
@@ -127,7 +350,7 @@ float si7021_humidity_conversion() {
  *
  ******************************************************************************/
 float temperature_calculation() {
-	float result = humidity_data;
+	float result = sample_store_read(&temp_record, 0);
 	result = ((175.72 * result) / 65536) - 46.85; // Celsius
 	return (result * 1.8 + 32); // Fahrenheit
 }
@@ -160,42 +383,111 @@ bool i2c_test(uint32_t si7021_read_cb) {
 
 	// Test Read Of User Register 1
 	bool read_write = true; // read
-	uint32_t previous_value = humidity_data;
-	i2c_start(SI7021_I2C, SI7021_SLAVE_ADDRESS, SI7021_READ_USER_REG, read_write, &humidity_data, SI7021_READ_CB, I2C_BYTES_1);
+	uint32_t previous_value = reg_data;
+	i2c_start(SI7021_I2C, SI7021_SLAVE_ADDRESS, SI7021_READ_USER_REG, read_write, &reg_data, SI7021_READ_CB, I2C_BYTES_1);
 	while(check_busy(SI7021_I2C));
 	timer_delay(15);
-	EFM_ASSERT(humidity_data == RESET_VAL || humidity_data == previous_value);
+	EFM_ASSERT(reg_data == RESET_VAL || reg_data == previous_value);
 
 	// Test Write To User Register 1
-	humidity_data = RES_CONFIG;
+	reg_data = RES_CONFIG;
 	read_write = false; //write
-	i2c_start(SI7021_I2C, SI7021_SLAVE_ADDRESS, SI7021_WRITE_USER_REG, read_write, &humidity_data, SI7021_READ_CB, I2C_BYTES_1);
+	i2c_start(SI7021_I2C, SI7021_SLAVE_ADDRESS, SI7021_WRITE_USER_REG, read_write, &reg_data, SI7021_READ_CB, I2C_BYTES_1);
 	while(check_busy(SI7021_I2C));
 	timer_delay(15);
-	EFM_ASSERT(humidity_data == RES_CONFIG);
+	EFM_ASSERT(reg_data == RES_CONFIG);
 
 	// Read Register Back To Make Sure Write Occurred
 	read_write = true; //read
-	i2c_start(SI7021_I2C, SI7021_SLAVE_ADDRESS, SI7021_READ_USER_REG, read_write, &humidity_data, SI7021_READ_CB, I2C_BYTES_1);
+	i2c_start(SI7021_I2C, SI7021_SLAVE_ADDRESS, SI7021_READ_USER_REG, read_write, &reg_data, SI7021_READ_CB, I2C_BYTES_1);
 	while(check_busy(SI7021_I2C));
 	timer_delay(15);
-	EFM_ASSERT(humidity_data == RES_8_12_BIT);
+	EFM_ASSERT(reg_data == RES_8_12_BIT);
 
 	// Test A 2-Byte Access Of The Humidity Reading
-	i2c_start(SI7021_I2C, SI7021_SLAVE_ADDRESS, SI7021_HUMI_NO_HOLD, read_write, &humidity_data, SI7021_READ_CB, I2C_BYTES_2);
+	i2c_read_record(SI7021_I2C, SI7021_SLAVE_ADDRESS, SI7021_HUMI_NO_HOLD, &rh_record, SI7021_READ_CB, I2C_BYTES_2);
 	while(check_busy(SI7021_I2C));
 	timer_delay(15);
 	int humidity = si7021_humidity_conversion();
 	EFM_ASSERT((humidity >= 20) && (humidity <= 60));
 
 	// Test A 2-Byte Access Of The Temperature Reading
-	i2c_start(SI7021_I2C, SI7021_SLAVE_ADDRESS, SI7021_TEMP_NO_HOLD, read_write, &humidity_data, SI7021_READ_CB, I2C_BYTES_2);
+	i2c_read_record(SI7021_I2C, SI7021_SLAVE_ADDRESS, SI7021_TEMP_NO_HOLD, &temp_record, SI7021_READ_CB, I2C_BYTES_2);
 	while(check_busy(SI7021_I2C));
 	timer_delay(15);
 	int temperature = temperature_calculation();
 	EFM_ASSERT((temperature >= 30) && (temperature <= 100));
 
 	success = true;
+	user_reg_valid = false;		// the test changed the user register behind the cache
 
 	return success;
 }
+
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   SI7021 User Register Read Function
+ *
+ * @details
+ * 	 Reads user register 1 over I2C the first time and returns the cached copy after that.  Every write
+ * 	 in this driver keeps the cache up to date.
+ *
+ * @return
+ *   user register 1
+ *
+ ******************************************************************************/
+uint32_t si7021_user_reg_get(void) {
+	if(!user_reg_valid) {
+		while(check_busy(SI7021_I2C));
+		i2c_start(SI7021_I2C, SI7021_SLAVE_ADDRESS, SI7021_READ_USER_REG, I2C_READ, &config_data, 0, I2C_BYTES_1);
+		while(check_busy(SI7021_I2C));
+		user_reg = config_data;
+		user_reg_valid = true;
+	}
+	return user_reg;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   SI7021 Configuration Write Function
+ *
+ * @details
+ * 	 Writes one configuration register and waits for the write to complete.  A conversion started by
+ * 	 si7021_measure_start() is waited out first since the SI7021 does not take commands while converting,
+ * 	 and its result is dropped so the next read measures again.
+ *
+ * @param[in] reg
+ *   write command of the register
+ *
+ * @param[in] value
+ *   register value
+ *
+ ******************************************************************************/
+void si7021_config_write(uint32_t reg, uint32_t value) {
+	while(check_busy(SI7021_I2C));
+
+	if(measure_started) {
+		timer_delay(si7021_conversion_ms());
+		measure_started = false;
+	}
+
+	config_data = value;
+	i2c_start(SI7021_I2C, SI7021_SLAVE_ADDRESS, reg, I2C_WRITE, &config_data, 0, I2C_BYTES_1);
+	while(check_busy(SI7021_I2C));
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Maps the RES1:RES0 bits of user register 1 to a conversion table index
+ *
+ ******************************************************************************/
+uint32_t si7021_res_index(uint32_t reg) {
+	return ((reg >> 6) & 0x02) | (reg & 0x01);
+}
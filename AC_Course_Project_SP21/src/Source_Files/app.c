@@ -13,22 +13,136 @@
 #include "app.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 //***********************************************************************************
 // defined files
 //***********************************************************************************
 //#define BLE_TEST_ENABLED
 #define TDD_TEST_ENABLED
+#define ADAPTIVE_RATE_ENABLED
+//#define HW_TRIGGER_ENABLED		// LETIMER0 underflow starts the sensor reads through PRS and LDMA
+#define SENSOR_PIPELINE_ENABLED		// start the next conversions right after the readout
+#define VEML_AUTORANGE_ENABLED		// pick the VEML7700 gain and integration time from the last reading
+//#define VEML_INT_ENABLED			// light changes wake the board through the VEML INT pin
+#define MULTI_RATE_ENABLED			// every sensor group at its own period on the RTCC instead of LETIMER0
+#define JOURNAL_ENABLED				// keep every sample in the flash journal
+#define STORE_FORWARD_ENABLED		// hold samples in the journal while no phone is connected
+#define REPORT_ON_CHANGE_ENABLED	// only readings that moved past their deadband are sent
+#define COMFORT_ENABLED				// report dew point, heat index and absolute humidity with the readings
+#define ENERGY_GOV_ENABLED			// stretch the period, batch and resolution to make the battery last
+
+#ifndef JOURNAL_ENABLED
+#undef STORE_FORWARD_ENABLED		// the journal is the backlog
+#endif
+
+#ifdef HW_TRIGGER_ENABLED
+#undef MULTI_RATE_ENABLED			// the LETIMER0 underflow triggers both buses together
+#endif
 
 //***********************************************************************************
 // Static / Private Variables
 //***********************************************************************************
+static APP_CONFIG	app_config = { (uint32_t) (PWM_PER * 1000), 1, APP_SENSOR_ALL,
+									SCHED_SI7021_PERIOD_MS, SCHED_VEML_PERIOD_MS, APP_FRESH_MS };
+
+static char			telemetry_frame[2][APP_FRAME_SIZE];
+static uint32_t		telemetry_frame_len;
+static uint32_t		telemetry_frame_samples;
+static uint32_t		telemetry_frame_index;
+
+static RATE_CTRL	rate_ctrl;
+static REPORT_FILTER	report_filter;
+static FILTER		led_filter;
+
+// Rate controller fixed point scale of every SENSOR_xxx reading
+static const uint32_t	rate_scale[SENSOR_NUM] = { 10, 10, 1 };
+
+// Groups that came due while a sample was still open, started once it is reported
+static uint32_t		sched_deferred;
+
+// SENSOR_xxx bits of #READ commands waiting on a fresh reading
+static uint32_t		read_requested;
+
+// Flash journal, appended records wait in RAM until the next flush
+static uint64_t		journal_flush_ms;	// last flush
+static bool			journal_low_supply;	// the battery nears its cutoff, every record is flushed
+
+// Store-and-forward, journal records before drain_next have been sent to the phone
+static bool			link_up;
+static bool			link_live = true;	// connected and the backlog drained, telemetry is sent
+static uint32_t		drain_next;
+static uint32_t		drain_end;			// one past the last record of the frame in flight
+static char			drain_frame[APP_DRAIN_FRAME_SIZE];
+
+// Journal records answering #LAST, #HIST and #PACK, sent a frame at a time
+static uint32_t		query_next;
+static uint32_t		query_end;
+static bool			query_busy;
+static char			query_frame[APP_DRAIN_FRAME_SIZE];
+static bool			query_packed;		// frames are delta packed, #PACK
+static uint32_t		query_text_bytes;	// what the packed records take as text
+static uint32_t		query_packed_bytes;
+static uint32_t		query_packed_records;
+
+// Light burst of #BURST, the sensor engine is held off while it runs
+static bool			burst_active;
+static bool			burst_pending;		// waiting for the open sample to be reported
+static uint32_t		burst_size;
+static uint32_t		burst_count;
+static uint32_t		burst_period_ms;
+static uint64_t		burst_start_ticks;
+static uint16_t		burst_counts[FLICKER_SAMPLES_MAX];
+
+// Energy budget governor, its levels from richest to leanest
+static ENERGY_GOV	energy_gov;
+static uint64_t		energy_sensor_nc;	// charge of the SI7021 conversions so far
+static uint64_t		energy_next_ms;		// end of the current governor window
+
+static const ENERGY_MODEL	energy_model = ENERGY_MODEL_DEFAULT;
+static const ENERGY_LEVEL	energy_level[ENERGY_LEVELS] = ENERGY_LEVEL_TABLE;
 
 
 //***********************************************************************************
 // Private functions
 //***********************************************************************************
 static void app_letimer_pwm_open(float period, float act_period, uint32_t out0_route, uint32_t out1_route);
+static void app_apply_command(BLE_COMMAND *cmd);
+static void app_telemetry_append(char *line);
+static void app_telemetry_sample_line(char *line);
+static void app_telemetry_sample_done(void);
+static void app_telemetry_flush(void);
+static void app_sample_complete(void);
+static void app_rate_open(void);
+static void app_rate_apply(void);
+static uint32_t app_period_max_ms(void);
+static void app_report_open(void);
+static void app_led_filter_open(FILTER_TYPE type);
+static void app_filter_benchmark(void);
+static void app_comfort_report(const SENSOR_SAMPLE *sample);
+static void app_comfort_benchmark(void);
+static void app_energy_open(uint32_t capacity_mwh, uint32_t lifetime_days);
+static void app_energy_meter(ENERGY_METER *meter);
+static void app_energy_update(void);
+static void app_energy_apply(void);
+static void app_energy_report(void);
+static void app_burst_start(void);
+static void app_burst_done(void);
+static void app_read_done(uint32_t done_cb);
+static void app_hw_trigger_open(void);
+static void app_sched_open(void);
+static void app_sched_start(uint32_t groups);
+static void app_read_reply(void);
+static void app_journal_append(const SENSOR_SAMPLE *sample);
+static void app_link_open(void);
+static void app_drain_next(void);
+static uint32_t app_journal_frame(char *frame, uint32_t first, uint32_t end, uint32_t *next);
+static uint32_t app_journal_line(char *line, uint32_t number, const JOURNAL_RECORD *record);
+static uint32_t app_packed_frame(char *frame, uint32_t first, uint32_t end, uint32_t *next);
+static void app_query_next(void);
+static void app_query_aggregate(uint32_t seconds);
+static uint64_t app_query_since(uint32_t seconds);
+static void app_rollup_report(ROLLUP_TIER_ID tier, uint32_t age);
 
 //***********************************************************************************
 // Global functions
@@ -47,16 +161,44 @@ static void app_letimer_pwm_open(float period, float act_period, uint32_t out0_r
  ******************************************************************************/
 void app_peripheral_setup(void){
 	cmu_open();
+	timebase_open();
+#ifdef JOURNAL_ENABLED
+	journal_open();
+#endif
 	gpio_open();
 	scheduler_open();
 	sleep_open();
 	sleep_block_mode(SYSTEM_BLOCK_EM);
 	ble_open(BLE_TX_DONE_CB, BLE_RX_DONE_CB);
+#ifdef STORE_FORWARD_ENABLED
+	app_link_open();
+#endif
 	add_scheduled_event(BOOT_UP_CB);
-	app_letimer_pwm_open(PWM_PER, PWM_ACT_PER, PWM_ROUTE_0, PWM_ROUTE_1);
-	si7021_i2c_open();
-	veml_i2c_open();
-	veml_write();
+	letimer_ulfrco_calibrate(LETIMER0);
+#ifdef VEML_INT_ENABLED
+	app_config.period_ms = VEML_HEARTBEAT_MS;
+#endif
+	app_letimer_pwm_open(app_config.period_ms / 1000.0, PWM_ACT_PER, PWM_ROUTE_0, PWM_ROUTE_1);
+#ifdef ENERGY_GOV_ENABLED
+	supply_open();
+	app_energy_open(ENERGY_BATTERY_MWH, ENERGY_LIFETIME_DAYS);
+#endif
+	app_rate_open();
+	app_report_open();
+	app_led_filter_open(LED_FILTER);
+	rollup_open();
+#if defined(SENSOR_PIPELINE_ENABLED) && !defined(HW_TRIGGER_ENABLED)
+	sensor_open(SENSOR_MEASURE_CB, SAMPLE_DONE_CB, true);
+#else
+	sensor_open(SENSOR_MEASURE_CB, SAMPLE_DONE_CB, false);
+#endif
+
+#ifdef VEML_INT_ENABLED
+	gpio_irq_open(VEML_INT_PORT, VEML_INT_PIN, false, true, VEML_INT_CB);
+#endif
+#ifdef MULTI_RATE_ENABLED
+	app_sched_open();
+#endif
 }
 
 /***************************************************************************//**
@@ -89,7 +231,11 @@ void app_letimer_pwm_open(float period, float act_period, uint32_t out0_route, u
 
 	app_letimer_pwm_struct.period = period;
 	app_letimer_pwm_struct.active_period = act_period;
+#if defined(HW_TRIGGER_ENABLED) || defined(MULTI_RATE_ENABLED)
+	app_letimer_pwm_struct.uf_irq_enable = false;
+#else
 	app_letimer_pwm_struct.uf_irq_enable = true;
+#endif
 	app_letimer_pwm_struct.uf_cb = LETIMER0_UF_CB;
 	app_letimer_pwm_struct.comp0_irq_enable = false;
 	app_letimer_pwm_struct.comp0_cb = LETIMER0_COMP0_CB;
@@ -139,7 +285,9 @@ void scheduled_letimer0_comp1_cb(void) {
  *	uf callback function
  *
  * @details
- *	This function call removes the uf event from the event scheduler.
+ *	Starts a sample of the enabled sensors.  The sensor engine reads the SI7021 on I2C1
+ *	and the VEML7700 on I2C0 concurrently.  A tick that arrives while the previous
+ *	sample is still on the bus is skipped.
  *
  * @note
  *	This function does not return any values.
@@ -149,8 +297,29 @@ void scheduled_letimer0_uf_cb(void) {
 	EFM_ASSERT(get_scheduled_events() & LETIMER0_UF_CB);
 	remove_scheduled_event(LETIMER0_UF_CB);
 
-	si7021_read(SI7021_READ_CB);
-	veml_read(VEML_CB);
+	if(!burst_active) {
+		sensor_sample_start(app_config.sensor_en);
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *	sensor conversion time callback
+ *
+ * @details
+ *	Raised by the timebase alarm once the conversions started for the sample have had
+ *	their worst case time, the sensor engine then launches the reads.
+ *
+ * @note
+ *	This function does not have any input or return values.
+ *
+ ******************************************************************************/
+void scheduled_sensor_measure_cb(void) {
+	EFM_ASSERT(get_scheduled_events() & SENSOR_MEASURE_CB);
+	remove_scheduled_event(SENSOR_MEASURE_CB);
+
+	sensor_measure_done();
 }
 
 
@@ -160,7 +329,6 @@ void scheduled_letimer0_uf_cb(void) {
  *
  * @details
  *	This SI7021 humidity done callback signals the completion of a humidity read from the peripheral.
- *	This callback has been added in the scheduler of the main.c's while(1) loop.
  *
  * @note
  *	This function does not have any input or return values.
@@ -170,19 +338,7 @@ void scheduled_si7021_humidity_cb(void) {
 	EFM_ASSERT(get_scheduled_events() & SI7021_READ_CB);
 	remove_scheduled_event(SI7021_READ_CB);
 
-	float returned_humidity = si7021_humidity_conversion();
-
-	if (returned_humidity >= 30.0) {
-		GPIO_PinOutSet(LED1_PORT, LED1_PIN);
-	} else {
-		GPIO_PinOutClear(LED1_PORT, LED1_PIN);
-	}
-
-	char humidity_str[80];
-	sprintf(humidity_str, "humidity = %.1f%%\n", returned_humidity);
-	ble_write(humidity_str);
-
-	si7021_temp_read(SI7021_READ_CB);
+	app_read_done(SI7021_READ_CB);
 }
 
 
@@ -191,9 +347,7 @@ void scheduled_si7021_humidity_cb(void) {
  *	SI7021 humidity peripheral temperature data callback
  *
  * @details
- *	This SI7021 humidity done callback signals the completion of a humidity read from the peripheral.
- *	The temperature_calculation function is utilized to write the temperature.
- *	This callback has been added in the scheduler of the main.c's while(1) loop.
+ *	This SI7021 temperature done callback signals the completion of a temperature read from the peripheral.
  *
  * @note
  *	This function does not have any input or return values.
@@ -203,11 +357,7 @@ void scheduled_si7021_temp_cb(void) {
 	EFM_ASSERT(get_scheduled_events() & SI7021_TEMP_READ_CB);
 	remove_scheduled_event(SI7021_TEMP_READ_CB);
 
-	float returned_temperature = temperature_calculation();
-
-	char temperature_str[80];
-	sprintf(temperature_str, "temperature = %.1f F\n", returned_temperature);
-	ble_write(temperature_str);
+	app_read_done(SI7021_TEMP_READ_CB);
 }
 
 
@@ -217,8 +367,6 @@ void scheduled_si7021_temp_cb(void) {
  *
  * @details
  *	This veml read callback signals the completion of a light sensor read from the peripheral.
- *	The compute_lux function is utilized to write the light value.
- *	This callback has been added in the scheduler of the main.c's while(1) loop.
  *
  * @note
  *	This function does not have any input or return values.
@@ -228,11 +376,321 @@ void scheduled_veml_read_cb(void) {
 	EFM_ASSERT(get_scheduled_events() & VEML_CB);
 	remove_scheduled_event(VEML_CB);
 
-	float returned_lux = compute_lux();
-	unsigned int unsigned_returned_lux = (unsigned int) returned_lux;
-	char lux_str[80];
-	sprintf(lux_str, "light = %i lux \n\n", unsigned_returned_lux);
-	ble_write(lux_str);
+	app_read_done(VEML_CB);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *	VEML threshold interrupt callback
+ *
+ * @details
+ *	The light left the window around the last reading.  The status read releases the
+ *	INT pin and a light only sample is taken right away, its report re-centers the
+ *	window on the new reading.  If a sample is already open the light sample is
+ *	deferred until that sample has been reported.
+ *
+ * @note
+ *	This function does not have any input or return values.
+ *
+ ******************************************************************************/
+void scheduled_veml_int_cb(void) {
+	EFM_ASSERT(get_scheduled_events() & VEML_INT_CB);
+	remove_scheduled_event(VEML_INT_CB);
+
+	if(!veml_int_status()) {
+		return;
+	}
+
+	app_sched_start(APP_SENSOR_VEML);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *	multi-rate schedule callback
+ *
+ * @details
+ *	Raised by the RTCC when one or more sensor groups are due.  Groups due together,
+ *	or within SAMPLE_SCHED_MERGE_MS of each other, are read in a single sample.
+ *
+ * @note
+ *	This function does not have any input or return values.
+ *
+ ******************************************************************************/
+void scheduled_sched_due_cb(void) {
+	EFM_ASSERT(get_scheduled_events() & SCHED_DUE_CB);
+	remove_scheduled_event(SCHED_DUE_CB);
+
+	app_sched_start(sample_sched_due() & app_config.sensor_en);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *	sensor cache ready callback
+ *
+ * @details
+ *	Raised once the readings requested with #READ are fresh in the sensor cache,
+ *	either straight away or after the one bus read that every waiting request shares.
+ *
+ * @note
+ *	This function does not have any input or return values.
+ *
+ ******************************************************************************/
+void scheduled_sensor_ready_cb(void) {
+	EFM_ASSERT(get_scheduled_events() & SENSOR_READY_CB);
+	remove_scheduled_event(SENSOR_READY_CB);
+
+	app_read_reply();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *	BLE connection state callback
+ *
+ * @details
+ *	Raised on both edges of the module STATE pin.  On a disconnect the telemetry
+ *	stops and the samples only go to the journal.  On a connect the journal backlog
+ *	is drained from the progress marker before live telemetry resumes, so a link that
+ *	drops again mid-drain resumes where it stopped.
+ *
+ * @note
+ *	This function does not have any input or return values.
+ *
+ ******************************************************************************/
+void scheduled_ble_link_cb(void) {
+	EFM_ASSERT(get_scheduled_events() & BLE_LINK_CB);
+	remove_scheduled_event(BLE_LINK_CB);
+
+	bool up = ble_connected();
+
+	if(up == link_up) {
+		return;
+	}
+	link_up = up;
+
+	if(!link_up) {
+		link_live = false;
+	} else {
+		app_drain_next();
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *	BLE backlog frame sent callback
+ *
+ * @details
+ *	The LEUART has released the drain frame.  If the link held, its records count as
+ *	delivered and the marker moves past them, then the next frame is sent.
+ *
+ * @note
+ *	This function does not have any input or return values.
+ *
+ ******************************************************************************/
+void scheduled_ble_drain_cb(void) {
+	EFM_ASSERT(get_scheduled_events() & BLE_DRAIN_CB);
+	remove_scheduled_event(BLE_DRAIN_CB);
+
+	if(link_up && ble_connected()) {
+		drain_next = drain_end;
+	}
+	drain_end = JOURNAL_NONE;
+	app_drain_next();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *	query frame sent callback
+ *
+ * @details
+ *	Sends the next frame of the #LAST or #HIST answer.
+ *
+ * @note
+ *	This function does not have any input or return values.
+ *
+ ******************************************************************************/
+void scheduled_query_tx_cb(void) {
+	EFM_ASSERT(get_scheduled_events() & QUERY_TX_CB);
+	remove_scheduled_event(QUERY_TX_CB);
+
+	query_busy = false;
+	app_query_next();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *	light burst tick callback
+ *
+ * @details
+ *	Raised by the timebase alarm once per VEML integration time, starts the read of
+ *	the reading that just completed.
+ *
+ * @note
+ *	This function does not have any input or return values.
+ *
+ ******************************************************************************/
+void scheduled_burst_tick_cb(void) {
+	EFM_ASSERT(get_scheduled_events() & BURST_TICK_CB);
+	remove_scheduled_event(BURST_TICK_CB);
+
+	while(check_busy(VEML_I2C));
+	veml_burst_read(BURST_READ_CB);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *	light burst read callback
+ *
+ * @details
+ *	Stores the reading and arms the alarm of the next one.  The deadlines are taken
+ *	from the start of the burst so the period does not drift with the rounding to
+ *	timebase ticks.
+ *
+ * @note
+ *	This function does not have any input or return values.
+ *
+ ******************************************************************************/
+void scheduled_burst_read_cb(void) {
+	EFM_ASSERT(get_scheduled_events() & BURST_READ_CB);
+	remove_scheduled_event(BURST_READ_CB);
+
+	burst_counts[burst_count++] = (uint16_t) veml_counts();
+	if(burst_count < burst_size) {
+		timebase_alarm_at(TIMEBASE_ALARM_CC, burst_start_ticks +
+				TIMEBASE_MS_TO_TICKS((burst_count + 1) * burst_period_ms), BURST_TICK_CB);
+	} else {
+		app_burst_done();
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *	sample complete callback
+ *
+ * @details
+ *	Raised once every reading launched for the sample has been converted.  The readings
+ *	are reported together under the timestamp of the launch, so a frame never splits a
+ *	sample, after a line with the time the buses were active.  Every registered reading
+ *	is reported with the format of its descriptor.  The readings also go into the
+ *	rollups, and the summary of every hour is reported as it closes.
+ *
+ *	LED1 follows the humidity through led_filter, so a single noisy reading does not
+ *	toggle it.
+ *
+ *	With REPORT_ON_CHANGE_ENABLED only the readings that moved past their deadband, or
+ *	hit the heartbeat, are formatted, and a sample without any is not sent at all.  It
+ *	still counts towards the batch, so a change never waits longer for its frame.
+ *
+ * @note
+ *	This function does not have any input or return values.
+ *
+ ******************************************************************************/
+void scheduled_sample_done_cb(void) {
+	EFM_ASSERT(get_scheduled_events() & SAMPLE_DONE_CB);
+	remove_scheduled_event(SAMPLE_DONE_CB);
+
+	const SENSOR_SAMPLE *sample = sensor_sample();
+	uint64_t time_ms = TIMEBASE_TICKS_TO_MS(sample->start_ticks);
+	uint32_t rollup_closed = 0;
+	uint32_t report = 0;
+	int32_t value;
+	char line[80];
+
+	for(uint32_t i = 0; i < SENSOR_NUM; i++) {
+		if(sample->launched & (1 << i)) {
+			value = (int32_t) (sample->value[i] * rate_scale[i]);
+			rate_ctrl_observe(&rate_ctrl, i, value);
+			rollup_closed |= rollup_add(i, value, time_ms);
+#ifdef REPORT_ON_CHANGE_ENABLED
+			if(report_filter_check(&report_filter, i, value, time_ms)) {
+				report |= 1 << i;
+			}
+#else
+			report |= 1 << i;
+#endif
+		}
+	}
+
+	if(report) {
+		sprintf(line, "t = %lu ms, read %lu ms\n", (unsigned long) time_ms,
+				(unsigned long) TIMEBASE_TICKS_TO_MS(sample->done_ticks - sample->start_ticks));
+		app_telemetry_sample_line(line);
+
+		for(uint32_t i = 0; i < SENSOR_NUM; i++) {
+			if(report & (1 << i)) {
+				sprintf(line, sensor_get(i)->format, sample->value[i]);
+				app_telemetry_sample_line(line);
+			}
+		}
+#ifdef COMFORT_ENABLED
+		if((sample->launched & APP_COMFORT_SENSORS) == APP_COMFORT_SENSORS) {
+			app_comfort_report(sample);
+		}
+#endif
+		app_telemetry_sample_line("\n");
+	}
+
+	if(rollup_closed & (1 << RollupHour)) {
+		app_rollup_report(RollupHour, 1);
+	}
+
+#ifdef JOURNAL_ENABLED
+	app_journal_append(sample);
+#endif
+
+	if(sample->launched & (1 << SENSOR_HUMIDITY)) {
+		if (filter_step(&led_filter, (int16_t) (sample->value[SENSOR_HUMIDITY] * 10)) >= LED_HUMIDITY_THR) {
+			GPIO_PinOutSet(LED1_PORT, LED1_PIN);
+		} else {
+			GPIO_PinOutClear(LED1_PORT, LED1_PIN);
+		}
+	}
+
+	if(sample->launched & (1 << SENSOR_LIGHT)) {
+#ifdef VEML_AUTORANGE_ENABLED
+		veml_autorange();
+#endif
+#ifdef VEML_INT_ENABLED
+		veml_window_center(VEML_WINDOW_PCT);
+#endif
+	}
+
+#ifdef ENERGY_GOV_ENABLED
+	if(sample->launched & (1 << SENSOR_HUMIDITY)) {
+		energy_sensor_nc += si7021_conversion_ms() * ENERGY_SI7021_UA;
+	}
+#endif
+
+	app_sample_complete();
+
+#ifdef ENERGY_GOV_ENABLED
+	if(timebase_ms() >= energy_next_ms) {
+		app_energy_update();
+	}
+#endif
+
+#ifdef HW_TRIGGER_ENABLED
+	si7021_arm(SI7021_READ_CB);
+	veml_arm(VEML_CB);
+#endif
+
+	if(burst_pending) {
+		app_burst_start();
+	}
+
+	if(sched_deferred) {
+		uint32_t groups = sched_deferred;
+		sched_deferred = 0;
+		app_sched_start(groups);
+	}
 }
 
 
@@ -264,10 +722,29 @@ void scheduled_boot_up_cb(void) {
 		bool tdd_test_result = i2c_test(SI7021_READ_CB);
 		EFM_ASSERT(tdd_test_result);
 		timer_delay(DELAY);
+
+		tdd_test_result = filter_test();
+		EFM_ASSERT(tdd_test_result);
+
+		// The level table is shared with the host simulation, which cannot ask the driver
+		for(uint32_t i = 0; i < ENERGY_LEVELS; i++) {
+			EFM_ASSERT(si7021_resolution_ms((SI7021_RESOLUTION) energy_level[i].resolution)
+					== energy_level[i].conversion_ms);
+		}
+		app_filter_benchmark();
+		app_comfort_benchmark();
 	#endif
 
 	ble_write("\nHello World\n");
+
+#ifdef HW_TRIGGER_ENABLED
+	app_hw_trigger_open();
+#endif
+#ifdef MULTI_RATE_ENABLED
+	sample_sched_start();
+#else
 	letimer_start(LETIMER0, true);
+#endif
 }
 
 
@@ -285,3 +762,1233 @@ void scheduled_ble_tx_done_cb(void) {
 	EFM_ASSERT(get_scheduled_events() & BLE_TX_DONE_CB);
 	remove_scheduled_event(BLE_TX_DONE_CB);
 }
+
+
+/***************************************************************************//**
+ * @brief
+ *   callback function called after a complete command is received
+ *
+ * @details
+ *   The LEUART signal frame interrupt raises this event once a command end character
+ *   has arrived.  Every complete command waiting in the receive buffer is decoded and
+ *   applied to the runtime configuration.
+ *
+ * @note
+ *     no inputs, no outputs
+ ******************************************************************************/
+void scheduled_ble_rx_done_cb(void) {
+	EFM_ASSERT(get_scheduled_events() & BLE_RX_DONE_CB);
+	remove_scheduled_event(BLE_RX_DONE_CB);
+
+	BLE_COMMAND cmd;
+	while(ble_read_command(&cmd)) {
+		app_apply_command(&cmd);
+	}
+}
+
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Applies a command received from the phone
+ *
+ * @details
+ *   Out of range values are clamped.  A new sample period becomes the adaptive
+ *   controller's fastest rate, applied to the running LETIMER0 at its next underflow
+ *   or, on the multi-rate schedule, as the stretch of every group's period.
+ *   The SI7021 and VEML7700 periods of the multi-rate schedule apply from the group's
+ *   next sample.  A #READ is served from the sensor cache when the reading is fresh.
+ *
+ * @param[in] cmd
+ *   decoded command from ble_read_command()
+ *
+ ******************************************************************************/
+void app_apply_command(BLE_COMMAND *cmd) {
+	// #BURST defaults to BURST_SAMPLES readings and #ENERGY takes no value
+	if(!cmd->has_value && (cmd->id != CmdBurst) && (cmd->id != CmdEnergy)) {
+		return;
+	}
+
+	switch(cmd->id) {
+		case CmdSamplePeriod:
+			app_config.period_ms = cmd->value;
+			if(app_config.period_ms < APP_PERIOD_MIN_MS) {
+				app_config.period_ms = APP_PERIOD_MIN_MS;
+			}
+			if(app_config.period_ms > app_period_max_ms()) {
+				app_config.period_ms = app_period_max_ms();
+			}
+			app_rate_open();
+			app_rate_apply();
+			break;
+		case CmdBatchSize:
+			app_config.batch_size = cmd->value;
+			if(app_config.batch_size < 1) {
+				app_config.batch_size = 1;
+			}
+			if(app_config.batch_size > APP_BATCH_MAX) {
+				app_config.batch_size = APP_BATCH_MAX;
+			}
+			break;
+		case CmdSensorEnable:
+#ifndef HW_TRIGGER_ENABLED
+			app_config.sensor_en = cmd->value & APP_SENSOR_ALL;
+#endif
+			break;
+		case CmdResolution:
+			if(cmd->value == 12) {
+				si7021_set_resolution(Si7021ResRh12T14);
+			} else if(cmd->value == 11) {
+				si7021_set_resolution(Si7021ResRh11T11);
+			} else if(cmd->value == 10) {
+				si7021_set_resolution(Si7021ResRh10T13);
+			} else if(cmd->value == 8) {
+				si7021_set_resolution(Si7021ResRh8T12);
+			}
+			break;
+		case CmdHeater:
+			if(cmd->value > SI7021_HEATER_MASK + 1) {
+				cmd->value = SI7021_HEATER_MASK + 1;
+			}
+			si7021_set_heater(cmd->value != 0, cmd->value ? cmd->value - 1 : 0);
+			break;
+		case CmdSi7021Period:
+			app_config.si7021_period_ms = cmd->value < APP_PERIOD_MIN_MS ? APP_PERIOD_MIN_MS : cmd->value;
+#ifdef MULTI_RATE_ENABLED
+			sample_sched_set(APP_SENSOR_SI7021, app_config.si7021_period_ms, SCHED_SI7021_PHASE_MS);
+#endif
+			break;
+		case CmdVemlPeriod:
+			app_config.veml_period_ms = cmd->value < APP_PERIOD_MIN_MS ? APP_PERIOD_MIN_MS : cmd->value;
+#ifdef MULTI_RATE_ENABLED
+			sample_sched_set(APP_SENSOR_VEML, app_config.veml_period_ms, SCHED_VEML_PHASE_MS);
+#endif
+			break;
+		case CmdRead:
+			if(cmd->value < SENSOR_NUM) {
+				read_requested |= 1 << cmd->value;
+#ifdef HW_TRIGGER_ENABLED
+				add_scheduled_event(SENSOR_READY_CB);
+#else
+				if(!burst_active) {
+					sensor_request(cmd->value, app_config.fresh_ms, SENSOR_READY_CB);
+				}
+#endif
+			}
+			break;
+		case CmdFreshness:
+			app_config.fresh_ms = cmd->value;
+			break;
+		case CmdResume:
+#ifdef STORE_FORWARD_ENABLED
+			drain_next = cmd->value;
+			link_live = false;
+			app_drain_next();
+#endif
+			break;
+#ifdef JOURNAL_ENABLED
+		case CmdLast:
+			query_last_n(cmd->value, &query_next, &query_end);
+			query_packed = false;
+			app_query_next();
+			break;
+		case CmdHistory:
+			query_range(app_query_since(cmd->value), UINT64_MAX, &query_next, &query_end);
+			query_packed = false;
+			app_query_next();
+			break;
+		case CmdPacked:
+			query_last_n(cmd->value, &query_next, &query_end);
+			query_packed = true;
+			query_text_bytes = 0;
+			query_packed_bytes = 0;
+			query_packed_records = 0;
+			app_query_next();
+			break;
+		case CmdAggregate:
+			app_query_aggregate(cmd->value);
+			break;
+#endif
+		case CmdHumidityBand:
+			report_filter_channel_set(&report_filter, SENSOR_HUMIDITY, cmd->value, 0);
+			break;
+		case CmdTemperatureBand:
+			report_filter_channel_set(&report_filter, SENSOR_TEMPERATURE, cmd->value, 0);
+			break;
+		case CmdLightBand:
+			report_filter_channel_set(&report_filter, SENSOR_LIGHT, REPORT_LIGHT_BAND, cmd->value);
+			break;
+		case CmdSilence:
+			report_filter.max_silence_ms = cmd->value * 1000;
+			break;
+		case CmdFilter:
+			if(cmd->value < FilterTypes) {
+				app_led_filter_open((FILTER_TYPE) cmd->value);
+			}
+			break;
+#ifndef HW_TRIGGER_ENABLED
+		case CmdBurst:
+			if(burst_active) {
+				break;						// burst_counts is being filled for the running burst
+			}
+			burst_size = FLICKER_SAMPLES_MIN;
+			while(burst_size * 4 <= (cmd->has_value ? cmd->value : BURST_SAMPLES) && burst_size * 4 <= FLICKER_SAMPLES_MAX) {
+				burst_size *= 4;
+			}
+			app_burst_start();
+			break;
+#endif
+#ifdef ENERGY_GOV_ENABLED
+		case CmdLifetime:
+			energy_gov_target(&energy_gov, (uint32_t) (energy_gov.capacity_nj / ENERGY_NJ_PER_MWH), cmd->value,
+					ENERGY_CUTOFF_MV);
+			break;
+		case CmdBattery:
+			app_energy_open(cmd->value, energy_gov.lifetime_days);
+			app_energy_apply();
+			break;
+		case CmdEnergy:
+			app_energy_report();
+			break;
+#endif
+		case CmdRollup:
+			if(cmd->value < RollupTiers) {
+				for(uint32_t age = 0; rollup_get((ROLLUP_TIER_ID) cmd->value, age); age++) {
+					app_rollup_report((ROLLUP_TIER_ID) cmd->value, age);
+				}
+				app_telemetry_flush();
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Appends one telemetry line to the BLE frame being built
+ *
+ * @details
+ *   The frame is flushed early if the line would not fit.
+ *
+ * @param[in] line
+ *   NUL terminated telemetry text
+ *
+ ******************************************************************************/
+void app_telemetry_append(char *line) {
+	uint32_t line_len = strlen(line);
+
+	if(telemetry_frame_len + line_len > APP_FRAME_SIZE) {
+		app_telemetry_flush();
+	}
+	if(line_len > APP_FRAME_SIZE) {
+		line_len = APP_FRAME_SIZE;
+	}
+
+	memcpy(&telemetry_frame[telemetry_frame_index][telemetry_frame_len], line, line_len);
+	telemetry_frame_len += line_len;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Appends one line of a sample's readings to the BLE frame being built
+ *
+ * @details
+ *   While no phone is connected, or the backlog is being drained, the line is left
+ *   out.  The journal holds the sample and sends it with the backlog.
+ *
+ * @param[in] line
+ *   NUL terminated telemetry text
+ *
+ ******************************************************************************/
+void app_telemetry_sample_line(char *line) {
+#ifdef STORE_FORWARD_ENABLED
+	if(!link_live) {
+		return;
+	}
+#endif
+	app_telemetry_append(line);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Marks the end of one sample in the BLE frame being built
+ *
+ * @details
+ *   The frame is sent once batch_size samples are collected, or more when the energy
+ *   governor asks for fewer, larger frames.
+ *
+ ******************************************************************************/
+void app_telemetry_sample_done(void) {
+	uint32_t batch_size = app_config.batch_size;
+
+#ifdef ENERGY_GOV_ENABLED
+	if(batch_size < energy_level[energy_gov.level].batch_size) {
+		batch_size = energy_level[energy_gov.level].batch_size;
+	}
+#endif
+
+	telemetry_frame_samples++;
+	if(telemetry_frame_samples >= batch_size) {
+		app_telemetry_flush();
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Sends the BLE frame being built
+ *
+ * @details
+ *   The frame is handed to the BLE module without a copy and building continues in
+ *   the other frame buffer.  The LEUART driver owns the sent buffer until
+ *   BLE_TX_DONE_CB, and ble_write_segments() waits for that before a buffer is reused.
+ *   While the backlog is being drained the frame only holds what the journal cannot
+ *   replay, command replies, summaries and rollups, and goes out between the backlog
+ *   frames.  While no phone is connected it is dropped.
+ *
+ ******************************************************************************/
+void app_telemetry_flush(void) {
+	LEUART_TX_SEGMENT frame;
+
+	if(telemetry_frame_len && (link_live || link_up)) {
+		frame.data = telemetry_frame[telemetry_frame_index];
+		frame.length = telemetry_frame_len;
+		bool sent = ble_write_segments(&frame, 1, BLE_TX_DONE_CB);
+		EFM_ASSERT(sent);
+		telemetry_frame_index ^= 1;
+	}
+	telemetry_frame_len = 0;
+	telemetry_frame_samples = 0;
+
+#ifdef STORE_FORWARD_ENABLED
+	if(link_live) {
+		drain_next = journal_next();
+	}
+#endif
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Closes one sample across all enabled sensors
+ *
+ * @details
+ *   Ends the sample in the telemetry frame and lets the adaptive rate controller
+ *   stretch or shorten the LETIMER0 period based on how much the readings moved.
+ *   On the multi-rate schedule the controller stretches every group's period by the
+ *   same factor instead.
+ *
+ ******************************************************************************/
+void app_sample_complete(void) {
+	sensor_sample_release();
+	app_telemetry_sample_done();
+
+#ifdef ADAPTIVE_RATE_ENABLED
+	if(rate_ctrl_update(&rate_ctrl)) {
+		app_rate_apply();
+	}
+#endif
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Opens the adaptive rate controller
+ *
+ * @details
+ *   The configured sample period, stretched by the energy governor's level, is the
+ *   fastest rate the controller will use.
+ *
+ ******************************************************************************/
+void app_rate_open(void) {
+	uint32_t limit_ms = app_period_max_ms();
+	uint32_t min_period_ms = app_config.period_ms;
+	uint32_t max_period_ms = RATE_MAX_PERIOD_MS;
+
+#ifdef ENERGY_GOV_ENABLED
+	min_period_ms *= energy_level[energy_gov.level].period_mult;
+#endif
+	if(min_period_ms > limit_ms) {
+		min_period_ms = app_config.period_ms > limit_ms ? app_config.period_ms : limit_ms;
+	}
+
+	if(max_period_ms > limit_ms) {
+		max_period_ms = limit_ms;
+	}
+	if(max_period_ms < min_period_ms) {
+		max_period_ms = min_period_ms;
+	}
+
+	rate_ctrl_init(&rate_ctrl, min_period_ms, max_period_ms, RATE_STABLE_SAMPLES);
+	rate_ctrl_channel_set(&rate_ctrl, RATE_CH_HUMIDITY, RATE_HUMIDITY_THR, 0);
+	rate_ctrl_channel_set(&rate_ctrl, RATE_CH_TEMPERATURE, RATE_TEMPERATURE_THR, 0);
+	rate_ctrl_channel_set(&rate_ctrl, RATE_CH_LIGHT, RATE_LIGHT_THR, RATE_LIGHT_THR_PCT);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Runs the sampling at the rate controller's period
+ *
+ * @details
+ *   On the multi-rate schedule every group's period is stretched by the controller's
+ *   period over the configured one, which keeps the ratios between the groups.
+ *
+ ******************************************************************************/
+void app_rate_apply(void) {
+#ifdef MULTI_RATE_ENABLED
+	sample_sched_stretch(rate_ctrl.period_ms, app_config.period_ms);
+#else
+	letimer_pwm_set_period(LETIMER0, rate_ctrl.period_ms / 1000.0, PWM_ACT_PER);
+#endif
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the longest sample period LETIMER0 can run
+ *
+ * @details
+ *   APP_PERIOD_MAX_MS, or less once the ULFRCO calibrated fast enough that COMP0
+ *   would overflow at it.
+ *
+ ******************************************************************************/
+uint32_t app_period_max_ms(void) {
+	uint32_t max_ms = letimer_period_max_ms();
+
+	return max_ms < APP_PERIOD_MAX_MS ? max_ms : APP_PERIOD_MAX_MS;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Opens the report-on-change filter
+ *
+ * @details
+ *   The deadbands are in the same fixed point units as the rate controller
+ *   thresholds, well below them so a reading is reported before the rate speeds up.
+ *
+ ******************************************************************************/
+void app_report_open(void) {
+	report_filter_init(&report_filter, REPORT_MAX_SILENCE_MS);
+	report_filter_channel_set(&report_filter, SENSOR_HUMIDITY, REPORT_HUMIDITY_BAND, 0);
+	report_filter_channel_set(&report_filter, SENSOR_TEMPERATURE, REPORT_TEMPERATURE_BAND, 0);
+	report_filter_channel_set(&report_filter, SENSOR_LIGHT, REPORT_LIGHT_BAND, REPORT_LIGHT_BAND_PCT);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Opens the filter of the humidity that drives LED1
+ *
+ * @param[in] type
+ *   FilterXxx, the EMA and boxcar use the LED_FILTER_xxx parameters
+ *
+ ******************************************************************************/
+void app_led_filter_open(FILTER_TYPE type) {
+	uint32_t param = 0;
+
+	if(type == FilterEma) {
+		param = LED_FILTER_EMA_ALPHA;
+	} else if(type == FilterBoxcar) {
+		param = LED_FILTER_BOXCAR_TAPS;
+	}
+	filter_init(&led_filter, type, param);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Reports the cycles per sample of every filter over BLE
+ *
+ * @details
+ *   Measured with the DWT cycle counter on a FILTER_BENCH_SAMPLES batch, so the
+ *   numbers show what the DSP instructions save against a build without them.
+ *
+ ******************************************************************************/
+void app_filter_benchmark(void) {
+	static const char * const filter_name[FilterTypes] = { "none", "ema", "boxcar", "median3", "median5" };
+	uint32_t param;
+	uint32_t cycles;
+	char line[64];
+
+	for(uint32_t type = 0; type < FilterTypes; type++) {
+		param = type == FilterEma ? LED_FILTER_EMA_ALPHA : LED_FILTER_BOXCAR_TAPS;
+		cycles = filter_benchmark((FILTER_TYPE) type, param);
+		sprintf(line, "filter %s: %lu.%02lu cycles/sample\n", filter_name[type],
+				(unsigned long) (cycles / 100), (unsigned long) (cycles % 100));
+		ble_write(line);
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Hands a finished sensor read to the sensor engine
+ *
+ * @details
+ *   With HW_TRIGGER_ENABLED there is no underflow callback, so the first read of the
+ *   sample to complete opens it and the stamp is taken then rather than at the underflow.
+ *
+ * @param[in] done_cb
+ *   done event of the read
+ *
+ ******************************************************************************/
+void app_read_done(uint32_t done_cb) {
+#ifdef HW_TRIGGER_ENABLED
+	sensor_sample_open(APP_SENSOR_ALL);
+#endif
+	sensor_read_done(done_cb);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Hands the start of every sample to the hardware
+ *
+ * @details
+ *   The LETIMER0 underflow is routed through the PRS to PRS DMA requests 0 and 1,
+ *   and an LDMA channel per bus writes the START command and the address byte of the
+ *   armed read.  Both sensors are armed here and re-armed once each sample has been
+ *   reported, so the CPU first wakes on the I2C ACK of the address byte.
+ *
+ * @note
+ *   An armed bus blocks I2C_EM_BLOCK because the I2C runs from the HF clock, so the
+ *   board waits out the period in EM1 instead of EM2.  Both buses are triggered on
+ *   every underflow, so the SENS command is ignored in this mode.
+ *
+ ******************************************************************************/
+void app_hw_trigger_open(void) {
+	letimer_prs_open(LETIMER0, LETIMER_PRS_CH);
+	ldma_prs_request_open(0, LETIMER_PRS_CH);
+	ldma_prs_request_open(1, LETIMER_PRS_CH);
+
+	si7021_arm(SI7021_READ_CB);
+	veml_arm(VEML_CB);
+
+	i2c_hw_trigger_open(SI7021_I2C, LDMA_I2C1_TRIG_CH, ldmaPeripheralSignal_PRS_REQ0, SI7021_SLAVE_ADDRESS);
+	i2c_hw_trigger_open(VEML_I2C, LDMA_I2C0_TRIG_CH, ldmaPeripheralSignal_PRS_REQ1, VEML_ADDR);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Opens the multi-rate sample schedule
+ *
+ * @details
+ *   The SI7021 and the VEML7700 each get their own period and phase on the RTCC, so
+ *   the slowly changing humidity and temperature are no longer read at the rate the
+ *   light needs.  With the VEML interrupt active the light is read on its heartbeat.
+ *
+ ******************************************************************************/
+void app_sched_open(void) {
+	sample_sched_open(SCHED_DUE_CB);
+	sample_sched_set(APP_SENSOR_SI7021, app_config.si7021_period_ms, SCHED_SI7021_PHASE_MS);
+#ifdef VEML_INT_ENABLED
+	app_config.veml_period_ms = VEML_HEARTBEAT_MS;
+#endif
+	sample_sched_set(APP_SENSOR_VEML, app_config.veml_period_ms, SCHED_VEML_PHASE_MS);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Starts a sample of the groups that are due
+ *
+ * @details
+ *   Groups that come due while the previous sample is still open are deferred and
+ *   started together once that sample has been reported.
+ *
+ * @param[in] groups
+ *   APP_SENSOR_xxx bits of the groups to sample
+ *
+ ******************************************************************************/
+void app_sched_start(uint32_t groups) {
+	if(groups && (burst_active || !sensor_sample_start(groups))) {
+		sched_deferred |= groups;
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Answers the #READ commands whose readings are fresh
+ *
+ * @details
+ *   Every reply carries the age of the reading.  Readings that are still stale are
+ *   left requested for the next ready event.  With HW_TRIGGER_ENABLED the engine
+ *   cannot start a read, so the last cached reading is sent whatever its age.
+ *
+ ******************************************************************************/
+void app_read_reply(void) {
+	const SENSOR_CACHE *entry;
+	char line[80];
+	float value;
+	uint32_t len;
+
+	for(uint32_t i = 0; i < SENSOR_NUM; i++) {
+		if(!(read_requested & (1 << i))) {
+			continue;
+		}
+#ifdef HW_TRIGGER_ENABLED
+		if(!sensor_cache(i)->valid) {
+			continue;
+		}
+		value = sensor_cache(i)->value;
+#else
+		if(!sensor_cached(i, app_config.fresh_ms, &value)) {
+			continue;
+		}
+#endif
+		entry = sensor_cache(i);
+		read_requested &= ~(1 << i);
+
+		len = sprintf(line, sensor_get(i)->format, value);
+		sprintf(&line[len - 1], ", age %lu ms\n",
+				(unsigned long) TIMEBASE_TICKS_TO_MS(timebase_ticks() - entry->ticks));
+		app_telemetry_append(line);
+	}
+	app_telemetry_flush();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Appends a reported sample to the flash journal
+ *
+ * @details
+ *   The readings are stored in the fixed point units of JOURNAL_RECORD, so the samples
+ *   survive the phone being out of range.  The journal is flushed at least every
+ *   APP_JOURNAL_FLUSH_MS, and after every record once the energy governor has seen
+ *   the supply fall below APP_JOURNAL_LOW_MV, so a reset or the brown-out at the end
+ *   of the battery loses little.  A flush only programs the words after the last one,
+ *   so it costs no extra erase.
+ *
+ * @param[in] sample
+ *   sample being reported
+ *
+ ******************************************************************************/
+void app_journal_append(const SENSOR_SAMPLE *sample) {
+	JOURNAL_RECORD record;
+
+	record.time_ms = TIMEBASE_TICKS_TO_MS(sample->start_ticks);
+	record.present = 0;
+	record.humidity = 0;
+	record.temperature = 0;
+	record.light = 0;
+
+	if(sample->launched & (1 << SENSOR_HUMIDITY)) {
+		record.present |= JOURNAL_HUMIDITY;
+		record.humidity = (int16_t) (sample->value[SENSOR_HUMIDITY] * 10);
+	}
+	if(sample->launched & (1 << SENSOR_TEMPERATURE)) {
+		record.present |= JOURNAL_TEMPERATURE;
+		record.temperature = (int16_t) (sample->value[SENSOR_TEMPERATURE] * 10);
+	}
+	if(sample->launched & (1 << SENSOR_LIGHT)) {
+		record.present |= JOURNAL_LIGHT;
+		record.light = (uint32_t) sample->value[SENSOR_LIGHT];
+	}
+
+	journal_append(&record);
+
+	if(journal_low_supply || (timebase_ms() - journal_flush_ms >= APP_JOURNAL_FLUSH_MS)) {
+		journal_flush();
+		journal_flush_ms = timebase_ms();
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Opens the store-and-forward link watch
+ *
+ * @details
+ *   Samples from earlier boots are not sent again, the backlog starts at the first
+ *   record of this boot.  #RESUME can ask for older records.
+ *
+ ******************************************************************************/
+void app_link_open(void) {
+	ble_link_open(BLE_LINK_CB);
+	link_up = ble_connected();
+	link_live = link_up;
+	drain_next = journal_next();
+	drain_end = JOURNAL_NONE;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Sends the next frame of the journal backlog
+ *
+ * @details
+ *   Packs as many records as fit in APP_DRAIN_FRAME_SIZE from the progress marker and
+ *   sends them as one frame at full link speed.  Once the marker reaches the end
+ *   of the journal the link goes live again.
+ *
+ * @note
+ *   Records that the journal ring already overwrote are skipped.
+ *
+ ******************************************************************************/
+void app_drain_next(void) {
+	LEUART_TX_SEGMENT frame;
+	uint32_t len;
+	uint32_t number;
+
+	if(!link_up || drain_end != JOURNAL_NONE) {
+		return;
+	}
+
+	if(drain_next < journal_first()) {
+		drain_next = journal_first();
+	}
+	if(drain_next >= journal_next()) {
+		drain_next = journal_next();
+		link_live = true;
+		return;
+	}
+
+	len = app_journal_frame(drain_frame, drain_next, journal_next(), &number);
+	drain_end = number;
+	frame.data = drain_frame;
+	frame.length = len;
+	if(len) {
+		bool sent = ble_write_segments(&frame, 1, BLE_DRAIN_CB);
+		EFM_ASSERT(sent);
+	} else {
+		add_scheduled_event(BLE_DRAIN_CB);
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Formats journal records into a BLE frame
+ *
+ * @details
+ *   One "number,boot,ms,rh x10,F x10,lux" line per record with absent readings left
+ *   empty, as many as fit in APP_DRAIN_FRAME_SIZE.  Records that fail their check
+ *   are skipped.
+ *
+ * @param[out] frame
+ *   APP_DRAIN_FRAME_SIZE buffer
+ *
+ * @param[in] first
+ *   number of the first record
+ *
+ * @param[in] end
+ *   one past the number of the last record
+ *
+ * @param[out] next
+ *   number of the first record that did not fit
+ *
+ * @return
+ *   frame length in bytes
+ *
+ ******************************************************************************/
+uint32_t app_journal_frame(char *frame, uint32_t first, uint32_t end, uint32_t *next) {
+	JOURNAL_RECORD record;
+	char line[80];
+	uint32_t len = 0;
+	uint32_t line_len;
+	uint32_t number;
+
+	for(number = first; number < end; number++) {
+		if(!journal_read(number, &record)) {
+			continue;
+		}
+		line_len = app_journal_line(line, number, &record);
+
+		if(len + line_len > APP_DRAIN_FRAME_SIZE) {
+			break;
+		}
+		memcpy(&frame[len], line, line_len);
+		len += line_len;
+	}
+
+	*next = number;
+	return len;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Formats one journal record as a "number,boot,ms,rh x10,F x10,lux" line
+ *
+ * @details
+ *   Absent readings are left empty.
+ *
+ * @param[out] line
+ *   at least 80 bytes, not NUL terminated
+ *
+ * @return
+ *   line length in bytes, the newline included
+ *
+ ******************************************************************************/
+uint32_t app_journal_line(char *line, uint32_t number, const JOURNAL_RECORD *record) {
+	uint32_t line_len;
+
+	line_len = sprintf(line, "%lu,%u,%lu,", (unsigned long) number, record->boot, (unsigned long) record->time_ms);
+	if(record->present & JOURNAL_HUMIDITY) {
+		line_len += sprintf(&line[line_len], "%d", record->humidity);
+	}
+	line[line_len++] = ',';
+	if(record->present & JOURNAL_TEMPERATURE) {
+		line_len += sprintf(&line[line_len], "%d", record->temperature);
+	}
+	line[line_len++] = ',';
+	if(record->present & JOURNAL_LIGHT) {
+		line_len += sprintf(&line[line_len], "%lu", (unsigned long) record->light);
+	}
+	line[line_len++] = '\n';
+	return line_len;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Delta packs journal records into a BLE frame
+ *
+ * @details
+ *   A "PACK number,boot,records,bytes" text line is followed by the records packed
+ *   with codec_encode(), humidity, temperature and light as channels 0 to 2 with the
+ *   JOURNAL_xxx bits as the channel mask.  Every frame is a stream of its own and
+ *   stops at a change of boot, so it decodes from its header alone.  The text size
+ *   of the same records is added up for the packing ratio.
+ *
+ * @param[out] frame
+ *   APP_DRAIN_FRAME_SIZE buffer
+ *
+ * @param[in] first
+ *   number of the first record
+ *
+ * @param[in] end
+ *   one past the number of the last record
+ *
+ * @param[out] next
+ *   number of the first record that did not fit
+ *
+ * @return
+ *   frame length in bytes
+ *
+ ******************************************************************************/
+uint32_t app_packed_frame(char *frame, uint32_t first, uint32_t end, uint32_t *next) {
+	static uint8_t packed[APP_DRAIN_FRAME_SIZE - 48];
+	CODEC_STATE codec;
+	JOURNAL_RECORD record;
+	int32_t value[3];
+	char line[80];
+	uint32_t len = 0;
+	uint32_t number;
+	int32_t boot = -1;
+
+	codec_reset(&codec, 3);
+	for(number = first; number < end; number++) {
+		if(!journal_read(number, &record)) {
+			continue;
+		}
+		if((boot >= 0 && record.boot != boot) || len + CODEC_MAX_SAMPLE_BYTES > sizeof(packed)) {
+			break;
+		}
+		if(boot < 0) {
+			boot = record.boot;
+			first = number;
+		}
+
+		value[0] = record.humidity;
+		value[1] = record.temperature;
+		value[2] = (int32_t) record.light;
+		len += codec_encode(&codec, record.time_ms, record.present, value, &packed[len]);
+		query_text_bytes += app_journal_line(line, number, &record);
+	}
+
+	*next = number;
+	if(!codec.samples) {
+		return 0;
+	}
+	number = sprintf(frame, "PACK %lu,%ld,%lu,%lu\n", (unsigned long) first, (long) boot,
+			(unsigned long) codec.samples, (unsigned long) len);
+	memcpy(&frame[number], packed, len);
+
+	query_packed_records += codec.samples;
+	query_packed_bytes += number + len;
+	return number + len;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Sends the next frame of a #LAST, #HIST or #PACK answer
+ *
+ * @details
+ *   Only one frame is in flight, the rest follows from QUERY_TX_CB.  A new query
+ *   replaces the range of one still being sent.  A #PACK answer ends with its packing
+ *   ratio against the text frames of #LAST.
+ *
+ ******************************************************************************/
+void app_query_next(void) {
+	LEUART_TX_SEGMENT frame;
+	char line[80];
+
+	if(query_busy || query_next >= query_end) {
+		return;
+	}
+
+	frame.data = query_frame;
+	if(query_packed) {
+		frame.length = app_packed_frame(query_frame, query_next, query_end, &query_next);
+	} else {
+		frame.length = app_journal_frame(query_frame, query_next, query_end, &query_next);
+	}
+	if(frame.length) {
+		query_busy = true;
+		bool sent = ble_write_segments(&frame, 1, QUERY_TX_CB);
+		EFM_ASSERT(sent);
+	}
+
+	if(query_packed && query_next >= query_end && query_packed_bytes) {
+		sprintf(line, "packed %lu records: text %lu B, packed %lu B, ratio %lu.%02lu\n",
+				(unsigned long) query_packed_records, (unsigned long) query_text_bytes,
+				(unsigned long) query_packed_bytes, (unsigned long) (query_text_bytes / query_packed_bytes),
+				(unsigned long) ((query_text_bytes % query_packed_bytes) * 100 / query_packed_bytes));
+		app_telemetry_append(line);
+		app_telemetry_flush();
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Answers #AGG with min, max and mean of every reading over the last seconds
+ *
+ * @details
+ *   The range is found through the journal time index, only the records inside it
+ *   are read.  Values are in the fixed point units of JOURNAL_RECORD.
+ *
+ * @param[in] seconds
+ *   length of the range, ending now
+ *
+ ******************************************************************************/
+void app_query_aggregate(uint32_t seconds) {
+	static const char * const field_name[] = { "rh x10", "F x10", "lux" };
+	QUERY_AGG agg;
+	uint32_t first;
+	uint32_t end;
+	char line[80];
+
+	query_range(app_query_since(seconds), UINT64_MAX, &first, &end);
+
+	for(uint32_t field = QueryHumidity; field <= QueryLight; field++) {
+		query_aggregate(first, end, (QUERY_FIELD) field, &agg);
+		if(agg.count) {
+			sprintf(line, "%s: min %ld max %ld mean %ld n %lu\n", field_name[field], (long) agg.min,
+					(long) agg.max, (long) query_mean(&agg), (unsigned long) agg.count);
+		} else {
+			sprintf(line, "%s: no samples\n", field_name[field]);
+		}
+		app_telemetry_append(line);
+	}
+	app_telemetry_flush();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the journal time key of a number of seconds ago
+ *
+ * @details
+ *   Sample times restart with every boot, so the range never reaches back past the
+ *   start of this boot.
+ *
+ ******************************************************************************/
+uint64_t app_query_since(uint32_t seconds) {
+	uint64_t now_ms = timebase_ms();
+	uint64_t back_ms = (uint64_t) seconds * 1000;
+
+	return QUERY_KEY(journal_boot_count(), now_ms > back_ms ? now_ms - back_ms : 0);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Appends the summary of one rollup bucket to the telemetry frame
+ *
+ * @details
+ *   One line with the tier letter, the bucket number since boot and min, max and
+ *   mean of every reading, in the rate controller's fixed point units.
+ *
+ * @param[in] tier
+ *   rollup tier
+ *
+ * @param[in] age
+ *   0 for the open bucket, 1 for the last closed one
+ *
+ ******************************************************************************/
+void app_rollup_report(ROLLUP_TIER_ID tier, uint32_t age) {
+	static const char tier_name[RollupTiers] = { 'm', 'h', 'd' };
+	const ROLLUP_BUCKET *bucket = rollup_get(tier, age);
+	const ROLLUP_STAT *stat;
+	char line[160];
+	uint32_t len;
+
+	if(!bucket) {
+		return;
+	}
+
+	len = sprintf(line, "%c %lu:", tier_name[tier], (unsigned long) bucket->index);
+	for(uint32_t i = 0; i < SENSOR_NUM; i++) {
+		stat = &bucket->ch[i];
+		if(stat->count) {
+			len += sprintf(&line[len], " %s %ld/%ld/%ld", sensor_get(i)->name, (long) stat->min,
+					(long) stat->max, (long) rollup_mean(stat));
+		}
+	}
+	sprintf(&line[len], "\n");
+	app_telemetry_append(line);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Starts a light burst
+ *
+ * @details
+ *   The VEML goes to its 25 ms integration time and is read once per integration
+ *   through the timebase alarm, which the sensor engine only uses while a sample is
+ *   open.  A burst asked for during a sample starts once the sample is reported.
+ *   Samples that come due during the burst are deferred to its end.
+ *
+ ******************************************************************************/
+void app_burst_start(void) {
+	if(burst_active) {
+		return;
+	}
+	if(sensor_sample()->open) {
+		burst_pending = true;
+		return;
+	}
+
+	burst_pending = false;
+	burst_active = true;
+	burst_count = 0;
+	while(check_busy(VEML_I2C));
+	burst_period_ms = veml_burst_begin();
+	burst_start_ticks = timebase_ticks();
+
+	// The first integration straddles the change of setting, its reading is skipped
+	timebase_alarm_at(TIMEBASE_ALARM_CC, burst_start_ticks + TIMEBASE_MS_TO_TICKS(burst_period_ms),
+			BURST_TICK_CB);
+	burst_start_ticks += TIMEBASE_MS_TO_TICKS(burst_period_ms);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Reports the flicker summary of a finished burst
+ *
+ * @details
+ *   Only the summary goes over BLE, the readings stay in RAM.  The sample rate is one
+ *   reading per 25 ms integration, so the dominant frequency is below 20 Hz: slow
+ *   modulation such as a dimmer beating or a failing ballast.  Mains flicker at
+ *   100 Hz is mostly averaged out by the integration and what is left folds down
+ *   to 20 Hz, and 120 Hz is a whole number of integrations and cancels out.
+ *
+ ******************************************************************************/
+void app_burst_done(void) {
+	FLICKER_RESULT result;
+	char line[96];
+
+	flicker_analyze(burst_counts, burst_size, burst_period_ms, &result);
+
+	sprintf(line, "burst %lu x %lu ms: mean %.1f lux, counts %lu..%lu\n", (unsigned long) result.samples,
+			(unsigned long) result.period_ms, result.mean * veml_lux_per_count(),
+			(unsigned long) result.min, (unsigned long) result.max);
+	app_telemetry_append(line);
+	sprintf(line, "flicker index %lu.%03lu, percent flicker %lu.%lu%%\n",
+			(unsigned long) (result.flicker_index / 1000), (unsigned long) (result.flicker_index % 1000),
+			(unsigned long) (result.percent_flicker / 10), (unsigned long) (result.percent_flicker % 10));
+	app_telemetry_append(line);
+	sprintf(line, "dominant %lu.%03lu Hz in %lu.%03lu Hz bins, %lu%% of the AC power\n",
+			(unsigned long) (result.peak_mhz / 1000), (unsigned long) (result.peak_mhz % 1000),
+			(unsigned long) (result.bin_mhz / 1000), (unsigned long) (result.bin_mhz % 1000),
+			(unsigned long) result.peak_share_pct);
+	app_telemetry_append(line);
+	app_telemetry_flush();
+
+	veml_burst_end();
+	burst_active = false;
+
+	for(uint32_t i = 0; i < SENSOR_NUM; i++) {
+		if(read_requested & (1 << i)) {
+			sensor_request(i, app_config.fresh_ms, SENSOR_READY_CB);
+		}
+	}
+	if(sched_deferred) {
+		uint32_t groups = sched_deferred;
+		sched_deferred = 0;
+		app_sched_start(groups);
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Appends the comfort metrics of a sample to the telemetry frame
+ *
+ * @details
+ *   Computed from the same fixed point humidity and temperature the rate controller
+ *   sees, so only when the sample holds both.
+ *
+ * @param[in] sample
+ *   sample with both SENSOR_HUMIDITY and SENSOR_TEMPERATURE launched
+ *
+ ******************************************************************************/
+void app_comfort_report(const SENSOR_SAMPLE *sample) {
+	COMFORT comfort;
+	char line[80];
+
+	comfort_compute((int32_t) (sample->value[SENSOR_HUMIDITY] * rate_scale[SENSOR_HUMIDITY]),
+			(int32_t) (sample->value[SENSOR_TEMPERATURE] * rate_scale[SENSOR_TEMPERATURE]), &comfort);
+	sprintf(line, "dew point %.1f F, heat index %.1f F, %.2f g/m3\n", comfort.dew_point / 10.0f,
+			comfort.heat_index / 10.0f, comfort.abs_humidity / 100.0f);
+	app_telemetry_append(line);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Reports the cycles per call of every comfort metric over BLE
+ *
+ ******************************************************************************/
+void app_comfort_benchmark(void) {
+	static const char * const metric_name[ComfortMetrics] = { "dew point", "heat index", "abs humidity" };
+	char line[64];
+
+	for(uint32_t metric = 0; metric < ComfortMetrics; metric++) {
+		sprintf(line, "comfort %s: %lu cycles\n", metric_name[metric],
+				(unsigned long) comfort_benchmark((COMFORT_METRIC) metric));
+		ble_write(line);
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Starts the energy governor on a new battery
+ *
+ * @details
+ *   The governor starts at level 0 and its first window ends ENERGY_WINDOW_MS from
+ *   now.  Nothing survives a reset, so a reset is taken as a new battery.
+ *
+ * @param[in] capacity_mwh
+ *   usable energy of the battery
+ *
+ * @param[in] lifetime_days
+ *   how long it has to last from now, 0 for no target
+ *
+ ******************************************************************************/
+void app_energy_open(uint32_t capacity_mwh, uint32_t lifetime_days) {
+	ENERGY_METER meter;
+
+	app_energy_meter(&meter);
+	energy_gov_init(&energy_gov, &energy_model, ENERGY_LEVELS, &meter);
+	energy_gov_target(&energy_gov, capacity_mwh, lifetime_days, ENERGY_CUTOFF_MV);
+	energy_next_ms = meter.time_ms + ENERGY_WINDOW_MS;
+	journal_low_supply = meter.supply_mv && (meter.supply_mv < APP_JOURNAL_LOW_MV);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Reads every total the energy governor charges for
+ *
+ * @param[out] meter
+ *   the totals since reset and the supply voltage now
+ *
+ ******************************************************************************/
+void app_energy_meter(ENERGY_METER *meter) {
+	meter->time_ms = timebase_ms();
+	for(uint32_t i = 0; i < ENERGY_EMS; i++) {
+		meter->em_ms[i] = sleep_residency_ms(i);
+	}
+	ble_traffic(&meter->tx_bytes, &meter->tx_writes, &meter->rx_bytes);
+	meter->sensor_nc = energy_sensor_nc;
+	meter->supply_mv = supply_mv();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Closes a governor window and moves to the level it picks
+ *
+ * @details
+ *   Runs from the sample that ends the window, so metering never wakes the board on
+ *   its own.
+ *
+ ******************************************************************************/
+void app_energy_update(void) {
+	ENERGY_METER meter;
+
+	app_energy_meter(&meter);
+	energy_next_ms = meter.time_ms + ENERGY_WINDOW_MS;
+	journal_low_supply = meter.supply_mv && (meter.supply_mv < APP_JOURNAL_LOW_MV);
+	if(energy_gov_update(&energy_gov, &meter)) {
+		app_energy_apply();
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Sets the period, batch and resolution of the governor's level
+ *
+ * @details
+ *   The batch size is read from the level when each sample is added to the frame.
+ *   si7021_set_resolution() waits out a conversion the pipeline started before it
+ *   writes the register.
+ *
+ ******************************************************************************/
+void app_energy_apply(void) {
+	const ENERGY_LEVEL *level = &energy_level[energy_gov.level];
+
+	app_rate_open();
+	app_rate_apply();
+
+	si7021_set_resolution((SI7021_RESOLUTION) level->resolution);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Reports the energy governor's state over BLE
+ *
+ * @details
+ *   The level, the power of the last window against the budget, the energy used
+ *   against the battery, the days that leaves at that power and the supply voltage.
+ *
+ ******************************************************************************/
+void app_energy_report(void) {
+	char line[160];
+	uint32_t len;
+
+	len = sprintf(line, "energy level %lu, %lu uW", (unsigned long) energy_gov.level,
+			(unsigned long) energy_gov.power_uw);
+	if(energy_gov.budget_uw != UINT32_MAX) {
+		len += sprintf(&line[len], " of %lu uW", (unsigned long) energy_gov.budget_uw);
+	}
+	len += sprintf(&line[len], ", %lu of %lu mWh used", (unsigned long) (energy_gov.used_nj / ENERGY_NJ_PER_MWH),
+			(unsigned long) (energy_gov.capacity_nj / ENERGY_NJ_PER_MWH));
+	if(energy_gov.power_uw) {
+		len += sprintf(&line[len], ", %lu days left", (unsigned long) energy_gov_days_left(&energy_gov));
+	}
+	sprintf(&line[len], ", %lu mV\n", (unsigned long) energy_gov.last.supply_mv);
+	app_telemetry_append(line);
+	app_telemetry_flush();
+}
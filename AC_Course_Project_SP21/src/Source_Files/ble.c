@@ -22,6 +22,10 @@
 //***********************************************************************************
 // private variables
 //***********************************************************************************
+static CMD_PARSER	ble_cmd_parser;
+static uint32_t		ble_tx_bytes;		// handed to the module for the air since reset
+static uint32_t		ble_tx_writes;
+static uint32_t		ble_rx_bytes;
 
 /***************************************************************************//**
  * @brief BLE module
@@ -46,7 +50,9 @@
  * @details
  *      sets the values of the LEUART_OPEN_STRUCT using defines from ble.h, including
  *      baudrate, databits, enable, parity, stopbits, as well as the tx and rx routes
- *      and enables for LEUART0
+ *      and enables for LEUART0.  The receiver is blocked until the command start frame
+ *      and the command end character is the signal frame, so the CPU only wakes once
+ *      a complete command sits in the LEUART RX circular buffer.
  *
  * @note
  *     this code is to specify to the system to use LEUART0
@@ -79,6 +85,18 @@ void ble_open(uint32_t tx_event, uint32_t rx_event){
 	leuart_opn.tx_done_evt = tx_event;
 	leuart_opn.rx_done_evt = rx_event;
 
+	leuart_opn.rxblocken = HM10_RX_BLOCK;
+	leuart_opn.sfubrx = HM10_RX_BLOCK;
+	leuart_opn.startframe_en = HM10_RX_BLOCK;
+	leuart_opn.startframe = HM10_STARTFRAME;
+	leuart_opn.sigframe_en = true;
+	leuart_opn.sigframe = HM10_SIGFRAME;
+
+	leuart_opn.tx_ldma_en = HM10_TX_LDMA;
+	leuart_opn.rx_ldma_en = HM10_RX_LDMA;
+
+	cmd_parser_init(&ble_cmd_parser);
+
 	leuart_open(LEUART0, &leuart_opn);
 }
 
@@ -101,10 +119,139 @@ void ble_open(uint32_t tx_event, uint32_t rx_event){
  *
  ******************************************************************************/
 void ble_write(char* string){
-	leuart_start(LEUART0, string, strlen(string));
+	uint32_t len = strlen(string);
+
+	ble_tx_bytes += len;
+	ble_tx_writes++;
+	leuart_start(LEUART0, string, len);
 	while(leuart_tx_busy(LEUART0));
 }
 
+/***************************************************************************//**
+ * @brief
+ *   starts a non-blocking, zero-copy write of a scatter list to the BLE module
+ *
+ * @details
+ *      hands the segments straight to leuart_start_segments() so batched frames can
+ *      be sent as header + payload without first being assembled into one buffer
+ *
+ * @note
+ *     the segment buffers belong to the LEUART driver until release_evt is raised,
+ *     the caller must keep them valid and unmodified until then
+ *
+ * @param[in] segments
+ *   scatter list of buffers to send
+ *
+ * @param[in] num_segments
+ *   number of entries in segments
+ *
+ * @param[in] release_evt
+ *   scheduler event raised once the buffers have been transmitted and released
+ *
+ * @return
+ *   false if the LEUART refused the list as longer than its LDMA descriptors hold,
+ *   see LEUART_TX_MAX_DESCRIPTORS, nothing is sent and release_evt is not raised
+ *
+ ******************************************************************************/
+bool ble_write_segments(const LEUART_TX_SEGMENT *segments, uint32_t num_segments, uint32_t release_evt){
+	while(leuart_tx_busy(HM10_LEUART0));
+	if(!leuart_start_segments(HM10_LEUART0, segments, num_segments, release_evt)) {
+		return false;
+	}
+
+	for(uint32_t i = 0; i < num_segments; i++) {
+		ble_tx_bytes += segments[i].length;
+	}
+	ble_tx_writes++;
+	return true;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   decodes the next command received from the phone
+ *
+ * @details
+ *      drains the LEUART RX circular buffer one byte at a time into the streaming
+ *      command parser and stops at the first complete command, leaving any bytes
+ *      that follow it in the circular buffer for the next call
+ *
+ * @note
+ *     call repeatedly from the rx done event until it returns false
+ *
+ * @param[out] cmd
+ *   the decoded command
+ *
+ * @return
+ *   true if a command was decoded
+ *
+ ******************************************************************************/
+bool ble_read_command(BLE_COMMAND *cmd){
+	char rx_char;
+
+	while(leuart_rx_read(HM10_LEUART0, &rx_char, 1)) {
+		ble_rx_bytes++;
+		if(cmd_parser_feed(&ble_cmd_parser, rx_char, cmd)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   watches the connection state of the BLE module
+ *
+ * @details
+ *      the module drives its STATE pin high while a central is connected, and both
+ *      edges of the pin raise link_event so the application can stop sending into a
+ *      module that drops everything while it is only advertising
+ *
+ * @note
+ *     the STATE output must be configured with AT+PIO11, otherwise it blinks while
+ *     advertising
+ *
+ * @param[in] link_event
+ *   scheduler event raised when the connection state may have changed
+ *
+ ******************************************************************************/
+void ble_link_open(uint32_t link_event){
+	gpio_irq_open(BLE_STATE_PORT, BLE_STATE_PIN, true, true, link_event);
+}
+
+/***************************************************************************//**
+ * @brief
+ *   returns true while a central is connected to the BLE module
+ *
+ ******************************************************************************/
+bool ble_connected(void){
+	return GPIO_PinInGet(BLE_STATE_PORT, BLE_STATE_PIN);
+}
+
+/***************************************************************************//**
+ * @brief
+ *   reports the traffic through the BLE module since reset
+ *
+ * @details
+ *      every byte written or received costs the module radio time, and every write
+ *      costs it at least one connection event however short it is, so the energy
+ *      governor charges both
+ *
+ * @param[out] tx_bytes
+ *   bytes handed to the module to send
+ *
+ * @param[out] tx_writes
+ *   ble_write() and ble_write_segments() calls
+ *
+ * @param[out] rx_bytes
+ *   bytes received from the module
+ *
+ ******************************************************************************/
+void ble_traffic(uint32_t *tx_bytes, uint32_t *tx_writes, uint32_t *rx_bytes){
+	*tx_bytes = ble_tx_bytes;
+	*tx_writes = ble_tx_writes;
+	*rx_bytes = ble_rx_bytes;
+}
+
 /***************************************************************************//**
  * @brief
  *   BLE Test performs two functions.  First, it is a Test Driven Development
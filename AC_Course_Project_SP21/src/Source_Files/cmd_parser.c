@@ -0,0 +1,199 @@
+/**
+ * @file
+ * 	cmd_parser.c
+ * @author
+ * 	Adam Chehadi
+ * @date
+ * 	05/05/2021
+ * @brief
+ *	Contains the incremental parser for commands received from the BLE module
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <string.h>
+
+#include "cmd_parser.h"
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+typedef enum {
+	WaitStart,
+	ReadKey,
+	ReadValue,
+	Discard
+} PARSER_STATES;
+
+typedef struct {
+	const char				*key;
+	CMD_ID					id;
+} CMD_KEY_ENTRY;
+
+static const CMD_KEY_ENTRY	cmd_keys[] = {
+	{ "PER",	CmdSamplePeriod },
+	{ "BATCH",	CmdBatchSize },
+	{ "SENS",	CmdSensorEnable },
+	{ "RES",	CmdResolution },
+	{ "HEAT",	CmdHeater },
+	{ "HPER",	CmdSi7021Period },
+	{ "LPER",	CmdVemlPeriod },
+	{ "READ",	CmdRead },
+	{ "FRESH",	CmdFreshness },
+	{ "RESUME",	CmdResume },
+	{ "LAST",	CmdLast },
+	{ "HIST",	CmdHistory },
+	{ "AGG",	CmdAggregate },
+	{ "ROLL",	CmdRollup },
+	{ "PACK",	CmdPacked },
+	{ "RHBAND",	CmdHumidityBand },
+	{ "FBAND",	CmdTemperatureBand },
+	{ "LUXBAND",	CmdLightBand },
+	{ "SILENCE",	CmdSilence },
+	{ "FILT",	CmdFilter },
+	{ "BURST",	CmdBurst },
+	{ "LIFE",	CmdLifetime },
+	{ "BATT",	CmdBattery },
+	{ "ENERGY",	CmdEnergy }
+};
+
+
+//***********************************************************************************
+// Private function prototypes
+//***********************************************************************************
+static CMD_ID cmd_lookup(const char *key, uint32_t key_len);
+
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Resets a command parser
+ *
+ * @details
+ * 	 The parser waits for CMD_START_CHAR before it accepts a key.
+ *
+ * @param[in] parser
+ *   parser state to reset
+ *
+ ******************************************************************************/
+void cmd_parser_init(CMD_PARSER *parser) {
+	parser->state = WaitStart;
+	parser->key_len = 0;
+	parser->value = 0;
+	parser->has_value = false;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Feeds one received character into the command parser
+ *
+ * @details
+ * 	 The parser is a small state machine so commands can be parsed as bytes are
+ * 	 drained from the LEUART circular buffer, without first collecting a whole line.
+ * 	 A malformed frame is discarded up to the next CMD_END_CHAR.  Carriage returns
+ * 	 are ignored so "\r\n" terminated frames parse the same as "\n".
+ *
+ * @note
+ *   Returns true only on the character that completes a valid frame.
+ *
+ * @param[in] parser
+ *   parser state
+ *
+ * @param[in] c
+ *   next received character
+ *
+ * @param[out] cmd
+ *   filled in with the decoded command when true is returned
+ *
+ * @return
+ *   true if a complete, recognized command was decoded
+ *
+ ******************************************************************************/
+bool cmd_parser_feed(CMD_PARSER *parser, char c, BLE_COMMAND *cmd) {
+	if(c == '\r') {
+		return false;
+	}
+
+	switch(parser->state) {
+		case WaitStart:
+			if(c == CMD_START_CHAR) {
+				cmd_parser_init(parser);
+				parser->state = ReadKey;
+			}
+			break;
+		case ReadKey:
+			if(c == CMD_END_CHAR) {
+				break;
+			} else if(c == CMD_VALUE_CHAR) {
+				parser->state = ReadValue;
+			} else if((c >= 'A') && (c <= 'Z') && (parser->key_len < CMD_KEY_MAX)) {
+				parser->key[parser->key_len++] = c;
+			} else if((c >= 'a') && (c <= 'z') && (parser->key_len < CMD_KEY_MAX)) {
+				parser->key[parser->key_len++] = c - 'a' + 'A';
+			} else {
+				parser->state = Discard;
+			}
+			break;
+		case ReadValue:
+			if((c >= '0') && (c <= '9')) {
+				parser->value = parser->value * 10 + (c - '0');
+				if(parser->value > CMD_VALUE_MAX) {
+					parser->value = CMD_VALUE_MAX;
+				}
+				parser->has_value = true;
+			} else if(c != CMD_END_CHAR) {
+				parser->state = Discard;
+			}
+			break;
+		case Discard:
+			if(c == CMD_END_CHAR) {
+				parser->state = WaitStart;
+			}
+			return false;
+		default:
+			EFM_ASSERT(false);
+	}
+
+	if((c == CMD_END_CHAR) && ((parser->state == ReadKey) || (parser->state == ReadValue))) {
+		parser->state = WaitStart;
+		cmd->id = cmd_lookup(parser->key, parser->key_len);
+		cmd->value = parser->value;
+		cmd->has_value = parser->has_value;
+		return cmd->id != CmdInvalid;
+	}
+	return false;
+}
+
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Maps a received key onto a command id
+ *
+ * @param[in] key
+ *   upper-case key characters, not NUL terminated
+ *
+ * @param[in] key_len
+ *   number of characters in key
+ *
+ * @return
+ *   matching command id, CmdInvalid if the key is unknown
+ *
+ ******************************************************************************/
+CMD_ID cmd_lookup(const char *key, uint32_t key_len) {
+	for(uint32_t i = 0; i < sizeof(cmd_keys) / sizeof(cmd_keys[0]); i++) {
+		if((strlen(cmd_keys[i].key) == key_len) && (strncmp(cmd_keys[i].key, key, key_len) == 0)) {
+			return cmd_keys[i].id;
+		}
+	}
+	return CmdInvalid;
+}
@@ -64,5 +64,8 @@ void cmu_open(void){
 		CMU_ClockEnable(cmuClock_CORELE, true);	//This enumeration is found in the Lab 2 assignment
 
 		CMU_ClockSelectSet(cmuClock_LFB, cmuSelect_LFXO);
+
+		// Route the LFXO to the RTCC clock tree for the accurate timebase
+		CMU_ClockSelectSet(cmuClock_LFE, cmuSelect_LFXO);
 }
 
@@ -0,0 +1,387 @@
+/**
+ * @file
+ * 	comfort.c
+ * @author
+ * 	Adam Chehadi
+ * @date
+ * 	05/23/2021
+ * @brief
+ *	Contains the comfort metrics derived from humidity and temperature, dew point, heat
+ *	index and absolute humidity, in fixed point without libm
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "comfort.h"
+#include "em_core.h"
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+#define Q16_ONE				65536
+#define MAGNUS_B			1154744			// 17.62, Q16 (Sonntag 1990, -45 C to 60 C)
+#define MAGNUS_C			15933112		// 243.12 C, Q16
+#define MAGNUS_ES0			400556			// 6.112 hPa, Q16
+#define LN_2				45426			// Q16
+#define LOG2_E				94548			// Q16
+#define KELVIN_0			17901158		// 273.15, Q16
+#define WATER_VAPOR_K		21674			// 2.1674 g K / (m3 hPa) x 10^4
+
+// log2(1 + i / 32), Q16
+static const int32_t log2_table[33] = {
+	0, 2909, 5732, 8473, 11136, 13727, 16248, 18704,
+	21098, 23433, 25711, 27936, 30109, 32234, 34312, 36346,
+	38336, 40286, 42196, 44068, 45904, 47705, 49472, 51207,
+	52911, 54584, 56229, 57845, 59434, 60997, 62534, 64047,
+	65536
+};
+
+// 2^(i / 32), Q16
+static const int32_t exp2_table[33] = {
+	65536, 66971, 68438, 69936, 71468, 73032, 74632, 76266,
+	77936, 79642, 81386, 83169, 84990, 86851, 88752, 90696,
+	92682, 94711, 96785, 98905, 101070, 103283, 105545, 107856,
+	110218, 112631, 115098, 117618, 120194, 122825, 125515, 128263,
+	131072
+};
+
+
+//***********************************************************************************
+// Private function prototypes
+//***********************************************************************************
+static int32_t comfort_ln_q16(uint32_t x);
+static int32_t comfort_exp_q16(int32_t x);
+static uint32_t comfort_isqrt(uint64_t x);
+static int32_t comfort_div_round(int64_t num, int64_t den);
+static int64_t comfort_div_round64(int64_t num, int64_t den);
+static int32_t comfort_celsius_q16(int32_t temperature);
+static int32_t comfort_magnus_q16(int32_t celsius);
+
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Dew point from the Magnus formula
+ *
+ * @details
+ * 	 g = ln(RH / 100) + b T / (c + T) and Td = c g / (b - g), with the Sonntag
+ * 	 constants b = 17.62, c = 243.12 C.  ln() is a 32 segment log2 table with linear
+ * 	 interpolation, within 0.07 F of the same formula in double precision from -40 F
+ * 	 to 140 F and 1 %RH to 100 %RH.  The formula itself is within 0.35 C of the
+ * 	 saturation curve from -45 C to 60 C.
+ *
+ * @param[in] humidity
+ *   relative humidity in 0.1 %RH, readings below 0.1 %RH are taken as 0.1 %RH
+ *
+ * @param[in] temperature
+ *   temperature in 0.1 F
+ *
+ * @return
+ *   dew point in 0.1 F
+ *
+ ******************************************************************************/
+int32_t comfort_dew_point(int32_t humidity, int32_t temperature) {
+	int32_t gamma;
+	int32_t dew_point;
+
+	if(humidity < 1) {
+		humidity = 1;
+	} else if(humidity > 1000) {
+		humidity = 1000;
+	}
+
+	gamma = comfort_ln_q16((uint32_t) (((int64_t) humidity * Q16_ONE + 500) / 1000))
+			+ comfort_magnus_q16(comfort_celsius_q16(temperature));
+	dew_point = (int32_t) (((int64_t) MAGNUS_C * gamma) / (MAGNUS_B - gamma));
+
+	return comfort_div_round((int64_t) dew_point * 18, Q16_ONE) + 320;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Heat index from the NWS algorithm
+ *
+ * @details
+ * 	 The simple Steadman estimate is used while it averages below 80 F with the
+ * 	 temperature, the Rothfusz regression with its low and high humidity adjustments
+ * 	 above.  The regression is evaluated exactly in 64-bit integers with its
+ * 	 coefficients x10^8 and its adjustments in 0.0001 F, so the result is within 0.06 F
+ * 	 of the same algorithm in double precision.  Past 80 F and 40 %RH the regression
+ * 	 is within 1.3 F of Steadman's table.
+ *
+ * @param[in] humidity
+ *   relative humidity in 0.1 %RH
+ *
+ * @param[in] temperature
+ *   temperature in 0.1 F
+ *
+ * @return
+ *   heat index in 0.1 F
+ *
+ ******************************************************************************/
+int32_t comfort_heat_index(int32_t humidity, int32_t temperature) {
+	const int64_t t = temperature;
+	const int64_t r = humidity;
+	int64_t sum;
+	uint32_t root;
+
+	// 0.5 (T + 61 + 1.2 (T - 68) + 0.094 RH), x1000 so the 80 F test is exact
+	sum = 500 * t + 305000 + 600 * (t - 680) + 47 * r;
+	if(sum + 1000 * t < 1600000) {
+		return comfort_div_round(sum, 1000);
+	}
+
+	// HI x10^12 with T and RH in tenths, every term brought to the same 10^4 denominator
+	sum = -4237900000LL * 10000
+			+ 204901523LL * t * 1000
+			+ 1014333127LL * r * 1000
+			- 22475541LL * t * r * 100
+			- 683783LL * t * t * 100
+			- 5481717LL * r * r * 100
+			+ 122874LL * t * t * r * 10
+			+ 85282LL * t * r * r * 10
+			- 199LL * t * t * r * r;
+	sum = comfort_div_round64(sum, 100000000);		// 0.0001 F from here on
+
+	if(r < 130 && t >= 800 && t <= 1120) {
+		// ((13 - RH) / 4) * sqrt((17 - |T - 95|) / 17)
+		root = comfort_isqrt(((uint64_t) (170 - (t > 950 ? t - 950 : 950 - t)) << 32) / 170);
+		sum -= comfort_div_round64((130 - r) * 250 * root, Q16_ONE);
+	} else if(r > 850 && t >= 800 && t <= 870) {
+		// ((RH - 85) / 10) * ((87 - T) / 5)
+		sum += (r - 850) * (870 - t) * 2;
+	}
+	return comfort_div_round(sum, 1000);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Absolute humidity
+ *
+ * @details
+ * 	 AH = 6.112 hPa exp(b T / (c + T)) RH 2.1674 / (273.15 + T) in g/m3, the Magnus
+ * 	 saturation pressure with the same constants as the dew point.  exp() is a 32
+ * 	 segment 2^x table with linear interpolation, within 0.2 %, or 0.01 g/m3 below
+ * 	 5 g/m3, of the same formula in double precision from -40 F to 140 F.
+ *
+ * @param[in] humidity
+ *   relative humidity in 0.1 %RH
+ *
+ * @param[in] temperature
+ *   temperature in 0.1 F
+ *
+ * @return
+ *   absolute humidity in 0.01 g/m3
+ *
+ ******************************************************************************/
+int32_t comfort_abs_humidity(int32_t humidity, int32_t temperature) {
+	int32_t celsius = comfort_celsius_q16(temperature);
+	int64_t saturation;
+
+	if(humidity <= 0) {
+		return 0;
+	}
+
+	saturation = ((int64_t) MAGNUS_ES0 * comfort_exp_q16(comfort_magnus_q16(celsius))) >> 16;
+	return comfort_div_round(saturation * humidity * WATER_VAPOR_K, ((int64_t) KELVIN_0 + celsius) * 1000);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Computes every comfort metric of one reading
+ *
+ * @param[in] humidity
+ *   relative humidity in 0.1 %RH
+ *
+ * @param[in] temperature
+ *   temperature in 0.1 F
+ *
+ * @param[out] comfort
+ *   the metrics
+ *
+ ******************************************************************************/
+void comfort_compute(int32_t humidity, int32_t temperature, COMFORT *comfort) {
+	comfort->dew_point = comfort_dew_point(humidity, temperature);
+	comfort->heat_index = comfort_heat_index(humidity, temperature);
+	comfort->abs_humidity = comfort_abs_humidity(humidity, temperature);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Measures the cost of a metric with the DWT cycle counter
+ *
+ * @details
+ * 	 Averages COMFORT_BENCH_CALLS calls spread over 20 to 100 %RH and 40 to 120 F with
+ * 	 interrupts off, so the heat index takes both of its branches.
+ *
+ * @note
+ *   Enables the DWT cycle counter and leaves it running.
+ *
+ * @param[in] metric
+ *   ComfortXxx
+ *
+ * @return
+ *   cycles per call
+ *
+ ******************************************************************************/
+uint32_t comfort_benchmark(COMFORT_METRIC metric) {
+	volatile int32_t sink = 0;
+	int32_t humidity;
+	int32_t temperature;
+	uint32_t start;
+	uint32_t cycles;
+
+	EFM_ASSERT(metric < ComfortMetrics);
+
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	CORE_DECLARE_IRQ_STATE;
+	CORE_ENTER_CRITICAL();
+	start = DWT->CYCCNT;
+	for(uint32_t i = 0; i < COMFORT_BENCH_CALLS; i++) {
+		humidity = 200 + (int32_t) (i % 8) * 100;
+		temperature = 400 + (int32_t) (i / 8) * 100;
+		switch(metric) {
+			case ComfortDewPoint:
+				sink = comfort_dew_point(humidity, temperature);
+				break;
+			case ComfortHeatIndex:
+				sink = comfort_heat_index(humidity, temperature);
+				break;
+			default:
+				sink = comfort_abs_humidity(humidity, temperature);
+				break;
+		}
+	}
+	cycles = DWT->CYCCNT - start;
+	CORE_EXIT_CRITICAL();
+
+	(void) sink;
+	return cycles / COMFORT_BENCH_CALLS;
+}
+
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Natural log of a positive Q16 number, Q16
+ *
+ ******************************************************************************/
+int32_t comfort_ln_q16(uint32_t x) {
+	int32_t msb = 31;
+	uint32_t mantissa;
+	uint32_t index;
+	uint32_t frac;
+	int32_t log2;
+
+	EFM_ASSERT(x > 0);
+
+	while(!(x & (1UL << msb))) {
+		msb--;
+	}
+	mantissa = x << (31 - msb);				// 1.xxx in Q31
+	index = (mantissa >> 26) & 0x1F;
+	frac = (mantissa >> 10) & 0xFFFF;		// position inside the segment, Q16
+
+	log2 = (msb - 16) * Q16_ONE + log2_table[index]
+			+ (int32_t) (((int64_t) (log2_table[index + 1] - log2_table[index]) * frac) >> 16);
+	return (int32_t) (((int64_t) log2 * LN_2) >> 16);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   e^x of a Q16 number, Q16, for results up to 2^15
+ *
+ ******************************************************************************/
+int32_t comfort_exp_q16(int32_t x) {
+	int32_t y = (int32_t) (((int64_t) x * LOG2_E) >> 16);		// log2 of the result
+	int32_t whole = y >> 16;									// floor
+	uint32_t fraction = (uint32_t) y & 0xFFFF;
+	uint32_t index = fraction >> 11;
+	uint32_t frac = (fraction << 5) & 0xFFFF;
+	int32_t value;
+
+	EFM_ASSERT(whole < 15);
+
+	value = exp2_table[index] + (int32_t) (((int64_t) (exp2_table[index + 1] - exp2_table[index]) * frac) >> 16);
+	return whole >= 0 ? value << whole : value >> -whole;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Integer square root, floor(sqrt(x))
+ *
+ ******************************************************************************/
+uint32_t comfort_isqrt(uint64_t x) {
+	uint64_t root = 0;
+	uint64_t bit = 1ULL << 62;
+
+	while(bit > x) {
+		bit >>= 2;
+	}
+	while(bit) {
+		if(x >= root + bit) {
+			x -= root + bit;
+			root = (root >> 1) + bit;
+		} else {
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	return (uint32_t) root;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Division rounded to the nearest, halves away from zero, den > 0
+ *
+ ******************************************************************************/
+int32_t comfort_div_round(int64_t num, int64_t den) {
+	return (int32_t) comfort_div_round64(num, den);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   64-bit comfort_div_round()
+ *
+ ******************************************************************************/
+int64_t comfort_div_round64(int64_t num, int64_t den) {
+	return num >= 0 ? (num + den / 2) / den : (num - den / 2) / den;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Converts 0.1 F to C in Q16
+ *
+ ******************************************************************************/
+int32_t comfort_celsius_q16(int32_t temperature) {
+	return (int32_t) (((int64_t) (temperature - 320) * Q16_ONE * 5) / 90);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns b T / (c + T), the temperature term of the Magnus formula, Q16
+ *
+ ******************************************************************************/
+int32_t comfort_magnus_q16(int32_t celsius) {
+	return (int32_t) ((((int64_t) MAGNUS_B * celsius) >> 16) * Q16_ONE / ((int64_t) MAGNUS_C + celsius));
+}
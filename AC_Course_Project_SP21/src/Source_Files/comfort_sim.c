@@ -0,0 +1,204 @@
+/**
+ * @file
+ * 	comfort_sim.c
+ * @author
+ * 	Adam Chehadi
+ * @date
+ * 	05/24/2021
+ * @brief
+ *	Contains the host check of the comfort metrics against double precision
+ *
+ * @details
+ *	Only built with COMFORT_SIM defined, the firmware build compiles it to nothing.
+ *	From src:
+ *
+ *	gcc -DCOMFORT_SIM -IHost_Files -IHeader_Files Source_Files/comfort_sim.c Source_Files/comfort.c -lm -o comfort_sim
+ *
+ *	Every metric is computed from -40 F to 140 F by 0.1 F and 0.1 %RH to 100 %RH by
+ *	0.1 %RH and compared with the same formula in double precision.  The worst error
+ *	of each metric is printed with where it occurs, and the program returns non-zero
+ *	if one exceeds the bound given in the doc comment of comfort.c, so re-run it after
+ *	a change to the tables or constants.
+ */
+
+#ifdef COMFORT_SIM
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <stdio.h>
+#include <math.h>
+
+#include "comfort.h"
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+#define SIM_T_MIN				-400		// 0.1 F
+#define SIM_T_MAX				1400
+#define SIM_RH_MAX				1000		// 0.1 %RH
+
+// Bounds of the doc comments of comfort.c
+#define SIM_DEW_POINT_F			0.07		// from 1 %RH
+#define SIM_DEW_POINT_RH_MIN	10
+#define SIM_HEAT_INDEX_F		0.06
+#define SIM_ABS_HUMIDITY_REL	0.002
+#define SIM_ABS_HUMIDITY_ABS	0.01		// g/m3, below SIM_ABS_HUMIDITY_LOW
+#define SIM_ABS_HUMIDITY_LOW	5.0
+
+typedef struct {
+	const char		*name;
+	const char		*unit;
+	double			bound;
+	double			worst;
+	int32_t			humidity;			// where the worst error is
+	int32_t			temperature;
+} SIM_ERROR;
+
+
+//***********************************************************************************
+// Private function prototypes
+//***********************************************************************************
+static double sim_dew_point(double temperature, double humidity);
+static double sim_heat_index(double temperature, double humidity);
+static double sim_abs_humidity(double temperature, double humidity);
+static void sim_record(SIM_ERROR *error, double value, int32_t humidity, int32_t temperature);
+static uint32_t sim_report(const SIM_ERROR *error);
+
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Sweeps every metric and compares the worst errors with their bounds
+ *
+ * @return
+ *   0 if every metric is within its bound
+ *
+ ******************************************************************************/
+int main(void) {
+	SIM_ERROR dew_point = { "dew point", "F", SIM_DEW_POINT_F, 0, 0, 0 };
+	SIM_ERROR heat_index = { "heat index", "F", SIM_HEAT_INDEX_F, 0, 0, 0 };
+	SIM_ERROR abs_relative = { "absolute humidity", "%", SIM_ABS_HUMIDITY_REL * 100, 0, 0, 0 };
+	SIM_ERROR abs_low = { "absolute humidity below 5 g/m3", "g/m3", SIM_ABS_HUMIDITY_ABS, 0, 0, 0 };
+	double temperature;
+	double humidity;
+	double reference;
+	uint32_t failed = 0;
+
+	for(int32_t t = SIM_T_MIN; t <= SIM_T_MAX; t++) {
+		for(int32_t h = 1; h <= SIM_RH_MAX; h++) {
+			temperature = t / 10.0;
+			humidity = h / 10.0;
+
+			if(h >= SIM_DEW_POINT_RH_MIN) {
+				sim_record(&dew_point, comfort_dew_point(h, t) / 10.0 - sim_dew_point(temperature, humidity), h, t);
+			}
+			sim_record(&heat_index, comfort_heat_index(h, t) / 10.0 - sim_heat_index(temperature, humidity), h, t);
+
+			reference = sim_abs_humidity(temperature, humidity);
+			if(reference < SIM_ABS_HUMIDITY_LOW) {
+				sim_record(&abs_low, comfort_abs_humidity(h, t) / 100.0 - reference, h, t);
+			} else {
+				sim_record(&abs_relative, (comfort_abs_humidity(h, t) / 100.0 - reference) / reference * 100, h, t);
+			}
+		}
+	}
+
+	failed += sim_report(&dew_point);
+	failed += sim_report(&heat_index);
+	failed += sim_report(&abs_relative);
+	failed += sim_report(&abs_low);
+	printf("%lu failed\n", (unsigned long) failed);
+	return failed ? 1 : 0;
+}
+
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Magnus dew point in F, as comfort_dew_point()
+ *
+ ******************************************************************************/
+double sim_dew_point(double temperature, double humidity) {
+	double celsius = (temperature - 32) * 5 / 9;
+	double gamma = log(humidity / 100) + 17.62 * celsius / (243.12 + celsius);
+
+	return 243.12 * gamma / (17.62 - gamma) * 1.8 + 32;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   NWS heat index in F, as comfort_heat_index()
+ *
+ ******************************************************************************/
+double sim_heat_index(double temperature, double humidity) {
+	const double t = temperature;
+	const double r = humidity;
+	double simple = 0.5 * (t + 61.0 + (t - 68.0) * 1.2 + r * 0.094);
+	double index;
+
+	if((simple + t) / 2 < 80) {
+		return simple;
+	}
+	index = -42.379 + 2.04901523 * t + 10.14333127 * r - 0.22475541 * t * r - 0.00683783 * t * t
+			- 0.05481717 * r * r + 0.00122874 * t * t * r + 0.00085282 * t * r * r - 0.00000199 * t * t * r * r;
+	if(r < 13 && t >= 80 && t <= 112) {
+		index -= ((13 - r) / 4) * sqrt((17 - fabs(t - 95)) / 17);
+	} else if(r > 85 && t >= 80 && t <= 87) {
+		index += ((r - 85) / 10) * ((87 - t) / 5);
+	}
+	return index;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Absolute humidity in g/m3, as comfort_abs_humidity()
+ *
+ ******************************************************************************/
+double sim_abs_humidity(double temperature, double humidity) {
+	double celsius = (temperature - 32) * 5 / 9;
+
+	return 6.112 * exp(17.62 * celsius / (243.12 + celsius)) * humidity * 2.1674 / (273.15 + celsius);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Keeps the largest error of a metric and where it occurs
+ *
+ ******************************************************************************/
+void sim_record(SIM_ERROR *error, double value, int32_t humidity, int32_t temperature) {
+	if(fabs(value) > error->worst) {
+		error->worst = fabs(value);
+		error->humidity = humidity;
+		error->temperature = temperature;
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Prints the worst error of a metric
+ *
+ * @return
+ *   1 if it exceeds the bound
+ *
+ ******************************************************************************/
+uint32_t sim_report(const SIM_ERROR *error) {
+	bool over = error->worst > error->bound;
+
+	printf("%s: worst %.4f %s at %.1f %%RH %.1f F, bound %.4f %s%s\n", error->name, error->worst, error->unit,
+			error->humidity / 10.0, error->temperature / 10.0, error->bound, error->unit, over ? ", EXCEEDED" : "");
+	return over ? 1 : 0;
+}
+
+#endif
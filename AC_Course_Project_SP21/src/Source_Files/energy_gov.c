@@ -0,0 +1,237 @@
+/**
+ * @file
+ * 	energy_gov.c
+ * @author
+ * 	Adam Chehadi
+ * @date
+ * 	05/24/2021
+ * @brief
+ *	Contains the energy budget governor, which estimates the energy drawn from the
+ *	battery and picks the operating level that makes it last the target lifetime
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "energy_gov.h"
+
+
+//***********************************************************************************
+// Private function prototypes
+//***********************************************************************************
+static uint64_t energy_gov_window_nj(const ENERGY_GOV *gov, const ENERGY_METER *meter);
+static uint32_t energy_gov_budget_uw(const ENERGY_GOV *gov, uint64_t now_ms);
+
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Starts a governor on a new battery
+ *
+ * @details
+ * 	 The governor starts at the richest level with no target, call energy_gov_target()
+ * 	 to give it one.  The file only depends on stdint.h and stdbool.h so it runs in a
+ * 	 host simulation against a battery model unchanged.
+ *
+ * @param[in] gov
+ *   governor state
+ *
+ * @param[in] model
+ *   currents of the board, kept by reference
+ *
+ * @param[in] levels
+ *   operating points, 1 to ENERGY_GOV_MAX_LEVELS
+ *
+ * @param[in] meter
+ *   current totals, the battery is taken as new from here
+ *
+ ******************************************************************************/
+void energy_gov_init(ENERGY_GOV *gov, const ENERGY_MODEL *model, uint32_t levels, const ENERGY_METER *meter) {
+	gov->model = model;
+	gov->start_ms = meter->time_ms;
+	gov->capacity_nj = 0;
+	gov->lifetime_days = 0;
+	gov->cutoff_mv = 0;
+	gov->used_nj = 0;
+	gov->levels = levels < 1 ? 1 : levels > ENERGY_GOV_MAX_LEVELS ? ENERGY_GOV_MAX_LEVELS : levels;
+	gov->level = 0;
+	gov->power_uw = 0;
+	gov->budget_uw = UINT32_MAX;
+	for(uint32_t i = 0; i < ENERGY_GOV_MAX_LEVELS; i++) {
+		gov->level_uw[i] = 0;
+	}
+	gov->last = *meter;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Sets the battery and the lifetime it has to reach
+ *
+ * @details
+ * 	 The lifetime counts from energy_gov_init(), so a target changed later still
+ * 	 accounts for the energy already drawn.  Takes effect at the next update.
+ *
+ * @param[in] gov
+ *   governor state
+ *
+ * @param[in] capacity_mwh
+ *   usable energy of the new battery, mAh x nominal V
+ *
+ * @param[in] lifetime_days
+ *   target, 0 turns the governor off and it returns to level 0
+ *
+ * @param[in] cutoff_mv
+ *   supply below which the battery is treated as empty whatever the estimate says
+ *
+ ******************************************************************************/
+void energy_gov_target(ENERGY_GOV *gov, uint32_t capacity_mwh, uint32_t lifetime_days, uint32_t cutoff_mv) {
+	gov->capacity_nj = capacity_mwh * ENERGY_NJ_PER_MWH;
+	gov->lifetime_days = lifetime_days;
+	gov->cutoff_mv = cutoff_mv;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Charges the energy drawn since the last update and moves the level
+ *
+ * @details
+ * 	 The window's energy is the model's charge for the time spent in each energy mode,
+ * 	 the radio traffic and the sensor conversions, times the supply voltage.  Its
+ * 	 average power is compared with the budget, the energy left spread over the time
+ * 	 left, so an early overspend is paid back later and an underspend is given back.
+ * 	 Over budget the governor moves one level leaner.  Under budget it moves one level
+ * 	 richer when the power last measured there fits ENERGY_GOV_HEADROOM_PCT of the
+ * 	 budget, or, for a level it has no fresh figure for, when twice the current power
+ * 	 does.  The figures of the other levels fade each window so a level that was too
+ * 	 expensive once is tried again after the conditions change.  A supply at or below
+ * 	 the cutoff forces the leanest level.
+ *
+ * @param[in] gov
+ *   governor state
+ *
+ * @param[in] meter
+ *   current totals
+ *
+ * @return
+ *   true if the level changed
+ *
+ ******************************************************************************/
+bool energy_gov_update(ENERGY_GOV *gov, const ENERGY_METER *meter) {
+	uint64_t window_ms = meter->time_ms - gov->last.time_ms;
+	uint64_t window_nj;
+	uint32_t level = gov->level;
+	uint64_t richer_uw;
+
+	if(!window_ms) {
+		return false;
+	}
+
+	window_nj = energy_gov_window_nj(gov, meter);
+	gov->used_nj += window_nj;
+	gov->power_uw = (uint32_t) (window_nj / window_ms);
+	gov->budget_uw = energy_gov_budget_uw(gov, meter->time_ms);
+	gov->last = *meter;
+
+	for(uint32_t i = 0; i < gov->levels; i++) {
+		if(i == level) {
+			gov->level_uw[i] = gov->level_uw[i] ? (gov->level_uw[i] + gov->power_uw) / 2 : gov->power_uw;
+		} else {
+			gov->level_uw[i] -= gov->level_uw[i] >> ENERGY_GOV_FORGET_SHIFT;
+		}
+	}
+
+	if(!gov->lifetime_days) {
+		level = 0;
+	} else if(meter->supply_mv && meter->supply_mv <= gov->cutoff_mv) {
+		level = gov->levels - 1;
+	} else if(gov->power_uw > gov->budget_uw) {
+		if(level < gov->levels - 1) {
+			level++;
+		}
+	} else if(level > 0) {
+		richer_uw = gov->level_uw[level - 1] ? gov->level_uw[level - 1] : 2 * (uint64_t) gov->power_uw;
+		if(richer_uw * 100 <= (uint64_t) gov->budget_uw * ENERGY_GOV_HEADROOM_PCT) {
+			level--;
+		}
+	}
+
+	if(level == gov->level) {
+		return false;
+	}
+	gov->level = level;
+	return true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Estimates how long the battery lasts at the last window's power
+ *
+ * @param[in] gov
+ *   governor state
+ *
+ * @return
+ *   days, UINT32_MAX before the first window
+ *
+ ******************************************************************************/
+uint32_t energy_gov_days_left(const ENERGY_GOV *gov) {
+	uint64_t left_nj = gov->capacity_nj > gov->used_nj ? gov->capacity_nj - gov->used_nj : 0;
+	uint64_t days;
+
+	if(!gov->power_uw) {
+		return UINT32_MAX;
+	}
+	days = left_nj / gov->power_uw / ENERGY_MS_PER_DAY;
+	return days > UINT32_MAX ? UINT32_MAX : (uint32_t) days;
+}
+
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Energy drawn between the last meter and this one, nJ
+ *
+ ******************************************************************************/
+uint64_t energy_gov_window_nj(const ENERGY_GOV *gov, const ENERGY_METER *meter) {
+	const ENERGY_MODEL *model = gov->model;
+	const ENERGY_METER *last = &gov->last;
+	uint64_t charge_nc;
+	uint32_t supply_mv = meter->supply_mv ? meter->supply_mv : model->nominal_mv;
+
+	charge_nc = (uint64_t) model->base_ua * (meter->time_ms - last->time_ms);
+	for(uint32_t i = 0; i < ENERGY_EMS; i++) {
+		charge_nc += (uint64_t) model->em_ua[i] * (meter->em_ms[i] - last->em_ms[i]);
+	}
+	charge_nc += (uint64_t) model->tx_byte_nc * (uint32_t) (meter->tx_bytes - last->tx_bytes);
+	charge_nc += (uint64_t) model->tx_write_nc * (uint32_t) (meter->tx_writes - last->tx_writes);
+	charge_nc += (uint64_t) model->rx_byte_nc * (uint32_t) (meter->rx_bytes - last->rx_bytes);
+	charge_nc += meter->sensor_nc - last->sensor_nc;
+
+	return charge_nc * supply_mv / 1000;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Average power the energy left allows until the end of the target, uW
+ *
+ ******************************************************************************/
+uint32_t energy_gov_budget_uw(const ENERGY_GOV *gov, uint64_t now_ms) {
+	uint64_t end_ms = gov->start_ms + gov->lifetime_days * ENERGY_MS_PER_DAY;
+	uint64_t left_nj = gov->capacity_nj > gov->used_nj ? gov->capacity_nj - gov->used_nj : 0;
+	uint64_t budget;
+
+	if(!gov->lifetime_days || now_ms >= end_ms) {
+		return UINT32_MAX;
+	}
+	budget = left_nj / (end_ms - now_ms);
+	return budget > UINT32_MAX ? UINT32_MAX : (uint32_t) budget;
+}
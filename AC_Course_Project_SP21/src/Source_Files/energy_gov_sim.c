@@ -0,0 +1,220 @@
+/**
+ * @file
+ * 	energy_gov_sim.c
+ * @author
+ * 	Adam Chehadi
+ * @date
+ * 	05/24/2021
+ * @brief
+ *	Contains the host simulation of the energy governor against a battery model
+ *
+ * @details
+ *	Only built with ENERGY_GOV_SIM defined, the firmware build compiles it to nothing.
+ *	From src:
+ *
+ *	gcc -DENERGY_GOV_SIM -IHeader_Files Source_Files/energy_gov_sim.c Source_Files/energy_gov.c -o energy_gov_sim
+ *
+ *	The board is simulated a second at a time at the governor's level, with the level
+ *	table and current model app.c takes from energy_levels.h.  The battery is a pair of alkaline
+ *	cells whose voltage follows their state of charge, drained by the true current,
+ *	which can be set off the model to see what a badly calibrated model costs.  Every
+ *	scenario checks its outcome and the program returns non-zero if one fails.
+ */
+
+#ifdef ENERGY_GOV_SIM
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <stdio.h>
+
+#include "energy_levels.h"
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+#define SIM_STEP_MS				1000
+#define SIM_SAMPLE_EM0_MS		5			// core awake per sample
+#define SIM_SAMPLE_BYTES		40			// telemetry per sample
+#define SIM_DEAD_MV				1800		// the board browns out
+
+typedef struct {
+	const char		*name;
+	uint32_t		capacity_mwh;
+	uint32_t		lifetime_days;
+	uint32_t		truth_pct;				// true current as a percentage of the model's
+	uint32_t		min_pct;				// pass if the battery lasts this share of the target
+	uint32_t		max_pct;				// and no longer than this share, 0 for no limit
+	uint32_t		leanest_pct;			// and spent at least this share at the leanest level
+} SIM_SCENARIO;
+
+typedef struct {
+	uint32_t		soc_pct;
+	uint32_t		mv;
+} SIM_CURVE_POINT;
+
+static const ENERGY_LEVEL sim_level[ENERGY_LEVELS] = ENERGY_LEVEL_TABLE;
+static const ENERGY_MODEL sim_model = ENERGY_MODEL_DEFAULT;
+
+// Two alkaline cells under a light load, from full to empty
+static const SIM_CURVE_POINT sim_curve[] = {
+	{ 100, 3200 }, { 80, 2800 }, { 50, 2600 }, { 20, 2400 }, { 10, 2200 }, { 5, 2000 }, { 0, 1800 }
+};
+
+static const SIM_SCENARIO sim_scenario[] = {
+	{ "easy target, level 0 is enough",	6000, 365, 100, 100, 0, 0 },
+	{ "target past level 0",			6000, 500, 100, 97, 110, 0 },
+	{ "target no level reaches",		6000, 2000, 100, 0, 0, 90 },
+	{ "model 15% optimistic",			6000, 500, 115, 85, 110, 0 },
+	{ "no target",						6000, 0, 100, 0, 0, 0 }
+};
+
+
+//***********************************************************************************
+// Private function prototypes
+//***********************************************************************************
+static uint32_t sim_battery_mv(double used_mwh, uint32_t capacity_mwh);
+static bool sim_run(const SIM_SCENARIO *scenario);
+
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Runs every scenario
+ *
+ * @return
+ *   0 if every scenario passed
+ *
+ ******************************************************************************/
+int main(void) {
+	uint32_t failed = 0;
+
+	for(uint32_t i = 0; i < sizeof(sim_scenario) / sizeof(sim_scenario[0]); i++) {
+		if(!sim_run(&sim_scenario[i])) {
+			failed++;
+		}
+	}
+	printf("%lu failed\n", (unsigned long) failed);
+	return failed ? 1 : 0;
+}
+
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Battery voltage at a state of charge, interpolated on sim_curve
+ *
+ ******************************************************************************/
+uint32_t sim_battery_mv(double used_mwh, uint32_t capacity_mwh) {
+	double soc_pct = 100.0 * (1.0 - used_mwh / capacity_mwh);
+	const SIM_CURVE_POINT *hi;
+	const SIM_CURVE_POINT *lo;
+
+	if(soc_pct <= 0) {
+		return 0;
+	}
+	for(uint32_t i = 1; i < sizeof(sim_curve) / sizeof(sim_curve[0]); i++) {
+		hi = &sim_curve[i - 1];
+		lo = &sim_curve[i];
+		if(soc_pct >= lo->soc_pct) {
+			return (uint32_t) (lo->mv + (hi->mv - lo->mv) * (soc_pct - lo->soc_pct) / (hi->soc_pct - lo->soc_pct));
+		}
+	}
+	return 0;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Runs the board on a new battery until it browns out
+ *
+ * @param[in] scenario
+ *   battery, target and how far the true current is off the model
+ *
+ * @return
+ *   true if the outcome is within the scenario's limits
+ *
+ ******************************************************************************/
+bool sim_run(const SIM_SCENARIO *scenario) {
+	ENERGY_METER meter = { 0 };
+	ENERGY_METER last;
+	ENERGY_GOV gov;
+	uint64_t level_ms[ENERGY_LEVELS] = { 0 };
+	uint64_t since_sample_ms = 0;
+	uint32_t samples = 0;
+	double used_mwh = 0;
+	double charge_nc;
+	uint32_t mv;
+	uint32_t em0_ms;
+	const ENERGY_LEVEL *level;
+	double days;
+	uint32_t lasted_pct = 0;
+	uint32_t leanest_pct;
+	bool pass;
+
+	meter.supply_mv = sim_battery_mv(0, scenario->capacity_mwh);
+	energy_gov_init(&gov, &sim_model, ENERGY_LEVELS, &meter);
+	energy_gov_target(&gov, scenario->capacity_mwh, scenario->lifetime_days, ENERGY_CUTOFF_MV);
+
+	while((mv = sim_battery_mv(used_mwh, scenario->capacity_mwh)) > SIM_DEAD_MV) {
+		level = &sim_level[gov.level];
+		last = meter;
+
+		em0_ms = 0;
+		since_sample_ms += SIM_STEP_MS;
+		while(since_sample_ms >= ENERGY_PERIOD_MS * level->period_mult) {
+			since_sample_ms -= ENERGY_PERIOD_MS * level->period_mult;
+			samples++;
+			em0_ms += SIM_SAMPLE_EM0_MS;
+			meter.tx_bytes += SIM_SAMPLE_BYTES;
+			meter.sensor_nc += level->conversion_ms * ENERGY_SI7021_UA;
+			if(!(samples % level->batch_size)) {
+				meter.tx_writes++;
+			}
+		}
+		meter.time_ms += SIM_STEP_MS;
+		meter.em_ms[0] += em0_ms;
+		meter.em_ms[2] += SIM_STEP_MS - em0_ms;
+		meter.supply_mv = mv;
+		level_ms[gov.level] += SIM_STEP_MS;
+
+		// What the battery really gave, the model's charge scaled by the truth
+		charge_nc = (double) sim_model.base_ua * SIM_STEP_MS
+				+ (double) sim_model.em_ua[0] * (meter.em_ms[0] - last.em_ms[0])
+				+ (double) sim_model.em_ua[2] * (meter.em_ms[2] - last.em_ms[2])
+				+ (double) sim_model.tx_byte_nc * (meter.tx_bytes - last.tx_bytes)
+				+ (double) sim_model.tx_write_nc * (meter.tx_writes - last.tx_writes)
+				+ (double) (meter.sensor_nc - last.sensor_nc);
+		used_mwh += charge_nc * scenario->truth_pct / 100 * mv / 3.6e12;		// nC x mV = pJ
+
+		if(!(meter.time_ms % ENERGY_WINDOW_MS)) {
+			energy_gov_update(&gov, &meter);
+		}
+	}
+
+	days = (double) meter.time_ms / ENERGY_MS_PER_DAY;
+	if(scenario->lifetime_days) {
+		lasted_pct = (uint32_t) (100 * days / scenario->lifetime_days);
+	}
+	leanest_pct = (uint32_t) (100 * level_ms[ENERGY_LEVELS - 1] / meter.time_ms);
+	pass = (lasted_pct >= scenario->min_pct) && (!scenario->max_pct || lasted_pct <= scenario->max_pct)
+			&& (leanest_pct >= scenario->leanest_pct);
+
+	printf("%s: %s, %.1f days of %lu, estimated %lu of %.0f mWh, levels",
+			pass ? "pass" : "FAIL", scenario->name, days, (unsigned long) scenario->lifetime_days,
+			(unsigned long) (gov.used_nj / ENERGY_NJ_PER_MWH), used_mwh);
+	for(uint32_t i = 0; i < ENERGY_LEVELS; i++) {
+		printf(" %lu%%", (unsigned long) (100 * level_ms[i] / meter.time_ms));
+	}
+	printf("\n");
+	return pass;
+}
+
+#endif
@@ -0,0 +1,214 @@
+/**
+ * @file
+ * 	fft.c
+ * @author
+ * 	Adam Chehadi
+ * @date
+ * 	05/22/2021
+ * @brief
+ *	Contains a fixed point radix-4 complex FFT in Q15, laid out like the CMSIS-DSP
+ *	radix-4 butterfly, and its sine table
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "fft.h"
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+// sin(2 pi k / FFT_SIZE_MAX) in Q15 for the first quarter turn, the rest by symmetry
+static const int16_t fft_sin_table[FFT_SIN_QUARTER + 1] = {
+	0, 804, 1608, 2411, 3212, 4011, 4808, 5602,
+	6393, 7180, 7962, 8740, 9512, 10279, 11039, 11793,
+	12540, 13279, 14010, 14733, 15447, 16151, 16846, 17531,
+	18205, 18868, 19520, 20160, 20788, 21403, 22006, 22595,
+	23170, 23732, 24279, 24812, 25330, 25833, 26320, 26791,
+	27246, 27684, 28106, 28511, 28899, 29269, 29622, 29957,
+	30274, 30572, 30853, 31114, 31357, 31581, 31786, 31972,
+	32138, 32286, 32413, 32522, 32610, 32679, 32729, 32758,
+	32767
+};
+
+
+//***********************************************************************************
+// Private function prototypes
+//***********************************************************************************
+static void fft_digit_reverse(int16_t *data, uint32_t size);
+
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   In-place radix-4 decimation in frequency FFT
+ *
+ * @details
+ * 	 Every stage splits each block into four quarters a, b, c, d and replaces them with
+ * 	 a+b+c+d, (a-jb-c+jd)W^n, (a-b+c-d)W^2n and (a+jb-c-jd)W^3n, the inputs of the four
+ * 	 quarter size transforms.  Each stage divides by 4 so nothing overflows, the output
+ * 	 is the DFT divided by size.  A base-4 digit reversal puts the bins in order.
+ *
+ * @param[in] data
+ *   size complex samples, real and imaginary interleaved, Q15
+ *
+ * @param[in] size
+ *   4, 16, 64 or 256
+ *
+ ******************************************************************************/
+void fft_radix4_q15(int16_t *data, uint32_t size) {
+	int32_t ar, ai, br, bi, cr, ci, dr, di;
+	int32_t s0r, s0i, s1r, s1i, d0r, d0i, d1r, d1i;
+	int32_t yr, yi;
+	int32_t wr, wi;
+	uint32_t quarter;
+	uint32_t step;
+	uint32_t p;
+
+	EFM_ASSERT(size >= 4 && size <= FFT_SIZE_MAX && (size & (size - 1)) == 0 && (size & 0x55555555));
+
+	for(uint32_t span = size; span >= 4; span >>= 2) {
+		quarter = span >> 2;
+		step = FFT_SIZE_MAX / span;
+
+		for(uint32_t n = 0; n < quarter; n++) {
+			for(uint32_t block = 0; block < size; block += span) {
+				p = 2 * (block + n);
+				ar = data[p];
+				ai = data[p + 1];
+				br = data[p + 2 * quarter];
+				bi = data[p + 2 * quarter + 1];
+				cr = data[p + 4 * quarter];
+				ci = data[p + 4 * quarter + 1];
+				dr = data[p + 6 * quarter];
+				di = data[p + 6 * quarter + 1];
+
+				s0r = ar + cr;	s0i = ai + ci;		// a + c
+				d0r = ar - cr;	d0i = ai - ci;		// a - c
+				s1r = br + dr;	s1i = bi + di;		// b + d
+				d1r = br - dr;	d1i = bi - di;		// b - d
+
+				data[p] = (int16_t) ((s0r + s1r) >> 2);
+				data[p + 1] = (int16_t) ((s0i + s1i) >> 2);
+
+				// (a - c) - j(b - d), times W^n = cos - j sin
+				yr = (d0r + d1i) >> 2;
+				yi = (d0i - d1r) >> 2;
+				wr = fft_cos_q15(n * step);
+				wi = fft_sin_q15(n * step);
+				data[p + 2 * quarter] = (int16_t) ((yr * wr + yi * wi) >> 15);
+				data[p + 2 * quarter + 1] = (int16_t) ((yi * wr - yr * wi) >> 15);
+
+				// (a + c) - (b + d), times W^2n
+				yr = (s0r - s1r) >> 2;
+				yi = (s0i - s1i) >> 2;
+				wr = fft_cos_q15(2 * n * step);
+				wi = fft_sin_q15(2 * n * step);
+				data[p + 4 * quarter] = (int16_t) ((yr * wr + yi * wi) >> 15);
+				data[p + 4 * quarter + 1] = (int16_t) ((yi * wr - yr * wi) >> 15);
+
+				// (a - c) + j(b - d), times W^3n
+				yr = (d0r - d1i) >> 2;
+				yi = (d0i + d1r) >> 2;
+				wr = fft_cos_q15(3 * n * step);
+				wi = fft_sin_q15(3 * n * step);
+				data[p + 6 * quarter] = (int16_t) ((yr * wr + yi * wi) >> 15);
+				data[p + 6 * quarter + 1] = (int16_t) ((yi * wr - yr * wi) >> 15);
+			}
+		}
+	}
+
+	fft_digit_reverse(data, size);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns sin(2 pi k / FFT_SIZE_MAX) in Q15
+ *
+ ******************************************************************************/
+int16_t fft_sin_q15(uint32_t k) {
+	k %= FFT_SIZE_MAX;
+
+	if(k <= FFT_SIN_QUARTER) {
+		return fft_sin_table[k];
+	}
+	if(k <= 2 * FFT_SIN_QUARTER) {
+		return fft_sin_table[2 * FFT_SIN_QUARTER - k];
+	}
+	if(k <= 3 * FFT_SIN_QUARTER) {
+		return (int16_t) -fft_sin_table[k - 2 * FFT_SIN_QUARTER];
+	}
+	return (int16_t) -fft_sin_table[FFT_SIZE_MAX - k];
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns cos(2 pi k / FFT_SIZE_MAX) in Q15
+ *
+ ******************************************************************************/
+int16_t fft_cos_q15(uint32_t k) {
+	return fft_sin_q15(k + FFT_SIN_QUARTER);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Applies a Hann window in place
+ *
+ * @details
+ * 	 w(n) = (1 - cos(2 pi n / size)) / 2, so a tone between two bins leaks into its
+ * 	 neighbours instead of across the whole spectrum.
+ *
+ * @param[in] samples
+ *   size real samples
+ *
+ * @param[in] size
+ *   a power of 2 up to FFT_SIZE_MAX
+ *
+ ******************************************************************************/
+void fft_hann_q15(int16_t *samples, uint32_t size) {
+	uint32_t step = FFT_SIZE_MAX / size;
+	int32_t w;
+
+	for(uint32_t n = 0; n < size; n++) {
+		w = (32768 - fft_cos_q15(n * step)) >> 1;
+		samples[n] = (int16_t) ((samples[n] * w) >> 15);
+	}
+}
+
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Swaps every bin with the one at its base-4 digit reversed index
+ *
+ ******************************************************************************/
+void fft_digit_reverse(int16_t *data, uint32_t size) {
+	uint32_t rev;
+	uint32_t digits;
+	int16_t t;
+
+	for(uint32_t i = 0; i < size; i++) {
+		rev = 0;
+		for(digits = 1; digits < size; digits <<= 2) {
+			rev = (rev << 2) | ((i / digits) & 3);
+		}
+		if(rev > i) {
+			t = data[2 * i];
+			data[2 * i] = data[2 * rev];
+			data[2 * rev] = t;
+			t = data[2 * i + 1];
+			data[2 * i + 1] = data[2 * rev + 1];
+			data[2 * rev + 1] = t;
+		}
+	}
+}
@@ -0,0 +1,434 @@
+/**
+ * @file
+ * 	filter.c
+ * @author
+ * 	Adam Chehadi
+ * @date
+ * 	05/21/2021
+ * @brief
+ *	Contains the fixed point smoothing filters of the sensor streams, EMA, boxcar and
+ *	3/5-tap median, with the Cortex-M4 packed SIMD instructions on the target
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "filter.h"
+#include "em_core.h"
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+// Window history followed by the chunk, one spare sample for the second lane of the last pair
+static int16_t		work[FILTER_TAPS_MAX - 1 + FILTER_CHUNK + 1];
+
+
+//***********************************************************************************
+// Private function prototypes
+//***********************************************************************************
+static void filter_ema_chunk(FILTER *filter, const int16_t *in, int16_t *out, uint32_t count);
+static void filter_boxcar_chunk(const FILTER *filter, int16_t *out, uint32_t count);
+static void filter_median_chunk(const FILTER *filter, int16_t *out, uint32_t count);
+
+
+//***********************************************************************************
+// Packed 16-bit lanes, the DSP extension on the target and the same arithmetic in C
+// on a core or host without it
+//***********************************************************************************
+static inline uint32_t filter_pair(const int16_t *p) {
+	uint32_t pair;
+	memcpy(&pair, p, sizeof(pair));		// one unaligned LDR on the M4
+	return pair;
+}
+
+static inline int16_t filter_lo(uint32_t pair) {
+	return (int16_t) (pair & 0xFFFF);
+}
+
+static inline int16_t filter_hi(uint32_t pair) {
+	return (int16_t) (pair >> 16);
+}
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+
+static inline int32_t filter_smlad(uint32_t x, uint32_t y, int32_t acc) {
+	return (int32_t) __SMLAD(x, y, (uint32_t) acc);
+}
+
+// SSUB16 sets the GE flag of every lane where x >= y and SEL picks lanes by them
+static inline uint32_t filter_min2(uint32_t x, uint32_t y) {
+	(void) __SSUB16(x, y);
+	return __SEL(y, x);
+}
+
+static inline uint32_t filter_max2(uint32_t x, uint32_t y) {
+	(void) __SSUB16(x, y);
+	return __SEL(x, y);
+}
+
+#else
+
+static inline uint32_t filter_pack(int32_t lo, int32_t hi) {
+	return ((uint32_t) (uint16_t) lo) | ((uint32_t) (uint16_t) hi << 16);
+}
+
+static inline int32_t filter_smlad(uint32_t x, uint32_t y, int32_t acc) {
+	return acc + filter_lo(x) * filter_lo(y) + filter_hi(x) * filter_hi(y);
+}
+
+static inline uint32_t filter_min2(uint32_t x, uint32_t y) {
+	return filter_pack(filter_lo(x) < filter_lo(y) ? filter_lo(x) : filter_lo(y),
+			filter_hi(x) < filter_hi(y) ? filter_hi(x) : filter_hi(y));
+}
+
+static inline uint32_t filter_max2(uint32_t x, uint32_t y) {
+	return filter_pack(filter_lo(x) > filter_lo(y) ? filter_lo(x) : filter_lo(y),
+			filter_hi(x) > filter_hi(y) ? filter_hi(x) : filter_hi(y));
+}
+
+#endif
+
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Initializes a filter
+ *
+ * @details
+ * 	 The first sample through the filter fills its history, so the output starts at
+ * 	 the first reading instead of ramping up from 0.
+ *
+ * @param[in] filter
+ *   filter state
+ *
+ * @param[in] type
+ *   FilterXxx
+ *
+ * @param[in] param
+ *   EMA weight of the new sample in Q15, 1 to FILTER_EMA_ONE, or boxcar window
+ *   length, 2 to FILTER_TAPS_MAX, ignored by the other filters
+ *
+ ******************************************************************************/
+void filter_init(FILTER *filter, FILTER_TYPE type, uint32_t param) {
+	EFM_ASSERT(type < FilterTypes);
+
+	filter->type = type;
+	filter->taps = 1;
+	filter->alpha = FILTER_EMA_ONE;
+	filter->primed = false;
+
+	switch(type) {
+		case FilterEma:
+			EFM_ASSERT(param >= 1 && param <= FILTER_EMA_ONE);
+			filter->alpha = param;
+			break;
+		case FilterBoxcar:
+			EFM_ASSERT(param >= 2 && param <= FILTER_TAPS_MAX);
+			filter->taps = param;
+			break;
+		case FilterMedian3:
+			filter->taps = 3;
+			break;
+		case FilterMedian5:
+			filter->taps = 5;
+			break;
+		default:
+			break;
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Filters a batch of samples of one stream
+ *
+ * @details
+ * 	 Output n is the filter over the window ending at input n, the history carries
+ * 	 over from the previous batch, so a stream gives the same output however it is
+ * 	 split into batches.  The windowed filters copy the history and up to
+ * 	 FILTER_CHUNK samples into one work buffer and produce two outputs per step, one
+ * 	 per 16-bit lane.
+ *
+ * @note
+ *   in and out may be the same buffer.
+ *
+ * @param[in] filter
+ *   filter state
+ *
+ * @param[in] in
+ *   count input samples
+ *
+ * @param[out] out
+ *   count filtered samples
+ *
+ * @param[in] count
+ *   samples in the batch
+ *
+ ******************************************************************************/
+void filter_batch(FILTER *filter, const int16_t *in, int16_t *out, uint32_t count) {
+	uint32_t keep = filter->taps - 1;
+	uint32_t chunk;
+
+	if(!count) {
+		return;
+	}
+	if(!filter->primed) {
+		for(uint32_t i = 0; i < keep; i++) {
+			filter->hist[i] = in[0];
+		}
+		filter->ema = (int32_t) in[0] * 256;
+		filter->primed = true;
+	}
+
+	if(filter->type == FilterNone) {
+		memmove(out, in, count * sizeof(int16_t));
+		return;
+	}
+	if(filter->type == FilterEma) {
+		filter_ema_chunk(filter, in, out, count);
+		return;
+	}
+
+	while(count) {
+		chunk = count < FILTER_CHUNK ? count : FILTER_CHUNK;
+
+		memcpy(work, filter->hist, keep * sizeof(int16_t));
+		memcpy(&work[keep], in, chunk * sizeof(int16_t));
+		work[keep + chunk] = work[keep + chunk - 1];
+		memcpy(filter->hist, &work[chunk], keep * sizeof(int16_t));
+
+		if(filter->type == FilterBoxcar) {
+			filter_boxcar_chunk(filter, out, chunk);
+		} else {
+			filter_median_chunk(filter, out, chunk);
+		}
+
+		in += chunk;
+		out += chunk;
+		count -= chunk;
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Filters one sample
+ *
+ * @return
+ *   the filtered sample
+ *
+ ******************************************************************************/
+int16_t filter_step(FILTER *filter, int16_t in) {
+	int16_t out;
+
+	filter_batch(filter, &in, &out, 1);
+	return out;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Measures the cost of a filter with the DWT cycle counter
+ *
+ * @details
+ * 	 Filters one FILTER_BENCH_SAMPLES batch of a noisy humidity trace with interrupts
+ * 	 off.  The batch call overhead is spread over the batch the same way it is in use.
+ *
+ * @note
+ *   Enables the DWT cycle counter and leaves it running.
+ *
+ * @param[in] type
+ *   FilterXxx
+ *
+ * @param[in] param
+ *   as for filter_init()
+ *
+ * @return
+ *   cycles per sample x100
+ *
+ ******************************************************************************/
+uint32_t filter_benchmark(FILTER_TYPE type, uint32_t param) {
+	static int16_t bench_in[FILTER_BENCH_SAMPLES];
+	static int16_t bench_out[FILTER_BENCH_SAMPLES];
+	FILTER filter;
+	uint32_t seed = 1;
+	uint32_t start;
+	uint32_t cycles;
+
+	for(uint32_t i = 0; i < FILTER_BENCH_SAMPLES; i++) {
+		seed = seed * 1664525 + 1013904223;
+		bench_in[i] = (int16_t) (450 + (int32_t) ((seed >> 24) & 0x1F) - 16);	// 45.0 +/-1.6 %RH
+	}
+	filter_init(&filter, type, param);
+	filter_step(&filter, bench_in[0]);
+
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	CORE_DECLARE_IRQ_STATE;
+	CORE_ENTER_CRITICAL();
+	start = DWT->CYCCNT;
+	filter_batch(&filter, bench_in, bench_out, FILTER_BENCH_SAMPLES);
+	cycles = DWT->CYCCNT - start;
+	CORE_EXIT_CRITICAL();
+
+	return (cycles * 100) / FILTER_BENCH_SAMPLES;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Filter test function
+ *
+ * @details
+ *   Runs a boxcar of every length over constant streams at full scale and over a
+ *   ramp across the whole int16 range, and compares every output with the rounded
+ *   mean of the window summed one sample at a time.  A constant stream must come
+ *   back unchanged.
+ *
+ * @return
+ *   returns true if every output matched
+ *
+ ******************************************************************************/
+bool filter_test(void) {
+	static const int16_t level[] = { INT16_MAX, INT16_MIN, 20000, -30000, 16384, -16385 };
+	static int16_t test_in[FILTER_TEST_SAMPLES];
+	static int16_t test_out[FILTER_TEST_SAMPLES];
+	FILTER filter;
+	int32_t sum;
+	int32_t expect;
+
+	for(uint32_t taps = 2; taps <= FILTER_TAPS_MAX; taps++) {
+		for(uint32_t i = 0; i < sizeof(level) / sizeof(level[0]); i++) {
+			for(uint32_t n = 0; n < FILTER_TEST_SAMPLES; n++) {
+				test_in[n] = level[i];
+			}
+			filter_init(&filter, FilterBoxcar, taps);
+			filter_batch(&filter, test_in, test_out, FILTER_TEST_SAMPLES);
+			for(uint32_t n = 0; n < FILTER_TEST_SAMPLES; n++) {
+				if(test_out[n] != level[i]) {
+					return false;
+				}
+			}
+		}
+
+		for(uint32_t n = 0; n < FILTER_TEST_SAMPLES; n++) {
+			test_in[n] = (int16_t) (INT16_MIN + (int32_t) n * (UINT16_MAX / (FILTER_TEST_SAMPLES - 1)));
+		}
+		filter_init(&filter, FilterBoxcar, taps);
+		filter_batch(&filter, test_in, test_out, FILTER_TEST_SAMPLES);
+		for(uint32_t n = 0; n < FILTER_TEST_SAMPLES; n++) {
+			sum = 0;
+			for(uint32_t k = 0; k < taps; k++) {
+				sum += test_in[n >= k ? n - k : 0];		// the first sample fills the history
+			}
+			expect = (sum >= 0 ? sum + (int32_t) taps / 2 : sum - (int32_t) taps / 2) / (int32_t) taps;
+			if(test_out[n] != expect) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Exponential moving average, y += alpha * (x - y)
+ *
+ * @details
+ * 	 The output is kept in Q8 so a small weight still follows a slow drift instead of
+ * 	 stalling inside a rounding dead band.  Each output depends on the one before,
+ * 	 so there are no independent lanes to pack, one multiply-accumulate per sample.
+ *
+ ******************************************************************************/
+void filter_ema_chunk(FILTER *filter, const int16_t *in, int16_t *out, uint32_t count) {
+	int32_t y = filter->ema;
+
+	for(uint32_t i = 0; i < count; i++) {
+		y += (int32_t) ((((int64_t) in[i] * 256) - y) * filter->alpha >> 15);
+		out[i] = (int16_t) ((y + 128) >> 8);
+	}
+	filter->ema = y;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Boxcar, the rounded mean of the last taps samples
+ *
+ * @details
+ * 	 SMLAD against (1, 1) adds a pair of window samples into the 32-bit sum, two taps
+ * 	 per instruction.  The taps are never added in 16 bits, so the whole int16 range
+ * 	 averages without saturating.
+ *
+ ******************************************************************************/
+void filter_boxcar_chunk(const FILTER *filter, int16_t *out, uint32_t count) {
+	const uint32_t ones = 0x00010001;
+	const int32_t taps = (int32_t) filter->taps;
+	const int16_t *w;
+	int32_t acc;
+	int32_t k;
+
+	for(uint32_t n = 0; n < count; n++) {
+		w = &work[n];
+		acc = 0;
+		for(k = 0; k + 2 <= taps; k += 2) {
+			acc = filter_smlad(filter_pair(&w[k]), ones, acc);
+		}
+		if(k < taps) {
+			acc += w[k];
+		}
+		out[n] = (int16_t) ((acc >= 0 ? acc + taps / 2 : acc - taps / 2) / taps);
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   3 or 5-tap median
+ *
+ * @details
+ * 	 Two neighbouring outputs are computed at once, the low lane of every pair holds
+ * 	 a sample of the first window and the high lane the same tap of the next one.
+ * 	 The median of three is max(min(a, b), min(max(a, b), c)).  For five, the two
+ * 	 middle values of a..d are max(min(a, b), min(c, d)) and min(max(a, b), max(c, d)),
+ * 	 and the median is the median of three of those and e.
+ *
+ ******************************************************************************/
+void filter_median_chunk(const FILTER *filter, int16_t *out, uint32_t count) {
+	uint32_t a, b, c, d, e;
+	uint32_t lo, hi, med;
+	const int16_t *w;
+
+	for(uint32_t n = 0; n < count; n += 2) {
+		w = &work[n];
+		a = filter_pair(&w[0]);
+		b = filter_pair(&w[1]);
+		c = filter_pair(&w[2]);
+
+		if(filter->taps == 5) {
+			d = filter_pair(&w[3]);
+			e = filter_pair(&w[4]);
+			lo = filter_max2(filter_min2(a, b), filter_min2(c, d));
+			hi = filter_min2(filter_max2(a, b), filter_max2(c, d));
+			a = lo;
+			b = hi;
+			c = e;
+		}
+		med = filter_max2(filter_min2(a, b), filter_min2(filter_max2(a, b), c));
+
+		out[n] = filter_lo(med);
+		if(n + 1 < count) {
+			out[n + 1] = filter_hi(med);
+		}
+	}
+}
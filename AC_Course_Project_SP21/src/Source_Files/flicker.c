@@ -0,0 +1,173 @@
+/**
+ * @file
+ * 	flicker.c
+ * @author
+ * 	Adam Chehadi
+ * @date
+ * 	05/22/2021
+ * @brief
+ *	Contains the flicker analysis of a light burst, flicker index, percent flicker
+ *	and the dominant frequency from a radix-4 FFT
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "flicker.h"
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+static int16_t		fft_buf[2 * FLICKER_SAMPLES_MAX];		// complex, interleaved
+
+
+//***********************************************************************************
+// Private function prototypes
+//***********************************************************************************
+static void flicker_spectrum(const uint16_t *counts, uint32_t samples, uint32_t period_ms, FLICKER_RESULT *result);
+
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Analyzes a burst of light readings taken at a fixed period
+ *
+ * @details
+ * 	 Flicker index and percent flicker are the IES metrics over the whole burst.  The
+ * 	 dominant frequency is the strongest bin of the Hann windowed spectrum of the
+ * 	 burst with its mean removed, only frequencies below period_ms / 2 can show.
+ *
+ * @param[in] counts
+ *   raw readings, oldest first
+ *
+ * @param[in] samples
+ *   16, 64 or 256
+ *
+ * @param[in] period_ms
+ *   time between readings
+ *
+ * @param[out] result
+ *   the summary
+ *
+ ******************************************************************************/
+void flicker_analyze(const uint16_t *counts, uint32_t samples, uint32_t period_ms, FLICKER_RESULT *result) {
+	uint64_t sum = 0;
+	uint64_t above = 0;
+	int64_t excess;
+
+	EFM_ASSERT(samples >= FLICKER_SAMPLES_MIN && samples <= FLICKER_SAMPLES_MAX);
+
+	result->samples = samples;
+	result->period_ms = period_ms;
+	result->min = UINT16_MAX;
+	result->max = 0;
+
+	for(uint32_t n = 0; n < samples; n++) {
+		sum += counts[n];
+		if(counts[n] < result->min) {
+			result->min = counts[n];
+		}
+		if(counts[n] > result->max) {
+			result->max = counts[n];
+		}
+	}
+	result->mean = (uint32_t) ((sum + samples / 2) / samples);
+
+	// Area above the mean, in samples x counts so the mean is not rounded
+	for(uint32_t n = 0; n < samples; n++) {
+		excess = (int64_t) counts[n] * samples - (int64_t) sum;
+		if(excess > 0) {
+			above += (uint64_t) excess;
+		}
+	}
+	result->flicker_index = sum ? (uint32_t) ((above * 1000) / (sum * samples)) : 0;
+	result->percent_flicker = result->max + result->min ?
+			(1000 * (result->max - result->min)) / (result->max + result->min) : 0;
+
+	flicker_spectrum(counts, samples, period_ms, result);
+}
+
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Finds the dominant frequency of a burst
+ *
+ * @details
+ * 	 The readings less their mean are scaled up or down to fill about half of Q15,
+ * 	 the FFT scales by 1 / samples on its own.  The Hann main lobe is three bins
+ * 	 wide, so the share of the peak counts the bins either side of it.
+ *
+ ******************************************************************************/
+void flicker_spectrum(const uint16_t *counts, uint32_t samples, uint32_t period_ms, FLICKER_RESULT *result) {
+	int32_t dev;
+	uint32_t max_dev = 0;
+	int32_t shift = 0;
+	uint32_t power;
+	uint32_t peak_power = 0;
+	uint32_t peak = 0;
+	uint64_t total = 0;
+	uint64_t lobe = 0;
+
+	result->bin_mhz = 1000000 / (samples * period_ms);
+	result->peak_mhz = 0;
+	result->peak_share_pct = 0;
+
+	for(uint32_t n = 0; n < samples; n++) {
+		dev = (int32_t) counts[n] - (int32_t) result->mean;
+		if((uint32_t) (dev < 0 ? -dev : dev) > max_dev) {
+			max_dev = dev < 0 ? -dev : dev;
+		}
+	}
+	if(!max_dev) {
+		return;
+	}
+	if(max_dev > 16383) {
+		while((max_dev >> -shift) > 16383) {
+			shift--;
+		}
+	} else {
+		while((max_dev << (shift + 1)) <= 16383 && shift < 14) {
+			shift++;
+		}
+	}
+
+	// Real samples packed at the front, windowed, then spread out to complex from the end
+	for(uint32_t n = 0; n < samples; n++) {
+		dev = (int32_t) counts[n] - (int32_t) result->mean;
+		fft_buf[n] = (int16_t) (shift >= 0 ? dev * (1 << shift) : dev / (1 << -shift));
+	}
+	fft_hann_q15(fft_buf, samples);
+	for(uint32_t n = samples; n-- > 0;) {
+		fft_buf[2 * n] = fft_buf[n];
+		fft_buf[2 * n + 1] = 0;
+	}
+	fft_radix4_q15(fft_buf, samples);
+
+	for(uint32_t k = 1; k <= samples / 2; k++) {
+		power = (uint32_t) (fft_buf[2 * k] * fft_buf[2 * k]) + (uint32_t) (fft_buf[2 * k + 1] * fft_buf[2 * k + 1]);
+		total += power;
+		if(power > peak_power) {
+			peak_power = power;
+			peak = k;
+		}
+	}
+	if(!total) {
+		return;
+	}
+
+	for(uint32_t k = peak - 1; k <= peak + 1 && k <= samples / 2; k++) {
+		if(k >= 1) {
+			lobe += (uint32_t) (fft_buf[2 * k] * fft_buf[2 * k]) + (uint32_t) (fft_buf[2 * k + 1] * fft_buf[2 * k + 1]);
+		}
+	}
+	result->peak_mhz = (peak * 1000000) / (samples * period_ms);
+	result->peak_share_pct = (uint32_t) ((lobe * 100) / total);
+}
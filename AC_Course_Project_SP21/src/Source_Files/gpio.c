@@ -23,11 +23,13 @@
 //***********************************************************************************
 // Private variables
 //***********************************************************************************
+static uint32_t		gpio_irq_cb[GPIO_NUM_EXT_INT];
 
 
 //***********************************************************************************
 // Private functions
 //***********************************************************************************
+static void gpio_irq_dispatch(uint32_t int_flag);
 
 
 //***********************************************************************************
@@ -69,11 +71,115 @@ void gpio_open(void){
 	// Configure I2C pins
 	GPIO_PinModeSet(VEML_SCL_PORT, VEML_SCL_PIN, VEML_SENSOR_GPIOMODE, VEML_I2C_DEFAULT);
 	GPIO_PinModeSet(VEML_SDA_PORT, VEML_SDA_PIN, VEML_SENSOR_GPIOMODE, VEML_I2C_DEFAULT);
+	GPIO_PinModeSet(VEML_INT_PORT, VEML_INT_PIN, VEML_INT_GPIOMODE, VEML_INT_DEFAULT);
 
 
 	// Configure UART pins
 	GPIO_DriveStrengthSet(LEUART0_TX_PORT, LEUART0_DRIVE_STRENGTH);
 	GPIO_PinModeSet(LEUART0_TX_PORT, LEUART0_TX_PIN, LEUART0_TX_GPIOMODE, LEUART0_TX_DEFAULT);
+	GPIO_PinModeSet(BLE_STATE_PORT, BLE_STATE_PIN, BLE_STATE_GPIOMODE, BLE_STATE_DEFAULT);
 
 	GPIO_PinModeSet(LEUART0_RX_PORT, LEUART0_RX_PIN, LEUART0_RX_GPIOMODE, LEUART0_RX_DEFAULT);
 }
+
+
+/***************************************************************************//**
+ * @brief
+ *   Opens an external pin interrupt
+ *
+ * @details
+ * 	 Uses the external interrupt with the same number as the pin and raises irq_cb through
+ * 	 the scheduler on the selected edges.  GPIO edge interrupts are asynchronous, so they
+ * 	 wake the board from EM2 and EM3.
+ *
+ * @note
+ *   The pin has to be configured as an input first.  Only one port can own each pin number.
+ *
+ * @param[in] port
+ *   GPIO port of the pin
+ *
+ * @param[in] pin
+ *   pin number, also the external interrupt number
+ *
+ * @param[in] rising
+ *   interrupt on the rising edge
+ *
+ * @param[in] falling
+ *   interrupt on the falling edge
+ *
+ * @param[in] irq_cb
+ *   scheduler event raised on an edge
+ *
+ ******************************************************************************/
+void gpio_irq_open(GPIO_Port_TypeDef port, uint32_t pin, bool rising, bool falling, uint32_t irq_cb){
+	EFM_ASSERT(pin < GPIO_NUM_EXT_INT);
+
+	gpio_irq_cb[pin] = irq_cb;
+	GPIO_ExtIntConfig(port, pin, pin, rising, falling, true);
+	GPIO_IntClear(1 << pin);
+
+	if(pin & 1) {
+		NVIC_EnableIRQ(GPIO_ODD_IRQn);
+	} else {
+		NVIC_EnableIRQ(GPIO_EVEN_IRQn);
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Closes an external pin interrupt
+ *
+ * @param[in] pin
+ *   pin number passed to gpio_irq_open()
+ *
+ ******************************************************************************/
+void gpio_irq_close(uint32_t pin){
+	EFM_ASSERT(pin < GPIO_NUM_EXT_INT);
+
+	GPIO_IntDisable(1 << pin);
+	GPIO_IntClear(1 << pin);
+	gpio_irq_cb[pin] = 0;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   GPIO even pin Interrupt Service Routine
+ *
+ ******************************************************************************/
+void GPIO_EVEN_IRQHandler(void){
+	uint32_t int_flag;
+	int_flag = GPIO->IF & GPIO->IEN & 0x5555;
+	GPIO->IFC = int_flag;
+
+	gpio_irq_dispatch(int_flag);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   GPIO odd pin Interrupt Service Routine
+ *
+ ******************************************************************************/
+void GPIO_ODD_IRQHandler(void){
+	uint32_t int_flag;
+	int_flag = GPIO->IF & GPIO->IEN & 0xAAAA;
+	GPIO->IFC = int_flag;
+
+	gpio_irq_dispatch(int_flag);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Raises the scheduler event of every external interrupt in int_flag
+ *
+ ******************************************************************************/
+void gpio_irq_dispatch(uint32_t int_flag){
+	for(uint32_t pin = 0; pin < GPIO_NUM_EXT_INT; pin++) {
+		if((int_flag & (1 << pin)) && gpio_irq_cb[pin]) {
+			add_scheduled_event(gpio_irq_cb[pin]);
+		}
+	}
+}
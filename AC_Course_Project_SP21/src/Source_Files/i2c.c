@@ -30,11 +30,17 @@ typedef enum {
 static I2C_STATE_MACHINE	i2c_state_machine_struct;
 static I2C_STATE_MACHINE	veml_i2c_state_machine_struct;
 
+static const uint8_t		i2c_cmd_start = I2C_CMD_START;
+static LDMA_Descriptor_t	i2c0_trigger_chain[2];
+static LDMA_Descriptor_t	i2c1_trigger_chain[2];
+
 
 //***********************************************************************************
 // Private function prototypes
 //***********************************************************************************
 static void i2c_bus_reset(I2C_TypeDef * i2c);
+static I2C_STATE_MACHINE *i2c_state_setup(I2C_TypeDef *i2cx, uint32_t slave_address, uint32_t slave_register, bool read_write, uint32_t *data, uint32_t si_read_cb, uint32_t num_bytes);
+static void i2c_launch(I2C_STATE_MACHINE *i2c_sm);
 
 static void i2c_ack(I2C_STATE_MACHINE *i2c_sm);
 static void i2c_nack(I2C_STATE_MACHINE *i2c_sm);
@@ -54,41 +60,140 @@ static void i2c_mstop(I2C_STATE_MACHINE *i2c_sm);
  * 	 Initializes a private struct in i2c that will keep state of the progress of the I2C operation. This state information
  *   will be stored in a static struct in i2c.c of type I2C_STATE_MACHINE.
  *
+ *   A slave_register of I2C_NO_REGISTER reads straight from the device, polling it with the NACK retry of Wait_Read
+ *   until it has data, and a write of I2C_BYTES_0 sends the command byte alone.  Together they let a conversion be
+ *   started in one transaction and its result fetched in a later one.
+ *
  * @note
- *   This function does not have any return values.
+ *   This function does not have any return values.  A si_read_cb of 0 completes without raising an event.
  *
  ******************************************************************************/
 void i2c_start(I2C_TypeDef *i2cx, uint32_t slave_address, uint32_t slave_register, bool read_write, uint32_t *data, uint32_t si_read_cb, uint32_t num_bytes) {
-	EFM_ASSERT((I2C0->STATE & _I2C_STATE_STATE_MASK) == I2C_STATE_STATE_IDLE);
+	I2C_STATE_MACHINE *i2c_sm;
+
+	EFM_ASSERT((i2cx->STATE & _I2C_STATE_STATE_MASK) == I2C_STATE_STATE_IDLE);
 	sleep_block_mode(I2C_EM_BLOCK);
 
+	i2c_sm = i2c_state_setup(i2cx, slave_address, slave_register, read_write, data, si_read_cb, num_bytes);
+	i2c_launch(i2c_sm);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Start an I2C read into a sample record
+ *
+ * @details
+ * 	 Same as an i2c_start() read, but the data is assembled in the staged slot of the record and published
+ * 	 from the stop interrupt, before read_cb is raised.  Readers of the record see either the previous reading
+ * 	 or the new one, never a reading that is half received.
+ *
+ * @note
+ *   This function does not have any return values.
+ *
+ ******************************************************************************/
+void i2c_read_record(I2C_TypeDef *i2cx, uint32_t slave_address, uint32_t slave_register, SAMPLE_RECORD *record, uint32_t read_cb, uint32_t num_bytes) {
+	I2C_STATE_MACHINE *i2c_sm;
+
+	EFM_ASSERT((i2cx->STATE & _I2C_STATE_STATE_MASK) == I2C_STATE_STATE_IDLE);
+	sleep_block_mode(I2C_EM_BLOCK);
+
+	i2c_sm = i2c_state_setup(i2cx, slave_address, slave_register, I2C_READ, sample_store_stage(record), read_cb, num_bytes);
+	i2c_sm->record = record;
+	i2c_launch(i2c_sm);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Arm the I2C state machine for a hardware triggered start
+ *
+ * @details
+ * 	 Loads the state machine exactly like i2c_start() but does not touch the peripheral.  The START command
+ * 	 and the address byte are written by the LDMA channel set up with i2c_hw_trigger_open() when the trigger
+ * 	 fires, and the ACK interrupt of the address byte picks the transaction up from there.
+ *
+ * @note
+ *   The I2C is clocked from the HF domain, so the armed bus blocks I2C_EM_BLOCK until the transaction stops.
+ *
+ ******************************************************************************/
+void i2c_arm(I2C_TypeDef *i2cx, uint32_t slave_address, uint32_t slave_register, bool read_write, uint32_t *data, uint32_t si_read_cb, uint32_t num_bytes) {
+	EFM_ASSERT((i2cx->STATE & _I2C_STATE_STATE_MASK) == I2C_STATE_STATE_IDLE);
+	EFM_ASSERT(slave_register != I2C_NO_REGISTER);
+	sleep_block_mode(I2C_EM_BLOCK);
+
+	i2c_state_setup(i2cx, slave_address, slave_register, read_write, data, si_read_cb, num_bytes);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Arm a hardware triggered I2C read into a sample record
+ *
+ * @details
+ * 	 The i2c_arm() counterpart of i2c_read_record().
+ *
+ ******************************************************************************/
+void i2c_arm_record(I2C_TypeDef *i2cx, uint32_t slave_address, uint32_t slave_register, SAMPLE_RECORD *record, uint32_t read_cb, uint32_t num_bytes) {
+	I2C_STATE_MACHINE *i2c_sm;
+
+	EFM_ASSERT((i2cx->STATE & _I2C_STATE_STATE_MASK) == I2C_STATE_STATE_IDLE);
+	EFM_ASSERT(slave_register != I2C_NO_REGISTER);
+	sleep_block_mode(I2C_EM_BLOCK);
+
+	i2c_sm = i2c_state_setup(i2cx, slave_address, slave_register, I2C_READ, sample_store_stage(record), read_cb, num_bytes);
+	i2c_sm->record = record;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Set up the LDMA channel that starts an armed I2C transaction from hardware
+ *
+ * @details
+ * 	 Loads a looping two descriptor chain on the LDMA channel.  The first descriptor waits for ldma_signal and
+ * 	 then writes the START command, the second writes the slave address with the write bit and links back to
+ * 	 the first.  With ldma_signal driven by the PRS from the LETIMER, every sample period starts the armed
+ * 	 transaction without an LETIMER interrupt, a pass through the scheduler or a software i2c_start().
+ *
+ * @note
+ *   No LDMA interrupt is raised, the I2C ACK interrupt is the first CPU wake of the transaction.
+ *
+ * @param[in] i2cx
+ *   I2C0 or I2C1
+ *
+ * @param[in] ldma_ch
+ *   LDMA channel reserved for this bus in ldma.h
+ *
+ * @param[in] ldma_signal
+ *   LDMA request that triggers the start, e.g. ldmaPeripheralSignal_PRS_REQ0
+ *
+ * @param[in] slave_address
+ *   7-bit address of the device the armed transactions are sent to
+ *
+ ******************************************************************************/
+void i2c_hw_trigger_open(I2C_TypeDef *i2cx, uint32_t ldma_ch, uint32_t ldma_signal, uint32_t slave_address) {
+	LDMA_TransferCfg_t trigger_cfg = LDMA_TRANSFER_CFG_PERIPHERAL(ldma_signal);
+	LDMA_Descriptor_t start_desc = LDMA_DESCRIPTOR_LINKREL_M2P_BYTE(&i2c_cmd_start, &i2cx->CMD, 1, 1);
+	LDMA_Descriptor_t addr_desc = LDMA_DESCRIPTOR_LINKREL_WRITE((slave_address << 1) | I2C_WRITE, &i2cx->TXDATA, -1);
+	LDMA_Descriptor_t *chain;
+
 	if(i2cx == I2C0) {
-		veml_i2c_state_machine_struct.I2Cx = i2cx;
-		veml_i2c_state_machine_struct.slave_address = slave_address;
-		veml_i2c_state_machine_struct.slave_register = slave_register;
-		veml_i2c_state_machine_struct.read_write = read_write;
-		veml_i2c_state_machine_struct.num_transfer_bytes = num_bytes;
-		veml_i2c_state_machine_struct.bytes_transfered = 0;
-		veml_i2c_state_machine_struct.data = data;
-		veml_i2c_state_machine_struct.si_cb = si_read_cb;
-		veml_i2c_state_machine_struct.i2c_busy = true;
-		veml_i2c_state_machine_struct.current_state = Start_Command;
-		veml_i2c_state_machine_struct.I2Cx->CMD = I2C_CMD_START;
-		veml_i2c_state_machine_struct.I2Cx->TXDATA = (veml_i2c_state_machine_struct.slave_address << 1) | I2C_WRITE;
+		chain = i2c0_trigger_chain;
+	} else if(i2cx == I2C1) {
+		chain = i2c1_trigger_chain;
 	} else {
-		i2c_state_machine_struct.I2Cx = i2cx;
-		i2c_state_machine_struct.slave_address = slave_address;
-		i2c_state_machine_struct.slave_register = slave_register;
-		i2c_state_machine_struct.read_write = read_write;
-		i2c_state_machine_struct.num_transfer_bytes = num_bytes;
-		i2c_state_machine_struct.bytes_transfered = 0;
-		i2c_state_machine_struct.data = data;
-		i2c_state_machine_struct.si_cb = si_read_cb;
-		i2c_state_machine_struct.i2c_busy = true;
-		i2c_state_machine_struct.current_state = Start_Command;
-		i2c_state_machine_struct.I2Cx->CMD = I2C_CMD_START;
-		i2c_state_machine_struct.I2Cx->TXDATA = (i2c_state_machine_struct.slave_address << 1) | I2C_WRITE;
+		EFM_ASSERT(false);
+		return;
 	}
+
+	start_desc.xfer.doneIfs = false;
+	chain[0] = start_desc;
+	chain[1] = addr_desc;
+
+	ldma_open();
+	ldma_channel_open(ldma_ch, 0);
+	LDMA_StartTransfer(ldma_ch, &trigger_cfg, &chain[0]);
 }
 
 
@@ -111,6 +216,8 @@ bool check_busy(I2C_TypeDef * i2c) {
 	}
 	else if(i2c == veml_i2c_state_machine_struct.I2Cx) {
 		return veml_i2c_state_machine_struct.i2c_busy;
+	} else if(i2c == I2C0 || i2c == I2C1) {
+		return false;		// no transaction started on this bus yet
 	} else {
 		return true;
 	}
@@ -274,6 +381,68 @@ void i2c_open(I2C_TypeDef * i2c, I2C_OPEN_STRUCT * i2c_setup) {
 // Private functions
 //***********************************************************************************
 
+/***************************************************************************//**
+ * @brief
+ *   I2C state machine setup function
+ *
+ * @details
+ * 	 Selects the state machine of the bus and loads it with the parameters of the next transaction, leaving it
+ * 	 waiting for the ACK of the address byte.  That is Start_Command, or Wait_Read for an I2C_NO_REGISTER read.
+ *
+ * @return
+ *   The state machine of the bus.
+ *
+ ******************************************************************************/
+I2C_STATE_MACHINE *i2c_state_setup(I2C_TypeDef *i2cx, uint32_t slave_address, uint32_t slave_register, bool read_write, uint32_t *data, uint32_t si_read_cb, uint32_t num_bytes) {
+	I2C_STATE_MACHINE *i2c_sm;
+
+	if(i2cx == I2C0) {
+		i2c_sm = &veml_i2c_state_machine_struct;
+	} else {
+		i2c_sm = &i2c_state_machine_struct;
+	}
+
+	i2c_sm->I2Cx = i2cx;
+	i2c_sm->slave_address = slave_address;
+	i2c_sm->slave_register = slave_register;
+	i2c_sm->read_write = read_write;
+	i2c_sm->num_transfer_bytes = num_bytes;
+	i2c_sm->bytes_transfered = 0;
+	i2c_sm->data = data;
+	i2c_sm->record = 0;
+	i2c_sm->si_cb = si_read_cb;
+	i2c_sm->i2c_busy = true;
+
+	if(slave_register == I2C_NO_REGISTER) {
+		EFM_ASSERT(read_write == I2C_READ);
+		i2c_sm->current_state = Wait_Read;
+	} else {
+		i2c_sm->current_state = Start_Command;
+	}
+
+	return i2c_sm;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   I2C launch function
+ *
+ * @details
+ * 	 Sends the START and the address byte of the transaction loaded into the state machine, with the read bit
+ * 	 when it starts in Wait_Read.
+ *
+ ******************************************************************************/
+void i2c_launch(I2C_STATE_MACHINE *i2c_sm) {
+	i2c_sm->I2Cx->CMD = I2C_CMD_START;
+	if(i2c_sm->current_state == Wait_Read) {
+		i2c_sm->I2Cx->TXDATA = (i2c_sm->slave_address << 1) | I2C_READ;
+	} else {
+		i2c_sm->I2Cx->TXDATA = (i2c_sm->slave_address << 1) | I2C_WRITE;
+	}
+}
+
+
 /***************************************************************************//**
  * @brief
  *   I2C bus reset function
@@ -332,7 +501,11 @@ void i2c_ack(I2C_STATE_MACHINE * i2c_sm) {
 			i2c_sm->I2Cx->TXDATA = ((i2c_sm->slave_address << 1) | I2C_READ); //from J
 			break;
 		case Write_Command:
-			if(i2c_sm->num_transfer_bytes == 1) {
+			if(i2c_sm->num_transfer_bytes == 0) {
+				i2c_sm->current_state = Stop;
+				i2c_sm->I2Cx->CMD = I2C_CMD_STOP;
+			}
+			else if(i2c_sm->num_transfer_bytes == 1) {
 				i2c_sm->current_state = End_Sensing;
 				i2c_sm->I2Cx->TXDATA = *(i2c_sm->data);
 			}
@@ -343,7 +516,7 @@ void i2c_ack(I2C_STATE_MACHINE * i2c_sm) {
 				}
 				else if(i2c_sm->bytes_transfered == 1) {
 					i2c_sm->current_state = End_Sensing;
-					i2c_sm->I2Cx->TXDATA |= *(i2c_sm->data) << (8 * i2c_sm->num_transfer_bytes-1);
+					i2c_sm->I2Cx->TXDATA = (*(i2c_sm->data) >> 8) & 0xFF;
 				}
 			}
 			break;
@@ -488,7 +661,12 @@ void i2c_mstop(I2C_STATE_MACHINE * i2c_sm) {
 			break;
 		case Stop:
 			sleep_unblock_mode(I2C_EM_BLOCK);
-			add_scheduled_event(i2c_sm->si_cb);
+			if(i2c_sm->record) {
+				sample_store_publish(i2c_sm->record);
+			}
+			if(i2c_sm->si_cb) {
+				add_scheduled_event(i2c_sm->si_cb);
+			}
 			i2c_sm->current_state = Start_Command;
 			i2c_sm->i2c_busy = false;
 			break;
@@ -0,0 +1,421 @@
+/**
+ * @file
+ * 	journal.c
+ * @author
+ * 	Adam Chehadi
+ * @date
+ * 	05/18/2021
+ * @brief
+ *	Contains the append-only sample journal kept in a ring of flash pages
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "journal.h"
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+// Records of the head page are collected here and programmed a batch at a time
+static JOURNAL_PAGE		journal_buf;
+static uint32_t			head_seq;			// sequence number of the page being filled
+static uint32_t			head_count;			// records in the head page, flash and buffer
+static uint32_t			head_written;		// records of the head page already in flash
+static bool				head_ready;			// head page erased and its header programmed
+static uint8_t			journal_boot;
+static JOURNAL_STATS	stats;
+static bool				journal_opened = false;
+
+
+//***********************************************************************************
+// Private function prototypes
+//***********************************************************************************
+static JOURNAL_PAGE *journal_page(uint32_t index);
+static bool journal_hdr_valid(uint32_t index, uint32_t *seq);
+static bool journal_rec_erased(const JOURNAL_RECORD *record);
+static uint16_t journal_check(const JOURNAL_RECORD *record);
+static void journal_program(void *dest, const void *src, uint32_t num_bytes);
+static void journal_advance(void);
+
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Journal open function
+ *
+ * @details
+ * 	 Mounts the journal without scanning it.  Pages are filled in ring order and each
+ * 	 carries its sequence number, so over the ring the pages of the current lap come
+ * 	 first with increasing numbers and the pages left from the previous lap follow.
+ * 	 "valid and not older than page 0" is true up to the head page and false after it,
+ * 	 and a binary search finds the head in log2(JOURNAL_PAGES) header reads.  Records
+ * 	 are programmed in order from the start of a page, so a second binary search over
+ * 	 erased records finds the end of the head page.
+ *
+ * 	 The boot count of this boot is one more than the newest record that passes its
+ * 	 check, usually the last one.
+ *
+ * @note
+ *   A reset while page 0 was being erased at the end of a lap leaves page 0 invalid
+ *   and the last page as the head, which is handled before the search.
+ *
+ ******************************************************************************/
+void journal_open(void) {
+	uint32_t seq0;
+	uint32_t seq;
+	uint32_t lo;
+	uint32_t hi;
+	uint32_t mid;
+	uint32_t head;
+	uint64_t start = timebase_ticks();
+	JOURNAL_PAGE *page;
+	JOURNAL_RECORD last;
+
+	EFM_ASSERT(sizeof(JOURNAL_PAGE) <= JOURNAL_PAGE_SIZE);
+	EFM_ASSERT(sizeof(JOURNAL_RECORD) == 16);
+
+	MSC_Init();
+	stats.mount_probes = 0;
+	journal_boot = 0;
+
+	if(journal_hdr_valid(0, &seq0)) {
+		lo = 0;
+		hi = JOURNAL_PAGES - 1;
+		while(lo < hi) {
+			mid = (lo + hi + 1) / 2;
+			if(journal_hdr_valid(mid, &seq) && seq >= seq0) {
+				lo = mid;
+			} else {
+				hi = mid - 1;
+			}
+		}
+		head = lo;
+		journal_hdr_valid(head, &head_seq);
+	} else if(journal_hdr_valid(JOURNAL_PAGES - 1, &seq)) {
+		head = JOURNAL_PAGES - 1;
+		head_seq = seq;
+	} else {
+		head = 0;
+		head_seq = 0;
+		head_count = 0;
+		head_written = 0;
+		head_ready = false;
+		journal_opened = true;
+		stats.mount_ms = TIMEBASE_TICKS_TO_MS(timebase_ticks() - start);
+		return;
+	}
+	EFM_ASSERT(head_seq % JOURNAL_PAGES == head);
+
+	page = journal_page(head);
+	lo = 0;
+	hi = JOURNAL_RECORDS_PER_PAGE;
+	while(lo < hi) {
+		mid = (lo + hi) / 2;
+		stats.mount_probes++;
+		if(journal_rec_erased(&page->rec[mid])) {
+			hi = mid;
+		} else {
+			lo = mid + 1;
+		}
+	}
+	head_count = lo;
+	head_written = lo;
+	head_ready = true;
+	journal_opened = true;
+
+	// The boot count follows the newest record that passes its check, a reset while it
+	// was being programmed leaves the last one torn
+	for(uint32_t number = journal_next(); number > journal_first(); number--) {
+		stats.mount_probes++;
+		if(journal_read(number - 1, &last)) {
+			journal_boot = last.boot + 1;
+			break;
+		}
+	}
+
+	if(head_count == JOURNAL_RECORDS_PER_PAGE) {
+		journal_advance();
+	}
+	stats.mount_ms = TIMEBASE_TICKS_TO_MS(timebase_ticks() - start);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Appends a sample record to the journal
+ *
+ * @details
+ * 	 The record is stamped with the boot count and its check word and collected in RAM.
+ * 	 A full page is programmed in one write, so every flash word is programmed once per
+ * 	 erase and the only overhead on top of the records is the page header.
+ *
+ * @note
+ *   Records still in RAM are lost on a reset, journal_flush() programs them early.
+ *
+ * @param[in] record
+ *   sample to append, its boot and check fields are filled in
+ *
+ ******************************************************************************/
+void journal_append(JOURNAL_RECORD *record) {
+	EFM_ASSERT(journal_opened);
+
+	record->boot = journal_boot;
+	record->check = journal_check(record);
+	journal_buf.rec[head_count++] = *record;
+	stats.records++;
+
+	if(head_count == JOURNAL_RECORDS_PER_PAGE) {
+		journal_flush();
+		journal_advance();
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Programs the records collected in RAM
+ *
+ * @details
+ * 	 The head page is erased, taking the oldest page of the ring, the first time any of
+ * 	 its records are programmed.  Later batches go to the erased words after the ones
+ * 	 already programmed, so a page is never erased twice per lap.
+ *
+ * @note
+ *   The CPU stalls while the flash is programmed, about 20 ms for a page erase and
+ *   10 ms for a full page of records.
+ *
+ ******************************************************************************/
+void journal_flush(void) {
+	JOURNAL_PAGE *page = journal_page(head_seq % JOURNAL_PAGES);
+	MSC_Status_TypeDef status;
+
+	EFM_ASSERT(journal_opened);
+
+	if(head_count == head_written) {
+		return;
+	}
+
+	if(!head_ready) {
+		status = MSC_ErasePage((uint32_t *) page);
+		EFM_ASSERT(status == mscReturnOk);
+		stats.pages_erased++;
+
+		journal_buf.hdr.magic = JOURNAL_MAGIC;
+		journal_buf.hdr.seq = head_seq;
+		journal_buf.hdr.seq_inv = ~head_seq;
+		journal_buf.hdr.reserved = 0xFFFFFFFF;
+		journal_program(&page->hdr, &journal_buf.hdr, sizeof(JOURNAL_PAGE_HDR));
+		head_ready = true;
+	}
+
+	journal_program(&page->rec[head_written], &journal_buf.rec[head_written],
+			(head_count - head_written) * sizeof(JOURNAL_RECORD));
+	head_written = head_count;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the number of the oldest record in the journal
+ *
+ * @details
+ * 	 Records are numbered from the first one ever appended, record n is at index
+ * 	 n % JOURNAL_RECORDS_PER_PAGE of the page with sequence n / JOURNAL_RECORDS_PER_PAGE.
+ * 	 The page the head will erase next still holds records until it is erased, but
+ * 	 they are not counted.
+ *
+ ******************************************************************************/
+uint32_t journal_first(void) {
+	uint32_t first_seq = 0;
+
+	if(head_seq >= JOURNAL_PAGES - 1) {
+		first_seq = head_seq - (JOURNAL_PAGES - 1);
+	}
+	return first_seq * JOURNAL_RECORDS_PER_PAGE;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the number the next appended record will get
+ *
+ ******************************************************************************/
+uint32_t journal_next(void) {
+	return head_seq * JOURNAL_RECORDS_PER_PAGE + head_count;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Reads a record by number
+ *
+ * @details
+ * 	 Records not yet programmed are read from RAM.
+ *
+ * @param[in] number
+ *   record number, from journal_first() up to journal_next() - 1
+ *
+ * @param[out] record
+ *   the record when true is returned
+ *
+ * @return
+ *   false if the record is out of range or failed its check
+ *
+ ******************************************************************************/
+bool journal_read(uint32_t number, JOURNAL_RECORD *record) {
+	uint32_t seq = number / JOURNAL_RECORDS_PER_PAGE;
+	uint32_t index = number % JOURNAL_RECORDS_PER_PAGE;
+	JOURNAL_PAGE *page;
+
+	if(number < journal_first() || number >= journal_next()) {
+		return false;
+	}
+
+	if(seq == head_seq && index >= head_written) {
+		*record = journal_buf.rec[index];
+	} else {
+		page = journal_page(seq % JOURNAL_PAGES);
+		if(page->hdr.magic != JOURNAL_MAGIC || page->hdr.seq != seq) {
+			return false;
+		}
+		*record = page->rec[index];
+	}
+	return record->check == journal_check(record);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the write amplification and mount cost counters
+ *
+ * @details
+ * 	 bytes_programmed / (records * sizeof(JOURNAL_RECORD)) is the write amplification,
+ * 	 and mount_probes the number of flash reads the last mount needed.
+ *
+ ******************************************************************************/
+const JOURNAL_STATS *journal_stats(void) {
+	return &stats;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the boot count stamped on the records of this boot
+ *
+ ******************************************************************************/
+uint8_t journal_boot_count(void) {
+	return journal_boot;
+}
+
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the flash address of a journal page
+ *
+ ******************************************************************************/
+JOURNAL_PAGE *journal_page(uint32_t index) {
+	return (JOURNAL_PAGE *) (JOURNAL_BASE_ADDR + index * JOURNAL_PAGE_SIZE);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Reads the header of a journal page
+ *
+ * @param[in] index
+ *   ring index of the page
+ *
+ * @param[out] seq
+ *   the page sequence number when true is returned
+ *
+ * @return
+ *   true if the page holds a complete header
+ *
+ ******************************************************************************/
+bool journal_hdr_valid(uint32_t index, uint32_t *seq) {
+	JOURNAL_PAGE_HDR *hdr = &journal_page(index)->hdr;
+
+	stats.mount_probes++;
+	if(hdr->magic != JOURNAL_MAGIC || hdr->seq != ~hdr->seq_inv || hdr->seq % JOURNAL_PAGES != index) {
+		return false;
+	}
+	*seq = hdr->seq;
+	return true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns true if a record slot in flash was never programmed
+ *
+ ******************************************************************************/
+bool journal_rec_erased(const JOURNAL_RECORD *record) {
+	const uint32_t *word = (const uint32_t *) record;
+
+	for(uint32_t i = 0; i < sizeof(JOURNAL_RECORD) / 4; i++) {
+		if(word[i] != 0xFFFFFFFF) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Computes the check word of a record
+ *
+ * @details
+ * 	 A Fletcher style sum over the other fields.  It can never be 0xFFFF for a record
+ * 	 of erased words, so a record cut short by a reset fails it.
+ *
+ ******************************************************************************/
+uint16_t journal_check(const JOURNAL_RECORD *record) {
+	const uint8_t *byte = (const uint8_t *) record;
+	uint32_t sum1 = 0x5A;
+	uint32_t sum2 = 0;
+
+	for(uint32_t i = 0; i < sizeof(JOURNAL_RECORD) - sizeof(record->check); i++) {
+		sum1 = (sum1 + byte[i]) % 255;
+		sum2 = (sum2 + sum1) % 255;
+	}
+	return (uint16_t) ((sum2 << 8) | sum1);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Programs words of the journal region
+ *
+ ******************************************************************************/
+void journal_program(void *dest, const void *src, uint32_t num_bytes) {
+	MSC_Status_TypeDef status = MSC_WriteWord((uint32_t *) dest, src, num_bytes);
+
+	EFM_ASSERT(status == mscReturnOk);
+	stats.bytes_programmed += num_bytes;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Moves the head to the next page of the ring
+ *
+ * @details
+ * 	 The page is erased by the first journal_flush() that programs it.
+ *
+ ******************************************************************************/
+void journal_advance(void) {
+	head_seq++;
+	head_count = 0;
+	head_written = 0;
+	head_ready = false;
+}
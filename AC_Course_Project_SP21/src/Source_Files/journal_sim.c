@@ -0,0 +1,444 @@
+/**
+ * @file
+ * 	journal_sim.c
+ * @author
+ * 	Adam Chehadi
+ * @date
+ * 	05/24/2021
+ * @brief
+ *	Contains the host simulation of the flash journal on a memory-mapped file
+ *
+ * @details
+ *	Only built with JOURNAL_SIM defined, the firmware build compiles it to nothing.
+ *	From src:
+ *
+ *	gcc -DJOURNAL_SIM -IHost_Files -IHeader_Files Source_Files/journal_sim.c Source_Files/journal.c -o journal_sim
+ *
+ *	The flash is a file mapped with mmap() and programmed with the semantics of NOR
+ *	flash by the MSC stand-ins below, an erase sets every bit and a write can only
+ *	clear bits.  A power cut can be placed after any number of programmed words, the
+ *	write stops there and control returns to the simulation, which mounts the journal
+ *	again as the next boot would.  The file is left behind for inspection.
+ *
+ *	The simulation prints the write amplification of three flush policies and the
+ *	probes and host time of a mount at several fill levels, and checks that a mount
+ *	after a torn record or a torn page header keeps the records in order.  It returns
+ *	non-zero if a check fails.
+ *
+ *	With QUERY_SIM defined only the flash and timebase stand-ins are built, for
+ *	query_sim.c.
+ */
+
+#if defined(JOURNAL_SIM) || defined(QUERY_SIM)
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "journal.h"
+#include "host_flash.h"
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+uint8_t			*host_flash;
+jmp_buf			host_flash_cut;
+
+static int		host_flash_fd = -1;
+static int32_t	host_flash_budget = HOST_FLASH_NEVER;	// words programmed before the power cut
+
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Maps a new, erased flash file
+ *
+ * @param[in] path
+ *   file to create, an existing one is overwritten
+ *
+ ******************************************************************************/
+void host_flash_open(const char *path) {
+	host_flash_fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	EFM_ASSERT(host_flash_fd >= 0);
+	EFM_ASSERT(ftruncate(host_flash_fd, FLASH_SIZE) == 0);
+
+	host_flash = mmap(NULL, FLASH_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, host_flash_fd, 0);
+	EFM_ASSERT(host_flash != MAP_FAILED);
+	memset(host_flash, 0xFF, FLASH_SIZE);
+	host_flash_budget = HOST_FLASH_NEVER;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Writes the flash file back and unmaps it
+ *
+ ******************************************************************************/
+void host_flash_close(void) {
+	msync(host_flash, FLASH_SIZE, MS_SYNC);
+	munmap(host_flash, FLASH_SIZE);
+	close(host_flash_fd);
+	host_flash = NULL;
+	host_flash_fd = -1;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Cuts the power after a number of programmed words
+ *
+ * @details
+ *   The write that reaches the limit stops before the next word and longjmp()s to
+ *   host_flash_cut, the caller's setjmp() stands for the next boot.
+ *
+ * @param[in] words
+ *   words programmed before the cut, HOST_FLASH_NEVER for no cut
+ *
+ ******************************************************************************/
+void host_flash_cut_after(int32_t words) {
+	host_flash_budget = words;
+}
+
+
+void MSC_Init(void) {
+}
+
+
+MSC_Status_TypeDef MSC_ErasePage(uint32_t *startAddress) {
+	uint8_t *page = (uint8_t *) startAddress;
+
+	if(page < host_flash || page >= host_flash + FLASH_SIZE || (page - host_flash) % FLASH_PAGE_SIZE) {
+		return mscReturnInvalidAddr;
+	}
+	memset(page, 0xFF, FLASH_PAGE_SIZE);
+	return mscReturnOk;
+}
+
+
+MSC_Status_TypeDef MSC_WriteWord(uint32_t *address, void const *data, uint32_t numBytes) {
+	uint8_t *dest = (uint8_t *) address;
+	uint32_t word;
+
+	if(dest < host_flash || dest + numBytes > host_flash + FLASH_SIZE || ((dest - host_flash) % 4) || (numBytes % 4)) {
+		return mscReturnInvalidAddr;
+	}
+	for(uint32_t i = 0; i < numBytes / 4; i++) {
+		if(host_flash_budget == 0) {
+			host_flash_budget = HOST_FLASH_NEVER;
+			longjmp(host_flash_cut, 1);
+		}
+		if(host_flash_budget > 0) {
+			host_flash_budget--;
+		}
+		memcpy(&word, (const uint8_t *) data + 4 * i, sizeof(word));
+		address[i] &= word;
+	}
+	return mscReturnOk;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Host timebase, the monotonic clock in RTCC ticks
+ *
+ ******************************************************************************/
+uint64_t timebase_ticks(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((uint64_t) now.tv_sec * TIMEBASE_HZ) + ((uint64_t) now.tv_nsec * TIMEBASE_HZ / 1000000000);
+}
+
+#endif
+
+
+#ifdef JOURNAL_SIM
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+#define SIM_PATH				"journal_sim.bin"
+#define SIM_PERIOD_MS			1800		// PWM_PER
+#define SIM_LAP					(JOURNAL_PAGES * JOURNAL_RECORDS_PER_PAGE)
+#define SIM_MOUNTS				1000		// mounts timed per fill level
+#define SIM_RECORD_WORDS		(sizeof(JOURNAL_RECORD) / 4)
+
+static uint32_t		sim_time_ms;			// sample time of the next record, restarts every boot
+static uint32_t		sim_failed;
+
+
+//***********************************************************************************
+// Private function prototypes
+//***********************************************************************************
+static void sim_boot(void);
+static void sim_append(uint32_t count, uint32_t flush_every);
+static bool sim_ordered(void);
+static void sim_check(bool pass, const char *what);
+static void sim_write_amplification(uint32_t flush_every, const char *policy);
+static void sim_mount(uint32_t records);
+static void sim_torn(int32_t words_into_flush, const char *what);
+
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Runs every measurement and check
+ *
+ * @return
+ *   0 if every check passed
+ *
+ ******************************************************************************/
+int main(void) {
+	printf("%lu records of %lu bytes per page, %lu pages\n", (unsigned long) JOURNAL_RECORDS_PER_PAGE,
+			(unsigned long) sizeof(JOURNAL_RECORD), (unsigned long) JOURNAL_PAGES);
+
+	sim_write_amplification(1, "flush every record");
+	sim_write_amplification(33, "flush every 60 s at 1.8 s");
+	sim_write_amplification(JOURNAL_RECORDS_PER_PAGE, "flush full pages only");
+
+	sim_mount(0);
+	sim_mount(1);
+	sim_mount(JOURNAL_RECORDS_PER_PAGE / 2);
+	sim_mount(10 * JOURNAL_RECORDS_PER_PAGE + 3);
+	sim_mount(SIM_LAP - 1);
+	sim_mount(5 * SIM_LAP / 2);
+
+	sim_torn(2, "record torn after 2 of 4 words");
+	sim_torn(1 + SIM_RECORD_WORDS, "second record of the flush torn");
+	sim_torn(-2, "page header torn");
+
+	printf("%lu failed\n", (unsigned long) sim_failed);
+	return sim_failed ? 1 : 0;
+}
+
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Mounts the journal as a new boot, the sample times restart
+ *
+ ******************************************************************************/
+void sim_boot(void) {
+	journal_open();
+	sim_time_ms = 0;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Appends records one sample period apart
+ *
+ * @param[in] count
+ *   records to append
+ *
+ * @param[in] flush_every
+ *   records between calls to journal_flush(), a full page is always programmed
+ *
+ ******************************************************************************/
+void sim_append(uint32_t count, uint32_t flush_every) {
+	JOURNAL_RECORD record;
+
+	for(uint32_t i = 0; i < count; i++) {
+		memset(&record, 0, sizeof(record));
+		record.time_ms = sim_time_ms;
+		record.humidity = (int16_t) (450 + i % 50);
+		record.temperature = (int16_t) (700 + i % 30);
+		record.light = 100 + i % 1000;
+		record.present = JOURNAL_HUMIDITY | JOURNAL_TEMPERATURE | JOURNAL_LIGHT;
+		journal_append(&record);
+		sim_time_ms += SIM_PERIOD_MS;
+
+		if(!((i + 1) % flush_every)) {
+			journal_flush();
+		}
+	}
+	journal_flush();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns true if the readable records are in strictly increasing (boot, ms) order
+ *
+ ******************************************************************************/
+bool sim_ordered(void) {
+	JOURNAL_RECORD record;
+	uint64_t key;
+	uint64_t last = 0;
+	bool any = false;
+
+	for(uint32_t number = journal_first(); number < journal_next(); number++) {
+		if(!journal_read(number, &record)) {
+			continue;
+		}
+		key = ((uint64_t) record.boot << 32) | record.time_ms;
+		if(any && key <= last) {
+			return false;
+		}
+		last = key;
+		any = true;
+	}
+	return true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Counts and reports a failed check
+ *
+ ******************************************************************************/
+void sim_check(bool pass, const char *what) {
+	if(!pass) {
+		printf("FAIL: %s\n", what);
+		sim_failed++;
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Measures the flash programmed and erased per record over three laps of the ring
+ *
+ * @param[in] flush_every
+ *   records between calls to journal_flush()
+ *
+ * @param[in] policy
+ *   name of the flush policy
+ *
+ ******************************************************************************/
+void sim_write_amplification(uint32_t flush_every, const char *policy) {
+	JOURNAL_STATS before;
+	const JOURNAL_STATS *after;
+	uint32_t records;
+	uint32_t bytes;
+	uint32_t erased;
+
+	host_flash_open(SIM_PATH);
+	sim_boot();
+	before = *journal_stats();
+	sim_append(3 * SIM_LAP, flush_every);
+	after = journal_stats();
+
+	records = after->records - before.records;
+	bytes = after->bytes_programmed - before.bytes_programmed;
+	erased = after->pages_erased - before.pages_erased;
+	printf("%s: %lu records, %lu bytes programmed, write amplification %.4f, %lu erases, %.2f erases per 1000 records\n",
+			policy, (unsigned long) records, (unsigned long) bytes,
+			(double) bytes / ((double) records * sizeof(JOURNAL_RECORD)), (unsigned long) erased,
+			1000.0 * erased / records);
+
+	sim_check(erased == (records + JOURNAL_RECORDS_PER_PAGE - 1) / JOURNAL_RECORDS_PER_PAGE, "one erase per page");
+	sim_check(sim_ordered(), "records in order");
+	host_flash_close();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Measures the mount of a journal holding a number of records
+ *
+ * @details
+ *   Every mount after the first is of the same flash, the last one's probes are kept
+ *   and the host time is averaged.  The records written must all be found again.
+ *
+ * @param[in] records
+ *   records appended before the mounts
+ *
+ ******************************************************************************/
+void sim_mount(uint32_t records) {
+	uint64_t start;
+	uint64_t ticks;
+	uint32_t next;
+
+	host_flash_open(SIM_PATH);
+	sim_boot();
+	sim_append(records, JOURNAL_RECORDS_PER_PAGE);
+	next = journal_next();
+
+	start = timebase_ticks();
+	for(uint32_t i = 0; i < SIM_MOUNTS; i++) {
+		journal_open();
+	}
+	ticks = timebase_ticks() - start;
+
+	printf("mount of %lu records: %lu probes, %.2f us on the host\n", (unsigned long) records,
+			(unsigned long) journal_stats()->mount_probes, 1e6 * ticks / TIMEBASE_HZ / SIM_MOUNTS);
+	sim_check(journal_next() == next, "mount finds every record");
+	host_flash_close();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Cuts the power during a flush and checks the next boot
+ *
+ * @details
+ *   Two boots of records fill the journal to one short of a page, then the power is
+ *   cut while a flush programs a new batch.  The next boot must number its records
+ *   after every intact one, keep them in order and read back what it appends.
+ *
+ * @param[in] words_into_flush
+ *   words of the batch programmed before the cut, negative to fill the page and cut
+ *   the header of the next one that many words in
+ *
+ * @param[in] what
+ *   name of the case
+ *
+ ******************************************************************************/
+void sim_torn(int32_t words_into_flush, const char *what) {
+	JOURNAL_RECORD record;
+	uint8_t boot;
+	uint32_t next;
+	volatile bool ok = true;			// set across the longjmp()
+
+	host_flash_open(SIM_PATH);
+	sim_boot();
+	sim_append(JOURNAL_RECORDS_PER_PAGE, 1);
+	sim_boot();
+	if(words_into_flush < 0) {
+		sim_append(JOURNAL_RECORDS_PER_PAGE - 1, 1);
+		host_flash_cut_after(SIM_RECORD_WORDS - words_into_flush);		// after the record that fills the page
+	} else {
+		sim_append(JOURNAL_RECORDS_PER_PAGE / 2, 1);
+		host_flash_cut_after(words_into_flush);
+	}
+	boot = journal_boot_count();
+
+	if(!setjmp(host_flash_cut)) {
+		sim_append(4, 4);
+		host_flash_cut_after(HOST_FLASH_NEVER);
+		ok = false;							// the cut never came
+	}
+
+	sim_boot();
+	printf("%s: boot count %u after %u, next record %lu\n", what, journal_boot_count(), boot,
+			(unsigned long) journal_next());
+	sim_check(ok, "power cut reached");
+	sim_check(journal_boot_count() == boot + 1, "boot count follows the last intact record");
+
+	next = journal_next();
+	sim_append(10, 1);
+	sim_check(sim_ordered(), "records in order after the cut");
+	for(uint32_t number = next; number < journal_next(); number++) {
+		sim_check(journal_read(number, &record) && record.boot == boot + 1, "records of the new boot read back");
+	}
+	host_flash_close();
+}
+
+#endif
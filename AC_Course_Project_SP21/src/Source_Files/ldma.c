@@ -0,0 +1,138 @@
+/**
+ * @file
+ * 	ldma.c
+ * @author
+ * 	Adam Chehadi
+ * @date
+ * 	05/03/2021
+ * @brief
+ *	Contains the LDMA driver functions shared by the peripherals that move data by DMA
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "ldma.h"
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+static LDMA_DONE_CB		ldma_done_cb[LDMA_NUM_CH];
+static bool				ldma_opened = false;
+
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   LDMA open function
+ *
+ * @details
+ * 	 Enables the LDMA clock and initializes the controller with the emlib defaults.
+ * 	 Each driver that uses a channel registers its done callback with ldma_channel_open().
+ *
+ * @note
+ *   Safe to call more than once, only the first call initializes the controller.
+ *
+ ******************************************************************************/
+void ldma_open(void) {
+	LDMA_Init_t ldma_init_values = LDMA_INIT_DEFAULT;
+
+	if(ldma_opened) {
+		return;
+	}
+
+	CMU_ClockEnable(cmuClock_LDMA, true);
+	LDMA_Init(&ldma_init_values);
+
+	for(uint32_t i = 0; i < LDMA_NUM_CH; i++) {
+		ldma_done_cb[i] = 0;
+	}
+
+	ldma_opened = true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   LDMA channel open function
+ *
+ * @details
+ * 	 Records the function that the LDMA interrupt handler calls when the descriptor
+ * 	 chain on this channel completes.
+ *
+ * @note
+ *   The callback runs in interrupt context.  Only descriptors with doneIfs set raise
+ *   the channel's done interrupt.
+ *
+ * @param[in] channel
+ *   LDMA channel owned by the caller, see the LDMA_xxx_CH defines
+ *
+ * @param[in] done_cb
+ *   function called from LDMA_IRQHandler on channel done, may be 0
+ *
+ ******************************************************************************/
+void ldma_channel_open(uint32_t channel, LDMA_DONE_CB done_cb) {
+	EFM_ASSERT(channel < LDMA_NUM_CH);
+	EFM_ASSERT(ldma_opened);
+
+	ldma_done_cb[channel] = done_cb;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   LDMA PRS request open function
+ *
+ * @details
+ * 	 Selects the PRS channel that drives PRS DMA request 0 or 1.  A channel started with
+ * 	 ldmaPeripheralSignal_PRS_REQ0 or _REQ1 then transfers on every pulse of that PRS channel.
+ *
+ * @param[in] request
+ *   PRS DMA request, 0 or 1
+ *
+ * @param[in] prs_ch
+ *   PRS channel routed to the request
+ *
+ ******************************************************************************/
+void ldma_prs_request_open(uint32_t request, uint32_t prs_ch) {
+	CMU_ClockEnable(cmuClock_PRS, true);
+
+	if(request == 0) {
+		PRS->DMAREQ0 = prs_ch << _PRS_DMAREQ0_PRSSEL_SHIFT;
+	} else if(request == 1) {
+		PRS->DMAREQ1 = prs_ch << _PRS_DMAREQ1_PRSSEL_SHIFT;
+	} else {
+		EFM_ASSERT(false);
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   LDMA Interrupt Service Routine
+ *
+ * @details
+ * 	 Clears the done flag of every completed channel and calls the callback that the
+ * 	 owning driver registered for it.
+ *
+ * @note
+ *   A bus error on any channel is a programming error and asserts.
+ *
+ ******************************************************************************/
+void LDMA_IRQHandler(void) {
+	uint32_t int_flag;
+	int_flag = LDMA->IF & LDMA->IEN;
+	LDMA->IFC = int_flag;
+
+	EFM_ASSERT(!(int_flag & LDMA_IF_ERROR));
+
+	for(uint32_t ch = 0; ch < LDMA_NUM_CH; ch++) {
+		if((int_flag & (1 << ch)) && ldma_done_cb[ch]) {
+			ldma_done_cb[ch](ch);
+		}
+	}
+}
@@ -34,6 +34,13 @@ static uint32_t scheduled_comp0_cb;
 static uint32_t scheduled_comp1_cb;
 static uint32_t scheduled_uf_cb;
 
+static uint32_t			letimer_hz = LETIMER_HZ;
+
+static volatile bool		comp0_pending;
+static volatile bool		comp1_pending;
+static volatile uint32_t	pending_period_cnt;
+static volatile uint32_t	pending_active_cnt;
+
 
 //***********************************************************************************
 // Private functions
@@ -71,8 +78,8 @@ static uint32_t scheduled_uf_cb;
 void letimer_pwm_open(LETIMER_TypeDef *letimer, APP_LETIMER_PWM_TypeDef *app_letimer_struct){
 	LETIMER_Init_TypeDef letimer_pwm_values;
 
-	unsigned int period_cnt = app_letimer_struct->period*LETIMER_HZ;;
-	unsigned int period_active_cnt = app_letimer_struct->active_period*LETIMER_HZ;
+	unsigned int period_cnt = app_letimer_struct->period*letimer_hz;
+	unsigned int period_active_cnt = app_letimer_struct->active_period*letimer_hz;
 
 	/*  Initializing LETIMER for PWM mode */
 	/*  Enable the routed clock to the LETIMER0 peripheral */
@@ -207,6 +214,182 @@ void letimer_start(LETIMER_TypeDef *letimer, bool enable){
 }
 
 
+/***************************************************************************//**
+ * @brief
+ *   Changes the PWM period and active period while the LETIMER keeps running
+ *
+ * @details
+ * 	 The new counts are staged and written by the underflow interrupt, right after
+ * 	 CNT has been reloaded from COMP0, so the period in progress always completes
+ * 	 with the top it started with.  COMP1 is only written once CNT is above the new
+ * 	 COMP1 value, which guarantees the active-period compare of the running period
+ * 	 is never skipped.  A longer active period therefore takes effect one underflow
+ * 	 after the new top.
+ *
+ * @note
+ *   CTRL.BUFTOP is not used since it reloads COMP0 from COMP1 and COMP1 is already
+ *   the active-period compare of this PWM driver.  When the LETIMER is stopped or
+ *   the underflow interrupt is not enabled, the registers are written directly.
+ *
+ * @param[in] letimer
+ *   Pointer to the base peripheral address of the LETIMER peripheral
+ *
+ * @param[in] period
+ *   New PWM period in seconds
+ *
+ * @param[in] active_period
+ *   New PWM active period in seconds, must be less than period
+ *
+ ******************************************************************************/
+void letimer_pwm_set_period(LETIMER_TypeDef *letimer, float period, float active_period){
+	uint32_t period_cnt = period*letimer_hz;
+	uint32_t period_active_cnt = active_period*letimer_hz;
+
+	EFM_ASSERT(period_cnt <= _LETIMER_COMP0_MASK);
+	EFM_ASSERT(period_active_cnt < period_cnt);
+
+	CORE_DECLARE_IRQ_STATE;
+	CORE_ENTER_CRITICAL();
+
+	if((letimer->STATUS & LETIMER_STATUS_RUNNING) && (letimer->IEN & LETIMER_IEN_UF)) {
+		pending_period_cnt = period_cnt;
+		pending_active_cnt = period_active_cnt;
+		comp0_pending = true;
+		comp1_pending = true;
+	} else {
+		while(letimer->SYNCBUSY);
+		letimer->COMP0 = period_cnt;
+		letimer->COMP1 = period_active_cnt;
+		comp0_pending = false;
+		comp1_pending = false;
+	}
+
+	CORE_EXIT_CRITICAL();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Measures the ULFRCO feeding the LETIMER against the LFXO timebase
+ *
+ * @details
+ * 	 Free runs the LETIMER for LETIMER_CAL_TICKS ULFRCO ticks, starting and ending on
+ * 	 a counter edge, and counts the LFXO ticks of the timebase over the same window.
+ * 	 The result replaces LETIMER_HZ in every seconds-to-counts conversion of this
+ * 	 driver, so periods are accurate even though the ULFRCO can be off by tens of
+ * 	 percent.
+ *
+ * @note
+ *   Must be called before letimer_pwm_open() since it reprograms the LETIMER.  The
+ *   timebase must be open.  Takes about LETIMER_CAL_TICKS milliseconds.  A result
+ *   outside LETIMER_HZ_MIN to LETIMER_HZ_MAX is rejected and the nominal frequency
+ *   is kept.
+ *
+ * @param[in] letimer
+ *   Pointer to the base peripheral address of the LETIMER peripheral
+ *
+ * @return
+ *   the ULFRCO frequency in Hz used from now on
+ *
+ ******************************************************************************/
+uint32_t letimer_ulfrco_calibrate(LETIMER_TypeDef *letimer){
+	LETIMER_Init_TypeDef letimer_cal_values = LETIMER_INIT_DEFAULT;
+	uint32_t start_cnt;
+	uint64_t start_ticks;
+	uint64_t lfxo_ticks;
+	uint32_t measured_hz;
+
+	EFM_ASSERT(timebase_is_open());
+
+	if (letimer == LETIMER0) {
+		CMU_ClockEnable(cmuClock_LETIMER0, true);
+	}
+
+	// Free running down counter, wraps from 0 to 0xFFFF
+	letimer_cal_values.enable = false;
+	letimer_cal_values.comp0Top = false;
+	letimer_cal_values.repMode = letimerRepeatFree;
+	LETIMER_Init(letimer, &letimer_cal_values);
+	while (letimer->SYNCBUSY);
+
+	LETIMER_Enable(letimer, true);
+	while (letimer->SYNCBUSY);
+
+	// Line up with a ULFRCO edge before starting the window
+	start_cnt = letimer->CNT;
+	while (letimer->CNT == start_cnt);
+	start_cnt = letimer->CNT;
+	start_ticks = timebase_ticks();
+
+	while (((start_cnt - letimer->CNT) & _LETIMER_CNT_MASK) < LETIMER_CAL_TICKS);
+	lfxo_ticks = timebase_ticks() - start_ticks;
+
+	LETIMER_Enable(letimer, false);
+	while (letimer->SYNCBUSY);
+
+	measured_hz = (uint32_t) (((uint64_t) LETIMER_CAL_TICKS * TIMEBASE_HZ + lfxo_ticks / 2) / lfxo_ticks);
+	if ((measured_hz >= LETIMER_HZ_MIN) && (measured_hz <= LETIMER_HZ_MAX)) {
+		letimer_hz = measured_hz;
+	}
+
+	return letimer_hz;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the LETIMER clock frequency used for period conversions
+ *
+ * @return
+ *   calibrated ULFRCO frequency, or LETIMER_HZ if not calibrated
+ *
+ ******************************************************************************/
+uint32_t letimer_clock_hz(void){
+	return letimer_hz;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the longest period the 16-bit COMP0 holds at the LETIMER clock
+ *
+ * @details
+ *   A ULFRCO that calibrates above LETIMER_HZ shortens it below the nominal 65 s.
+ *
+ * @return
+ *   period in milliseconds, rounded down
+ *
+ ******************************************************************************/
+uint32_t letimer_period_max_ms(void){
+	return (uint32_t) ((uint64_t) _LETIMER_COMP0_MASK * 1000 / letimer_hz);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Routes the LETIMER underflow onto a PRS channel
+ *
+ * @details
+ * 	 In PWM mode output 0 goes active on the COMP1 match and back to idle on underflow,
+ * 	 so with out0Pol = 0 the falling edge of channel 0 marks the underflow.  The PRS
+ * 	 turns that edge into a single pulse other peripherals can consume without the
+ * 	 CPU, the output does not have to be routed to a pin.
+ *
+ * @param[in] letimer
+ *   A pointer to the LETIMER peripheral register block, only LETIMER0 exists
+ *
+ * @param[in] prs_ch
+ *   PRS channel to drive
+ *
+ ******************************************************************************/
+void letimer_prs_open(LETIMER_TypeDef *letimer, uint32_t prs_ch){
+	EFM_ASSERT(letimer == LETIMER0);
+
+	CMU_ClockEnable(cmuClock_PRS, true);
+	PRS_SourceSignalSet(prs_ch, PRS_CH_CTRL_SOURCESEL_LETIMER0, PRS_CH_CTRL_SIGSEL_LETIMER0CH0, prsEdgeNeg);
+}
+
+
 /***************************************************************************//**
  * @brief
  *	LETIMER0 Interrupt Request Handler
@@ -238,6 +421,15 @@ void LETIMER0_IRQHandler(void) {
 
 	if (int_flag & LETIMER_IF_UF) {
 		EFM_ASSERT(!(LETIMER0->IF & LETIMER_IF_UF));
+		// CNT was just reloaded, staged compare values can be applied glitch free
+		if (comp0_pending) {
+			LETIMER0->COMP0 = pending_period_cnt;
+			comp0_pending = false;
+		}
+		if (comp1_pending && (pending_active_cnt <= LETIMER0->CNT)) {
+			LETIMER0->COMP1 = pending_active_cnt;
+			comp1_pending = false;
+		}
 		add_scheduled_event(scheduled_uf_cb);
 	}
 
@@ -10,9 +10,6 @@
 // Include files
 //***********************************************************************************
 
-//** Standard Library includes
-#include <string.h>
-
 //** Silicon Labs include files
 #include "em_gpio.h"
 #include "em_cmu.h"
@@ -35,6 +32,14 @@ bool		leuart0_tx_busy;
 
 static LEUART_STATE_MACHINE			leuart_state_struct;
 
+static bool							tx_ldma;
+static bool							rx_ldma;
+static bool							rx_block;
+static LDMA_Descriptor_t			tx_descriptors[LEUART_TX_MAX_DESCRIPTORS];
+static LDMA_Descriptor_t			rx_descriptor;
+static char							rx_buffer[LEUART_RX_BUFFER_SIZE];
+static uint32_t						rx_tail;
+
 /***************************************************************************//**
  * @brief LEUART driver
  * @details
@@ -53,6 +58,9 @@ static LEUART_STATE_MACHINE			leuart_state_struct;
 //***********************************************************************************
 static void leuart_txbl(LEUART_STATE_MACHINE *leuart_state);
 static void leuart_txc(LEUART_STATE_MACHINE *leuart_state);
+static void leuart_tx_ldma_done(uint32_t channel);
+static void leuart_rx_ldma_start(LEUART_TypeDef *leuart);
+static uint32_t leuart_rx_head(void);
 
 
 //***********************************************************************************
@@ -107,6 +115,36 @@ void leuart_open(LEUART_TypeDef *leuart, LEUART_OPEN_STRUCT *leuart_settings){
 	LEUART_Init(leuart, &leuart_values);
 	while(leuart->SYNCBUSY);
 
+	// Let the LDMA be woken from EM2 by TXBL / RXDATAV instead of the CPU
+	tx_ldma = leuart_settings->tx_ldma_en;
+	rx_ldma = leuart_settings->rx_ldma_en;
+	if(tx_ldma | rx_ldma) {
+		ldma_open();
+	}
+	if(tx_ldma) {
+		leuart->CTRL |= LEUART_CTRL_TXDMAWU;
+		ldma_channel_open(LDMA_LEUART0_TX_CH, leuart_tx_ldma_done);
+	}
+	if(rx_ldma) {
+		leuart->CTRL |= LEUART_CTRL_RXDMAWU;
+		ldma_channel_open(LDMA_LEUART0_RX_CH, 0);
+	}
+	while(leuart->SYNCBUSY);
+
+	// The start frame unblocks the receiver, the signal frame marks the end of a message
+	if(leuart_settings->startframe_en) {
+		leuart->STARTFRAME = leuart_settings->startframe;
+		while(leuart->SYNCBUSY);
+	}
+	if(leuart_settings->sfubrx) {
+		leuart->CTRL |= LEUART_CTRL_SFUBRX;
+		while(leuart->SYNCBUSY);
+	}
+	if(leuart_settings->sigframe_en) {
+		leuart->SIGFRAME = leuart_settings->sigframe;
+		while(leuart->SYNCBUSY);
+	}
+
 	// Route
 	leuart->ROUTELOC0 = leuart_settings->tx_loc | leuart_settings->rx_loc;
 	leuart->ROUTEPEN = (leuart_settings->tx_pin_en * leuart_settings->tx_en) | (leuart_settings->rx_pin_en * leuart_settings->rx_en);
@@ -121,6 +159,13 @@ void leuart_open(LEUART_TypeDef *leuart, LEUART_OPEN_STRUCT *leuart_settings){
 		EFM_ASSERT(leuart->STATUS & LEUART_STATUS_RXENS);
 	}
 
+	// Drop everything received until the start frame arrives
+	rx_block = leuart_settings->rxblocken;
+	if(rx_block) {
+		leuart->CMD = LEUART_CMD_RXBLOCKEN;
+		while(leuart->SYNCBUSY);
+	}
+
 	if(leuart_settings->tx_en) {
 		leuart->CMD = LEUART_CMD_TXEN;
 		while(!(leuart->STATUS & LEUART_STATUS_TXENS));
@@ -134,6 +179,13 @@ void leuart_open(LEUART_TypeDef *leuart, LEUART_OPEN_STRUCT *leuart_settings){
 
 	// Clear all interrupts
 	leuart->IFC = _LEUART_IFC_MASK;
+
+	if(rx_ldma) {
+		leuart_rx_ldma_start(leuart);
+	}
+	if(leuart_settings->sigframe_en) {
+		leuart->IEN |= LEUART_IEN_SIGF;
+	}
 }
 
 
@@ -164,6 +216,13 @@ void LEUART0_IRQHandler(void){
 	if(int_flag & LEUART_IF_TXC) {
 		leuart_txc(&leuart_state_struct);
 	}
+	if(int_flag & LEUART_IF_SIGF) {
+		// Message complete, block the receiver again until the next start frame
+		if(rx_block) {
+			LEUART0->CMD = LEUART_CMD_RXBLOCKEN;
+		}
+		add_scheduled_event(rx_done_cb);
+	}
 }
 
 /***************************************************************************//**
@@ -171,13 +230,11 @@ void LEUART0_IRQHandler(void){
  *   initializes everything for the leuart protocol, then
  *
  * @details
- *     starts the leuart protocol by initializing the parameters of the leuart state machine,
- *     and then enabling the TXBL interrupt
+ *     starts the leuart protocol by handing a single segment to leuart_start_segments().
+ *     The string is not copied, it is transmitted straight out of the caller's buffer.
  *
  * @note
- *      waits until leuart is not busy, then disables all interrupts so that the optimizer
- *      does not change the order and enable the TXBL interrupt before initializing the other
- *      settings
+ *      the caller owns *string again once the tx_done event from leuart_open() is raised
  *
  * @param[in] leuart
  *   LEUARTx based on specific application code that called this driver
@@ -188,11 +245,71 @@ void LEUART0_IRQHandler(void){
  * @param[in] string_len
  *   length of *string, used to know when full sequence has been transmitted
  *
- * @param[in] CB
- *   callback definition for when to use when transmitting is done
+ ******************************************************************************/
+void leuart_start(LEUART_TypeDef *leuart, const char *string, uint32_t string_len){
+	LEUART_TX_SEGMENT segment;
+
+	segment.data = string;
+	segment.length = string_len;
 
+	bool started = leuart_start_segments(leuart, &segment, 1, tx_done_cb);
+	EFM_ASSERT(started);
+}
+
+/***************************************************************************//**
+ * @brief
+ *   starts a zero-copy transmit of a scatter list of segments
+ *
+ * @details
+ *     copies only the segment descriptors (pointer and length) into the leuart state
+ *     machine and enables the TXBL interrupt.  The bytes themselves are read from the
+ *     caller's buffers by the TXBL interrupt, so there is no length limit on a segment.
+ *     When the LEUART was opened with tx_ldma_en, the segments are instead chained into
+ *     LDMA descriptors that feed TXDATA, and the only interrupts are the LDMA done
+ *     interrupt after the last byte is queued and the TXC interrupt that follows it.
+ *     A segment longer than LEUART_LDMA_XFER_MAX takes one descriptor per
+ *     LEUART_LDMA_XFER_MAX bytes, and a list that needs more than
+ *     LEUART_TX_MAX_DESCRIPTORS is refused before anything is started.
+ *
+ * @note
+ *      Ownership of every segment buffer passes to the driver until release_evt is
+ *      raised from the TXC interrupt.  The caller must not modify or free the buffers
+ *      before then.  The segments array itself may be a local, it is not referenced
+ *      after this function returns.
+ *
+ * @param[in] leuart
+ *   LEUARTx based on specific application code that called this driver
+ *
+ * @param[in] segments
+ *   scatter list of buffers to transmit back to back
+ *
+ * @param[in] num_segments
+ *   number of entries in segments, 1 to LEUART_TX_MAX_SEGMENTS
+ *
+ * @param[in] release_evt
+ *   scheduler event raised when the last byte has left the shift register and the
+ *   buffers are handed back to the caller
+ *
+ * @return
+ *   false if the list needs more LDMA descriptors than LEUART_TX_MAX_DESCRIPTORS, the
+ *   buffers stay with the caller and release_evt is not raised
+ *
  ******************************************************************************/
-void leuart_start(LEUART_TypeDef *leuart, char *string, uint32_t string_len){
+bool leuart_start_segments(LEUART_TypeDef *leuart, const LEUART_TX_SEGMENT *segments, uint32_t num_segments, uint32_t release_evt){
+	uint32_t descriptors = 0;
+
+	EFM_ASSERT((num_segments > 0) && (num_segments <= LEUART_TX_MAX_SEGMENTS));
+	EFM_ASSERT(!leuart_state_struct.busy);
+
+	if(tx_ldma) {
+		for(uint32_t i = 0; i < num_segments; i++) {
+			descriptors += (segments[i].length + LEUART_LDMA_XFER_MAX - 1) / LEUART_LDMA_XFER_MAX;
+		}
+		if(descriptors > LEUART_TX_MAX_DESCRIPTORS) {
+			return false;
+		}
+	}
+
 	while(leuart->SYNCBUSY);
 
 	CORE_DECLARE_IRQ_STATE;
@@ -200,17 +317,60 @@ void leuart_start(LEUART_TypeDef *leuart, char *string, uint32_t string_len){
 
 	sleep_block_mode(LEUART_TX_EM);
 
+	for(uint32_t i = 0; i < num_segments; i++) {
+		leuart_state_struct.segments[i] = segments[i];
+	}
+
 	leuart_state_struct.state = EnableTransfer;
 	leuart_state_struct.leuart = leuart;
+	leuart_state_struct.num_segments = num_segments;
+	leuart_state_struct.segment = 0;
 	leuart_state_struct.count = 0;
-	leuart_state_struct.length = string_len;
-	leuart_state_struct.callback = tx_done_cb;
-	strcpy(leuart_state_struct.string, string);
+	leuart_state_struct.length = segments[0].length;
+	leuart_state_struct.callback = release_evt;
 
 	leuart_state_struct.busy = true;
-	LEUART0->IEN |= LEUART_IEN_TXBL;
+
+	if(tx_ldma) {
+		LDMA_TransferCfg_t tx_cfg = LDMA_TRANSFER_CFG_PERIPHERAL(ldmaPeripheralSignal_LEUART0_TXBL);
+		uint32_t last = 0;
+		uint32_t used = 0;
+
+		EFM_ASSERT(LEUART_LDMA_XFER_MAX <= (_LDMA_CH_CTRL_XFERCNT_MASK >> _LDMA_CH_CTRL_XFERCNT_SHIFT) + 1);
+
+		// One descriptor per LEUART_LDMA_XFER_MAX bytes of each segment, linked back to back
+		for(uint32_t i = 0; i < num_segments; i++) {
+			for(uint32_t offset = 0; offset < segments[i].length; offset += LEUART_LDMA_XFER_MAX) {
+				uint32_t chunk = segments[i].length - offset;
+				if(chunk > LEUART_LDMA_XFER_MAX) {
+					chunk = LEUART_LDMA_XFER_MAX;
+				}
+				LDMA_Descriptor_t desc = LDMA_DESCRIPTOR_LINKREL_M2P_BYTE(&segments[i].data[offset], &leuart->TXDATA, chunk, 1);
+				desc.xfer.doneIfs = false;
+				tx_descriptors[used] = desc;
+				last = used;
+				used++;
+			}
+		}
+
+		if(used == 0) {
+			// Nothing to send, go straight to waiting on TXC so the release still fires
+			leuart_state_struct.state = EndTransfer;
+			leuart->IEN |= LEUART_IEN_TXC;
+			leuart->IFS = LEUART_IFS_TXC;
+		} else {
+			tx_descriptors[last].xfer.link = false;
+			tx_descriptors[last].xfer.linkAddr = 0;
+			tx_descriptors[last].xfer.doneIfs = true;
+			leuart_state_struct.state = TransferCharacters;
+			LDMA_StartTransfer(LDMA_LEUART0_TX_CH, &tx_cfg, &tx_descriptors[0]);
+		}
+	} else {
+		LEUART0->IEN |= LEUART_IEN_TXBL;
+	}
 
 	CORE_EXIT_CRITICAL();
+	return true;
 }
 
 /***************************************************************************//**
@@ -226,6 +386,69 @@ bool leuart_tx_busy(LEUART_TypeDef *leuart){
 	return leuart_state_struct.busy;
 }
 
+/***************************************************************************//**
+ * @brief
+ *   returns the number of received bytes waiting in the RX circular buffer
+ *
+ * @details
+ * 	 the write position is taken from the remaining count of the RX LDMA channel,
+ * 	 so no interrupt is needed per received byte
+ *
+ * @note
+ *   returns 0 when the LEUART was not opened with rx_ldma_en
+ *
+ * @param[in] leuart
+ *   LEUARTx based on specific application code that called this driver
+ *
+ ******************************************************************************/
+uint32_t leuart_rx_available(LEUART_TypeDef *leuart){
+	if(!rx_ldma) {
+		return 0;
+	}
+	return (leuart_rx_head() + LEUART_RX_BUFFER_SIZE - rx_tail) % LEUART_RX_BUFFER_SIZE;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   copies received bytes out of the RX circular buffer
+ *
+ * @details
+ * 	 copies up to max_len bytes, oldest first, and frees them in the circular buffer
+ *
+ * @note
+ *   The buffer holds LEUART_RX_BUFFER_SIZE - 1 bytes, data older than that is
+ *   overwritten by the LDMA before it is read
+ *
+ * @param[in] leuart
+ *   LEUARTx based on specific application code that called this driver
+ *
+ * @param[out] dest
+ *   destination for the received bytes
+ *
+ * @param[in] max_len
+ *   size of dest
+ *
+ * @return
+ * 	 number of bytes copied into dest
+ *
+ ******************************************************************************/
+uint32_t leuart_rx_read(LEUART_TypeDef *leuart, char *dest, uint32_t max_len){
+	uint32_t count = 0;
+	uint32_t head;
+
+	if(!rx_ldma) {
+		return 0;
+	}
+
+	head = leuart_rx_head();
+	while((rx_tail != head) && (count < max_len)) {
+		dest[count] = rx_buffer[rx_tail];
+		rx_tail = (rx_tail + 1) % LEUART_RX_BUFFER_SIZE;
+		count++;
+	}
+	return count;
+}
+
 /***************************************************************************//**
  * @brief
  *   LEUART STATUS function returns the STATUS of the peripheral for the
@@ -336,7 +559,8 @@ void leuart_app_transmit_byte(LEUART_TypeDef *leuart, uint8_t data_out){
  * @note
  *   In polling a receive byte, a while statement checking for the RXDATAV
  *   bit in the Interrupt Flag register is required before reading the
- *   RXDATA register.
+ *   RXDATA register.  When the RX LDMA channel owns RXDATA, the byte is
+ *   polled from the RX circular buffer instead.
  *
  * @param[in] leuart
  *   Defines the LEUART peripheral to access.
@@ -347,6 +571,12 @@ void leuart_app_transmit_byte(LEUART_TypeDef *leuart, uint8_t data_out){
  ******************************************************************************/
 uint8_t leuart_app_receive_byte(LEUART_TypeDef *leuart){
 	uint8_t leuart_data;
+	if (rx_ldma) {
+		// RXDATA is drained by the LDMA, poll the circular buffer instead
+		char rx_char;
+		while (!leuart_rx_read(leuart, &rx_char, 1));
+		return (uint8_t) rx_char;
+	}
 	while (!(leuart->IF & LEUART_IF_RXDATAV));
 	leuart_data = leuart->RXDATA;
 	return leuart_data;
@@ -381,15 +611,28 @@ void leuart_txbl(LEUART_STATE_MACHINE *leuart_state) {
 			break;
 		}
 		case TransferCharacters: {
+			bool sent = false;
+
 			if(leuart_state->count < leuart_state->length) {
-				leuart_state->leuart->TXDATA = leuart_state->string[leuart_state->count];
+				leuart_state->leuart->TXDATA = leuart_state->segments[leuart_state->segment].data[leuart_state->count];
 				leuart_state->count = leuart_state->count + 1;
 				leuart_state->state = TransferCharacters;
+				sent = true;
+			}
+			// Step to the next non-empty segment once this one is drained
+			while((leuart_state->count == leuart_state->length) && (leuart_state->segment + 1 < leuart_state->num_segments)) {
+				leuart_state->segment = leuart_state->segment + 1;
+				leuart_state->count = 0;
+				leuart_state->length = leuart_state->segments[leuart_state->segment].length;
 			}
 			if(leuart_state->count == leuart_state->length) {
 				LEUART_IntDisable(leuart_state->leuart, LEUART_IF_TXBL);
 				LEUART_IntEnable(leuart_state->leuart, LEUART_IF_TXC);
 				leuart_state->state = EndTransfer;
+				if(!sent) {
+					// Every segment was empty, no byte will raise TXC so the release still fires
+					leuart_state->leuart->IFS = LEUART_IFS_TXC;
+				}
 			}
 			break;
 		}
@@ -450,7 +693,64 @@ void leuart_txc(LEUART_STATE_MACHINE *leuart_state) {
 }
 
 
+/***************************************************************************//**
+* @brief
+*   handles the LDMA done interrupt of the transmit channel
+*
+* @details
+*      the last byte has been queued into TXDATA, so the TXC interrupt is enabled
+*      to release the buffers once it has been shifted out
+*
+* @note
+*   called from LDMA_IRQHandler
+*
+* @param[in] channel
+*   LDMA channel that completed
+*
+******************************************************************************/
+void leuart_tx_ldma_done(uint32_t channel) {
+	EFM_ASSERT(channel == LDMA_LEUART0_TX_CH);
+	EFM_ASSERT(leuart_state_struct.state == TransferCharacters);
 
+	leuart_state_struct.state = EndTransfer;
+	leuart_state_struct.leuart->IFC = LEUART_IFC_TXC;
+	LEUART_IntEnable(leuart_state_struct.leuart, LEUART_IF_TXC);
+}
 
 
+/***************************************************************************//**
+* @brief
+*   starts the receive LDMA channel
+*
+* @details
+*      a single descriptor that links to itself drains RXDATA into rx_buffer forever,
+*      without raising a done interrupt when it wraps
+*
+* @param[in] leuart
+*   LEUARTx (x based on what is calling this driver)
+*
+******************************************************************************/
+void leuart_rx_ldma_start(LEUART_TypeDef *leuart) {
+	LDMA_TransferCfg_t rx_cfg = LDMA_TRANSFER_CFG_PERIPHERAL(ldmaPeripheralSignal_LEUART0_RXDATAV);
+	LDMA_Descriptor_t desc = LDMA_DESCRIPTOR_LINKREL_P2M_BYTE(&leuart->RXDATA, rx_buffer, LEUART_RX_BUFFER_SIZE, 0);
+
+	desc.xfer.doneIfs = false;
+	rx_descriptor = desc;
+	rx_tail = 0;
+
+	LDMA_StartTransfer(LDMA_LEUART0_RX_CH, &rx_cfg, &rx_descriptor);
+}
+
 
+/***************************************************************************//**
+* @brief
+*   returns the index the RX LDMA channel writes next
+*
+* @details
+*      derived from the remaining transfer count of the self-linked descriptor
+*
+******************************************************************************/
+uint32_t leuart_rx_head(void) {
+	uint32_t remaining = LDMA_TransferRemainingCount(LDMA_LEUART0_RX_CH);
+	return (LEUART_RX_BUFFER_SIZE - remaining) % LEUART_RX_BUFFER_SIZE;
+}
@@ -0,0 +1,290 @@
+/**
+ * @file
+ * 	query.c
+ * @author
+ * 	Adam Chehadi
+ * @date
+ * 	05/18/2021
+ * @brief
+ *	Contains the time-series queries over the sample journal: last N records, records
+ *	between two sample times and min, max and mean over a range
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "query.h"
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+// Sparse time index, the key of the first record of each journal page
+typedef struct {
+	uint32_t				seq;		// page sequence number the key belongs to
+	bool					valid;
+	uint64_t				key;
+} QUERY_INDEX;
+
+static QUERY_INDEX			query_index[JOURNAL_PAGES];
+
+
+//***********************************************************************************
+// Private function prototypes
+//***********************************************************************************
+static bool query_record_key(uint32_t number, uint32_t end, uint64_t *key);
+static bool query_page_key(uint32_t seq, uint64_t *key);
+
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the time key of a journal record
+ *
+ ******************************************************************************/
+uint64_t query_key(const JOURNAL_RECORD *record) {
+	return QUERY_KEY(record->boot, record->time_ms);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Finds the first record at or after a sample time
+ *
+ * @details
+ * 	 A binary search over the per-page index picks the last page that starts at or
+ * 	 before key, reading one record per probed page and keeping it for the next query,
+ * 	 then a binary search inside that page finds the record.  A query touches
+ * 	 O(log pages) index entries and O(log records per page) records, never the pages
+ * 	 outside the answer.
+ *
+ * @param[in] key
+ *   sample time, see QUERY_KEY()
+ *
+ * @return
+ *   record number, journal_next() if every record is older
+ *
+ ******************************************************************************/
+uint32_t query_lower_bound(uint64_t key) {
+	uint32_t first_seq = journal_first() / JOURNAL_RECORDS_PER_PAGE;
+	uint32_t last_seq;
+	uint32_t lo;
+	uint32_t hi;
+	uint32_t mid;
+	uint32_t end = journal_next();
+	uint64_t mid_key;
+
+	if(end == journal_first()) {
+		return end;
+	}
+	last_seq = (end - 1) / JOURNAL_RECORDS_PER_PAGE;
+
+	// Last page whose first record is at or before key
+	lo = first_seq;
+	hi = last_seq;
+	while(lo < hi) {
+		mid = lo + (hi - lo + 1) / 2;
+		if(query_page_key(mid, &mid_key) && mid_key <= key) {
+			lo = mid;
+		} else {
+			hi = mid - 1;
+		}
+	}
+
+	// First record in the page, or at the start of the next one, not before key
+	lo = lo * JOURNAL_RECORDS_PER_PAGE;
+	if(lo < journal_first()) {
+		lo = journal_first();
+	}
+	hi = (lo / JOURNAL_RECORDS_PER_PAGE + 1) * JOURNAL_RECORDS_PER_PAGE;
+	if(hi > end) {
+		hi = end;
+	}
+	while(lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if(query_record_key(mid, hi, &mid_key) && mid_key < key) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the range of the last n records
+ *
+ * @param[in] n
+ *   number of records wanted, fewer are returned if the journal holds fewer
+ *
+ * @param[out] first
+ *   number of the first record
+ *
+ * @param[out] end
+ *   one past the number of the last record
+ *
+ ******************************************************************************/
+void query_last_n(uint32_t n, uint32_t *first, uint32_t *end) {
+	*end = journal_next();
+	*first = journal_first();
+	if(*end - *first > n) {
+		*first = *end - n;
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the range of records with sample times from one key up to another
+ *
+ * @param[in] from
+ *   first sample time included
+ *
+ * @param[in] to
+ *   first sample time excluded
+ *
+ * @param[out] first
+ *   number of the first record
+ *
+ * @param[out] end
+ *   one past the number of the last record, equal to first for an empty range
+ *
+ ******************************************************************************/
+void query_range(uint64_t from, uint64_t to, uint32_t *first, uint32_t *end) {
+	*first = query_lower_bound(from);
+	*end = (to > from) ? query_lower_bound(to) : *first;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Computes min, max and sum of one reading over a range of records
+ *
+ * @details
+ * 	 Records without the reading, or that fail their check, are left out of count.
+ *
+ * @param[in] first
+ *   number of the first record
+ *
+ * @param[in] end
+ *   one past the number of the last record
+ *
+ * @param[in] field
+ *   reading to aggregate
+ *
+ * @param[out] agg
+ *   aggregate, count is 0 if no record had the reading
+ *
+ ******************************************************************************/
+void query_aggregate(uint32_t first, uint32_t end, QUERY_FIELD field, QUERY_AGG *agg) {
+	JOURNAL_RECORD record;
+	int32_t value;
+
+	agg->count = 0;
+	agg->min = INT32_MAX;
+	agg->max = INT32_MIN;
+	agg->sum = 0;
+	agg->first = first;
+	agg->end = end;
+
+	for(uint32_t number = first; number < end; number++) {
+		if(!journal_read(number, &record)) {
+			continue;
+		}
+		if(field == QueryHumidity && (record.present & JOURNAL_HUMIDITY)) {
+			value = record.humidity;
+		} else if(field == QueryTemperature && (record.present & JOURNAL_TEMPERATURE)) {
+			value = record.temperature;
+		} else if(field == QueryLight && (record.present & JOURNAL_LIGHT)) {
+			value = (int32_t) record.light;
+		} else {
+			continue;
+		}
+
+		agg->count++;
+		agg->sum += value;
+		if(value < agg->min) {
+			agg->min = value;
+		}
+		if(value > agg->max) {
+			agg->max = value;
+		}
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the rounded mean of an aggregate, 0 if it is empty
+ *
+ ******************************************************************************/
+int32_t query_mean(const QUERY_AGG *agg) {
+	int64_t half = agg->count / 2;
+
+	if(!agg->count) {
+		return 0;
+	}
+	return (int32_t) ((agg->sum + (agg->sum < 0 ? -half : half)) / (int64_t) agg->count);
+}
+
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the key of a record, or of the next readable record before end
+ *
+ * @details
+ * 	 A record that failed its check is skipped so it does not break the search order.
+ *
+ ******************************************************************************/
+bool query_record_key(uint32_t number, uint32_t end, uint64_t *key) {
+	JOURNAL_RECORD record;
+
+	for(; number < end; number++) {
+		if(journal_read(number, &record)) {
+			*key = query_key(&record);
+			return true;
+		}
+	}
+	return false;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the key of the first record of a page through the index
+ *
+ * @details
+ * 	 Entries are filled the first time a page is probed and stay valid until the ring
+ * 	 reuses the page for a new sequence number.
+ *
+ ******************************************************************************/
+bool query_page_key(uint32_t seq, uint64_t *key) {
+	QUERY_INDEX *entry = &query_index[seq % JOURNAL_PAGES];
+	uint32_t first = seq * JOURNAL_RECORDS_PER_PAGE;
+	uint32_t end = first + JOURNAL_RECORDS_PER_PAGE;
+
+	if(!entry->valid || entry->seq != seq) {
+		if(first < journal_first()) {
+			first = journal_first();
+		}
+		if(end > journal_next()) {
+			end = journal_next();
+		}
+		if(!query_record_key(first, end, &entry->key)) {
+			return false;
+		}
+		entry->seq = seq;
+		entry->valid = true;
+	}
+	*key = entry->key;
+	return true;
+}
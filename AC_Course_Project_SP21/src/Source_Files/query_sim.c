@@ -0,0 +1,272 @@
+/**
+ * @file
+ * 	query_sim.c
+ * @author
+ * 	Adam Chehadi
+ * @date
+ * 	05/24/2021
+ * @brief
+ *	Contains the host test of the journal queries against a linear scan
+ *
+ * @details
+ *	Only built with QUERY_SIM defined, the firmware build compiles it to nothing.
+ *	From src:
+ *
+ *	gcc -DQUERY_SIM -IHost_Files -IHeader_Files Source_Files/query_sim.c Source_Files/query.c Source_Files/journal.c Source_Files/journal_sim.c -o query_sim
+ *
+ *	The journal runs on the mapped flash file of journal_sim.c.  Several boots fill
+ *	it past one lap of the ring, so the oldest pages have been reused and the sample
+ *	times restart at every boot count change, and the power is cut while a record is
+ *	programmed, so the last record is torn.  Random sample times are then looked up
+ *	with query_lower_bound() and compared with a scan of every record, once with the
+ *	torn record last and once after the next boot has appended behind it.  The
+ *	program returns non-zero if a lookup differs.
+ */
+
+#ifdef QUERY_SIM
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <stdio.h>
+#include <string.h>
+
+#include "query.h"
+#include "host_flash.h"
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+#define SIM_PATH				"query_sim.bin"
+#define SIM_PERIOD_MS			1800		// PWM_PER
+#define SIM_LOOKUPS				10000		// per round, two rounds
+
+static uint32_t		sim_time_ms;			// sample time of the next record, restarts every boot
+static uint32_t		sim_seed = 1;
+
+
+//***********************************************************************************
+// Private function prototypes
+//***********************************************************************************
+static void sim_boot(void);
+static void sim_append(uint32_t count);
+static uint32_t sim_random(void);
+static uint64_t sim_target(void);
+static uint32_t sim_linear(uint64_t key);
+static uint32_t sim_round(const char *name);
+
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Builds the journal and runs both rounds of lookups
+ *
+ * @return
+ *   0 if every lookup matched the scan
+ *
+ ******************************************************************************/
+int main(void) {
+	volatile bool cut = false;				// set across the longjmp()
+	volatile uint32_t failed = 0;
+
+	host_flash_open(SIM_PATH);
+	sim_boot();
+	sim_append(3000);
+	sim_boot();
+	sim_append(1500);
+	sim_boot();
+	sim_append(700);
+
+	// Power cut half way through the next record
+	host_flash_cut_after(2);
+	if(!setjmp(host_flash_cut)) {
+		sim_append(1);
+	} else {
+		cut = true;
+	}
+	sim_boot();
+
+	printf("records %lu to %lu, boot %u, power cut %s\n", (unsigned long) journal_first(),
+			(unsigned long) journal_next(), journal_boot_count(), cut ? "reached" : "MISSED");
+	if(!cut || journal_first() == 0) {
+		failed++;							// the ring must have wrapped and the last record be torn
+	}
+
+	failed += sim_round("torn record last");
+	sim_append(400);
+	failed += sim_round("after the next boot");
+
+	host_flash_close();
+	printf("%lu failed\n", (unsigned long) failed);
+	return failed ? 1 : 0;
+}
+
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Mounts the journal as a new boot, the sample times restart
+ *
+ ******************************************************************************/
+void sim_boot(void) {
+	journal_open();
+	sim_time_ms = 0;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Appends records one sample period apart, flushing each
+ *
+ ******************************************************************************/
+void sim_append(uint32_t count) {
+	JOURNAL_RECORD record;
+
+	for(uint32_t i = 0; i < count; i++) {
+		memset(&record, 0, sizeof(record));
+		record.time_ms = sim_time_ms;
+		record.humidity = (int16_t) (450 + i % 50);
+		record.present = JOURNAL_HUMIDITY;
+		journal_append(&record);
+		journal_flush();
+		sim_time_ms += SIM_PERIOD_MS;
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns a pseudo random number, the same sequence every run
+ *
+ ******************************************************************************/
+uint32_t sim_random(void) {
+	sim_seed = sim_seed * 1664525 + 1013904223;
+	return sim_seed >> 8;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Picks a sample time to look up
+ *
+ * @details
+ *   Mostly the time of a record, or just either side of one, and otherwise a time
+ *   between two records, past the end of a boot or outside the journal.
+ *
+ ******************************************************************************/
+uint64_t sim_target(void) {
+	JOURNAL_RECORD record;
+	uint32_t span = journal_next() - journal_first();
+	uint32_t pick = sim_random() % 8;
+	uint64_t key;
+
+	if(pick == 0) {
+		return 0;
+	}
+	if(pick == 1) {
+		return QUERY_KEY(journal_boot_count() + (sim_random() % 2), sim_random() % (4000 * SIM_PERIOD_MS));
+	}
+	if(!journal_read(journal_first() + sim_random() % span, &record)) {
+		return QUERY_KEY(journal_boot_count(), 0);
+	}
+	key = query_key(&record);
+	switch(pick) {
+		case 2:
+			return key - 1;
+		case 3:
+			return key + 1;
+		case 4:
+			return key + SIM_PERIOD_MS / 2;
+		case 5:
+			return QUERY_KEY(record.boot, 0xFFFFFFFF);		// past the last record of its boot
+		default:
+			return key;
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Finds the first readable record at or after a sample time by reading them all
+ *
+ ******************************************************************************/
+uint32_t sim_linear(uint64_t key) {
+	JOURNAL_RECORD record;
+
+	for(uint32_t number = journal_first(); number < journal_next(); number++) {
+		if(journal_read(number, &record) && query_key(&record) >= key) {
+			return number;
+		}
+	}
+	return journal_next();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Compares query_lower_bound() with the scan on random sample times
+ *
+ * @details
+ *   The search may stop on records that failed their check just before the one the
+ *   scan finds, anything else is a mismatch.  query_range() is checked the same way
+ *   between two of the times.
+ *
+ * @param[in] name
+ *   name of the round
+ *
+ * @return
+ *   lookups that did not match
+ *
+ ******************************************************************************/
+uint32_t sim_round(const char *name) {
+	JOURNAL_RECORD record;
+	uint64_t key;
+	uint64_t to;
+	uint32_t found;
+	uint32_t expect;
+	uint32_t first;
+	uint32_t end;
+	uint32_t mismatched = 0;
+	uint32_t torn = 0;
+
+	for(uint32_t i = 0; i < SIM_LOOKUPS; i++) {
+		key = sim_target();
+		found = query_lower_bound(key);
+		expect = sim_linear(key);
+
+		if(found > expect) {
+			mismatched++;
+			continue;
+		}
+		for(uint32_t number = found; number < expect; number++) {
+			if(journal_read(number, &record)) {
+				mismatched++;
+				break;
+			}
+		}
+		if(found < expect) {
+			torn++;
+		}
+
+		to = sim_target();
+		query_range(key, to, &first, &end);
+		if(to > key && sim_linear(to) < end) {
+			mismatched++;
+		}
+		if(first != found) {
+			mismatched++;
+		}
+	}
+	printf("%s: %lu lookups, %lu mismatched, %lu stopped on a torn record\n", name,
+			(unsigned long) SIM_LOOKUPS, (unsigned long) mismatched, (unsigned long) torn);
+	return mismatched;
+}
+
+#endif
@@ -0,0 +1,192 @@
+/**
+ * @file
+ * 	rate_ctrl.c
+ * @author
+ * 	Adam Chehadi
+ * @date
+ * 	05/07/2021
+ * @brief
+ *	Contains the adaptive sample rate controller
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "rate_ctrl.h"
+
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Initializes an adaptive rate controller
+ *
+ * @details
+ * 	 The controller starts at the minimum (fastest) period.  While every channel stays
+ * 	 inside its threshold the period is doubled after each run of stable_needed samples,
+ * 	 up to max_period_ms.  Any channel moving past its threshold snaps the period back
+ * 	 to min_period_ms.
+ *
+ * @param[in] ctrl
+ *   controller state
+ *
+ * @param[in] min_period_ms
+ *   fastest sample period
+ *
+ * @param[in] max_period_ms
+ *   slowest sample period
+ *
+ * @param[in] stable_needed
+ *   number of consecutive stable samples before the period is stretched
+ *
+ ******************************************************************************/
+void rate_ctrl_init(RATE_CTRL *ctrl, uint32_t min_period_ms, uint32_t max_period_ms, uint32_t stable_needed) {
+	EFM_ASSERT(min_period_ms <= max_period_ms);
+
+	ctrl->min_period_ms = min_period_ms;
+	ctrl->max_period_ms = max_period_ms;
+	ctrl->period_ms = min_period_ms;
+	ctrl->stable_needed = stable_needed;
+	ctrl->stable_count = 0;
+	ctrl->changed = false;
+
+	for(uint32_t i = 0; i < RATE_CTRL_MAX_CH; i++) {
+		ctrl->ch[i].abs_threshold = 0;
+		ctrl->ch[i].rel_threshold_pct = 0;
+		ctrl->ch[i].has_last = false;
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Sets the change thresholds of one channel
+ *
+ * @param[in] ctrl
+ *   controller state
+ *
+ * @param[in] ch
+ *   channel index, less than RATE_CTRL_MAX_CH
+ *
+ * @param[in] abs_threshold
+ *   absolute change, in channel units, that counts as a fast change
+ *
+ * @param[in] rel_threshold_pct
+ *   relative change, in percent of the last value, that counts as a fast change
+ *
+ ******************************************************************************/
+void rate_ctrl_channel_set(RATE_CTRL *ctrl, uint32_t ch, int32_t abs_threshold, uint32_t rel_threshold_pct) {
+	EFM_ASSERT(ch < RATE_CTRL_MAX_CH);
+
+	ctrl->ch[ch].abs_threshold = abs_threshold;
+	ctrl->ch[ch].rel_threshold_pct = rel_threshold_pct;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Records a new reading of one channel
+ *
+ * @details
+ * 	 The reading is compared to the last reading of the same channel.  The larger of
+ * 	 the absolute and relative thresholds decides whether it counts as a fast change.
+ *
+ * @param[in] ctrl
+ *   controller state
+ *
+ * @param[in] ch
+ *   channel index
+ *
+ * @param[in] value
+ *   reading in fixed point channel units
+ *
+ ******************************************************************************/
+void rate_ctrl_observe(RATE_CTRL *ctrl, uint32_t ch, int32_t value) {
+	RATE_CTRL_CH *chan;
+
+	EFM_ASSERT(ch < RATE_CTRL_MAX_CH);
+	chan = &ctrl->ch[ch];
+
+	if(chan->has_last && rate_ctrl_excess(chan->last_value, value, chan->abs_threshold, chan->rel_threshold_pct) > 0) {
+		ctrl->changed = true;
+	}
+
+	chan->last_value = value;
+	chan->has_last = true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Measures how far a reading moved past its band
+ *
+ * @details
+ * 	 The band is the larger of an absolute band and a percentage of the reference's
+ * 	 magnitude.  Shared by the rate controller's change thresholds and the report
+ * 	 filter's deadbands so both treat a channel's units the same way.
+ *
+ * @param[in] reference
+ *   reading the move is measured from
+ *
+ * @param[in] value
+ *   new reading
+ *
+ * @param[in] abs_band
+ *   absolute band in channel units
+ *
+ * @param[in] rel_band_pct
+ *   relative band in percent of the reference, 0 for none
+ *
+ * @return
+ *   the move less the band, positive past the band, 0 on its edge
+ *
+ ******************************************************************************/
+int32_t rate_ctrl_excess(int32_t reference, int32_t value, int32_t abs_band, uint32_t rel_band_pct) {
+	int32_t delta = value - reference;
+	int32_t magnitude = reference < 0 ? -reference : reference;
+	int32_t band;
+
+	if(delta < 0) {
+		delta = -delta;
+	}
+	band = (int32_t) (((int64_t) magnitude * rel_band_pct) / 100);
+	if(band < abs_band) {
+		band = abs_band;
+	}
+	return delta - band;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Closes one sample and computes the next period
+ *
+ * @details
+ * 	 Called once every channel of a sample has been observed.
+ *
+ * @param[in] ctrl
+ *   controller state
+ *
+ * @return
+ *   true if period_ms changed and the LETIMER must be reprogrammed
+ *
+ ******************************************************************************/
+bool rate_ctrl_update(RATE_CTRL *ctrl) {
+	uint32_t old_period = ctrl->period_ms;
+
+	if(ctrl->changed) {
+		ctrl->period_ms = ctrl->min_period_ms;
+		ctrl->stable_count = 0;
+	} else if(++ctrl->stable_count >= ctrl->stable_needed) {
+		ctrl->stable_count = 0;
+		ctrl->period_ms = ctrl->period_ms * 2;
+		if(ctrl->period_ms > ctrl->max_period_ms) {
+			ctrl->period_ms = ctrl->max_period_ms;
+		}
+	}
+	ctrl->changed = false;
+
+	return ctrl->period_ms != old_period;
+}
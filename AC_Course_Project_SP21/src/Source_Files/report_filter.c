@@ -0,0 +1,119 @@
+/**
+ * @file
+ * 	report_filter.c
+ * @author
+ * 	Adam Chehadi
+ * @date
+ * 	05/20/2021
+ * @brief
+ *	Contains the report-on-change filter, per-channel deadbands with a heartbeat
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "report_filter.h"
+#include "rate_ctrl.h"
+
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Initializes a report filter
+ *
+ * @details
+ * 	 Every channel starts without a deadband, so every reading is reported until
+ * 	 report_filter_channel_set() gives it one.
+ *
+ * @param[in] filter
+ *   filter state
+ *
+ * @param[in] max_silence_ms
+ *   longest time a channel goes without a report, 0 for no heartbeat
+ *
+ ******************************************************************************/
+void report_filter_init(REPORT_FILTER *filter, uint32_t max_silence_ms) {
+	filter->max_silence_ms = max_silence_ms;
+	filter->passed = 0;
+	filter->suppressed = 0;
+
+	for(uint32_t i = 0; i < REPORT_FILTER_MAX_CH; i++) {
+		filter->ch[i].abs_band = 0;
+		filter->ch[i].rel_band_pct = 0;
+		filter->ch[i].has_reported = false;
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Sets the deadband of one channel
+ *
+ * @param[in] filter
+ *   filter state
+ *
+ * @param[in] ch
+ *   channel index, less than REPORT_FILTER_MAX_CH
+ *
+ * @param[in] abs_band
+ *   absolute change, in channel units, that is reported
+ *
+ * @param[in] rel_band_pct
+ *   relative change, in percent of the last reported value, that is reported
+ *
+ ******************************************************************************/
+void report_filter_channel_set(REPORT_FILTER *filter, uint32_t ch, int32_t abs_band, uint32_t rel_band_pct) {
+	EFM_ASSERT(ch < REPORT_FILTER_MAX_CH);
+
+	filter->ch[ch].abs_band = abs_band;
+	filter->ch[ch].rel_band_pct = rel_band_pct;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Decides whether a reading is reported
+ *
+ * @details
+ * 	 The reading is compared to the last reported value of the channel, not the last
+ * 	 reading, so a slow drift is still reported once it adds up to the band.  The larger
+ * 	 of the absolute and relative bands applies.  The first reading of a channel and a
+ * 	 reading max_silence_ms after the last report are always reported.
+ *
+ * @param[in] filter
+ *   filter state
+ *
+ * @param[in] ch
+ *   channel index
+ *
+ * @param[in] value
+ *   reading in fixed point channel units
+ *
+ * @param[in] time_ms
+ *   time of the reading
+ *
+ * @return
+ *   true if the reading is to be reported, it becomes the channel's reported value
+ *
+ ******************************************************************************/
+bool report_filter_check(REPORT_FILTER *filter, uint32_t ch, int32_t value, uint64_t time_ms) {
+	REPORT_FILTER_CH *chan;
+
+	EFM_ASSERT(ch < REPORT_FILTER_MAX_CH);
+	chan = &filter->ch[ch];
+
+	if(chan->has_reported && (!filter->max_silence_ms || time_ms - chan->reported_ms < filter->max_silence_ms)
+			&& rate_ctrl_excess(chan->reported, value, chan->abs_band, chan->rel_band_pct) < 0) {
+		filter->suppressed++;
+		return false;
+	}
+
+	chan->reported = value;
+	chan->reported_ms = time_ms;
+	chan->has_reported = true;
+	filter->passed++;
+	return true;
+}
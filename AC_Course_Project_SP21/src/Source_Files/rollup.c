@@ -0,0 +1,209 @@
+/**
+ * @file
+ * 	rollup.c
+ * @author
+ * 	Adam Chehadi
+ * @date
+ * 	05/19/2021
+ * @brief
+ *	Contains the per-minute, per-hour and per-day rollups of the readings, updated in
+ *	constant time as each reading arrives
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "rollup.h"
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+static ROLLUP_BUCKET	minute_ring[ROLLUP_MINUTE_DEPTH];
+static ROLLUP_BUCKET	hour_ring[ROLLUP_HOUR_DEPTH];
+static ROLLUP_BUCKET	day_ring[ROLLUP_DAY_DEPTH];
+
+static ROLLUP_TIER		tiers[RollupTiers] = {
+	{ 60000,	ROLLUP_MINUTE_DEPTH,	minute_ring },
+	{ 3600000,	ROLLUP_HOUR_DEPTH,		hour_ring },
+	{ 86400000,	ROLLUP_DAY_DEPTH,		day_ring }
+};
+
+
+//***********************************************************************************
+// Private function prototypes
+//***********************************************************************************
+static void rollup_bucket_start(ROLLUP_BUCKET *bucket, uint32_t index);
+static bool rollup_advance(ROLLUP_TIER *tier, uint32_t index);
+
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Clears every rollup tier
+ *
+ ******************************************************************************/
+void rollup_open(void) {
+	for(uint32_t t = 0; t < RollupTiers; t++) {
+		tiers[t].head = 0;
+		tiers[t].closed = 0;
+		tiers[t].started = false;
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Adds one reading to every tier
+ *
+ * @details
+ * 	 A reading past the end of a tier's open bucket first closes it into the tier's
+ * 	 ring, then min, max, sum, count and last are updated in place.  The work per
+ * 	 reading is the same however long the tiers are, and buckets without any reading
+ * 	 are not stored, the bucket index shows the gap.
+ *
+ * @param[in] ch
+ *   channel, less than ROLLUP_MAX_CH
+ *
+ * @param[in] value
+ *   reading in the channel's fixed point units
+ *
+ * @param[in] time_ms
+ *   time of the reading, never earlier than the previous one
+ *
+ * @return
+ *   bit (1 << ROLLUP_TIER_ID) set for every tier that closed a bucket
+ *
+ ******************************************************************************/
+uint32_t rollup_add(uint32_t ch, int32_t value, uint64_t time_ms) {
+	ROLLUP_STAT *stat;
+	uint32_t closed = 0;
+
+	EFM_ASSERT(ch < ROLLUP_MAX_CH);
+
+	for(uint32_t t = 0; t < RollupTiers; t++) {
+		if(rollup_advance(&tiers[t], (uint32_t) (time_ms / tiers[t].period_ms))) {
+			closed |= 1 << t;
+		}
+
+		stat = &tiers[t].open.ch[ch];
+		if(stat->count == 0 || value < stat->min) {
+			stat->min = value;
+		}
+		if(stat->count == 0 || value > stat->max) {
+			stat->max = value;
+		}
+		stat->last = value;
+		stat->sum += value;
+		stat->count++;
+	}
+	return closed;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns a bucket of a tier
+ *
+ * @param[in] tier
+ *   tier to read
+ *
+ * @param[in] age
+ *   0 for the open bucket, 1 for the last closed one and so on
+ *
+ * @return
+ *   the bucket, 0 if the tier does not hold one that old
+ *
+ ******************************************************************************/
+const ROLLUP_BUCKET *rollup_get(ROLLUP_TIER_ID tier, uint32_t age) {
+	ROLLUP_TIER *t;
+
+	EFM_ASSERT(tier < RollupTiers);
+	t = &tiers[tier];
+
+	if(!t->started) {
+		return 0;
+	}
+	if(age == 0) {
+		return &t->open;
+	}
+	if(age > t->closed) {
+		return 0;
+	}
+	return &t->ring[(t->head + t->depth - age) % t->depth];
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the bucket length of a tier in milliseconds
+ *
+ ******************************************************************************/
+uint32_t rollup_tier_ms(ROLLUP_TIER_ID tier) {
+	EFM_ASSERT(tier < RollupTiers);
+	return tiers[tier].period_ms;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the rounded mean of a channel over a bucket, 0 if it is empty
+ *
+ ******************************************************************************/
+int32_t rollup_mean(const ROLLUP_STAT *stat) {
+	int64_t half = stat->count / 2;
+
+	if(!stat->count) {
+		return 0;
+	}
+	return (int32_t) ((stat->sum + (stat->sum < 0 ? -half : half)) / (int64_t) stat->count);
+}
+
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Clears a bucket for a new bucket index
+ *
+ ******************************************************************************/
+void rollup_bucket_start(ROLLUP_BUCKET *bucket, uint32_t index) {
+	bucket->index = index;
+	for(uint32_t ch = 0; ch < ROLLUP_MAX_CH; ch++) {
+		bucket->ch[ch].count = 0;
+		bucket->ch[ch].sum = 0;
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Moves a tier's open bucket forward to a bucket index
+ *
+ * @return
+ *   true if a bucket was closed into the ring
+ *
+ ******************************************************************************/
+bool rollup_advance(ROLLUP_TIER *tier, uint32_t index) {
+	if(!tier->started) {
+		rollup_bucket_start(&tier->open, index);
+		tier->started = true;
+		return false;
+	}
+	if(index <= tier->open.index) {
+		return false;
+	}
+
+	tier->ring[tier->head] = tier->open;
+	tier->head = (tier->head + 1) % tier->depth;
+	if(tier->closed < tier->depth) {
+		tier->closed++;
+	}
+	rollup_bucket_start(&tier->open, index);
+	return true;
+}
@@ -0,0 +1,261 @@
+/**
+ * @file
+ * 	sample_codec.c
+ * @author
+ * 	Adam Chehadi
+ * @date
+ * 	05/20/2021
+ * @brief
+ *	Contains the streaming delta codec of sample batches, delta-of-delta timestamps and
+ *	zig-zag varint deltas per channel, and its decoder
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "sample_codec.h"
+
+
+//***********************************************************************************
+// Private function prototypes
+//***********************************************************************************
+static uint32_t codec_put_varint(uint8_t *out, uint64_t value);
+static uint32_t codec_get_varint(const uint8_t *in, uint32_t len, uint64_t *value);
+static uint64_t codec_zigzag(int64_t value);
+static int64_t codec_unzigzag(uint64_t value);
+
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Starts a new stream
+ *
+ * @details
+ * 	 Every stream is decoded from its own reset, so a frame that is lost only takes
+ * 	 its own samples with it.
+ *
+ * @param[in] state
+ *   stream state
+ *
+ * @param[in] channels
+ *   channels carried by every sample, at most CODEC_MAX_CH
+ *
+ ******************************************************************************/
+void codec_reset(CODEC_STATE *state, uint32_t channels) {
+	state->channels = channels < CODEC_MAX_CH ? channels : CODEC_MAX_CH;
+	state->time_ms = 0;
+	state->delta_ms = 0;
+	state->present = 0;
+	for(uint32_t ch = 0; ch < CODEC_MAX_CH; ch++) {
+		state->value[ch] = 0;
+	}
+	state->samples = 0;
+	state->bytes = 0;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Packs one sample
+ *
+ * @details
+ * 	 The sample starts with the varint of (zig-zag(time step - previous time step) << 1),
+ * 	 its low bit set when the channel mask differs from the previous sample's, in which
+ * 	 case the mask byte follows.  Then comes the zig-zag varint of the change of every
+ * 	 present channel since its last value.  A steady sample period and slow readings
+ * 	 pack into one byte per field.
+ *
+ * @note
+ *   Sample times must not be more than 2^61 ms apart.
+ *
+ * @param[in] state
+ *   stream state
+ *
+ * @param[in] time_ms
+ *   time of the sample
+ *
+ * @param[in] present
+ *   bit (1 << channel) of every channel the sample holds
+ *
+ * @param[in] value
+ *   one value per channel, only the present ones are read
+ *
+ * @param[out] out
+ *   at least CODEC_MAX_SAMPLE_BYTES
+ *
+ * @return
+ *   bytes written
+ *
+ ******************************************************************************/
+uint32_t codec_encode(CODEC_STATE *state, uint64_t time_ms, uint8_t present, const int32_t *value, uint8_t *out) {
+	int64_t delta_ms = (int64_t) (time_ms - state->time_ms);
+	bool mask_changed = present != state->present;
+	uint32_t len;
+
+	len = codec_put_varint(out, (codec_zigzag(delta_ms - state->delta_ms) << 1) | mask_changed);
+	if(mask_changed) {
+		out[len++] = present;
+	}
+
+	for(uint32_t ch = 0; ch < state->channels; ch++) {
+		if(present & (1 << ch)) {
+			len += codec_put_varint(&out[len], codec_zigzag((int64_t) value[ch] - state->value[ch]));
+			state->value[ch] = value[ch];
+		}
+	}
+
+	state->time_ms = time_ms;
+	state->delta_ms = delta_ms;
+	state->present = present;
+	state->samples++;
+	state->bytes += len;
+	return len;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Unpacks one sample
+ *
+ * @details
+ * 	 The exact inverse of codec_encode() on a state reset with the same channels.  The
+ * 	 file only depends on stdint.h and stdbool.h so the phone or PC side decodes the
+ * 	 frames with this same function.
+ *
+ * @param[in] state
+ *   stream state
+ *
+ * @param[in] in
+ *   packed bytes from the start of a sample
+ *
+ * @param[in] len
+ *   bytes available at in
+ *
+ * @param[out] time_ms
+ *   time of the sample
+ *
+ * @param[out] present
+ *   channel mask of the sample
+ *
+ * @param[out] value
+ *   one value per channel, absent channels hold their last value
+ *
+ * @return
+ *   bytes consumed, 0 if the sample is cut short or malformed and the state is unchanged
+ *
+ ******************************************************************************/
+uint32_t codec_decode(CODEC_STATE *state, const uint8_t *in, uint32_t len, uint64_t *time_ms, uint8_t *present, int32_t *value) {
+	int32_t next[CODEC_MAX_CH];
+	uint64_t field;
+	uint32_t used;
+	uint32_t pos;
+	int64_t delta_ms;
+	uint8_t mask = state->present;
+
+	pos = codec_get_varint(in, len, &field);
+	if(!pos) {
+		return 0;
+	}
+	delta_ms = state->delta_ms + codec_unzigzag(field >> 1);
+	if(field & 1) {
+		if(pos >= len) {
+			return 0;
+		}
+		mask = in[pos++];
+	}
+
+	for(uint32_t ch = 0; ch < state->channels; ch++) {
+		next[ch] = state->value[ch];
+		if(mask & (1 << ch)) {
+			used = codec_get_varint(&in[pos], len - pos, &field);
+			if(!used) {
+				return 0;
+			}
+			next[ch] = (int32_t) ((int64_t) state->value[ch] + codec_unzigzag(field));
+			pos += used;
+		}
+	}
+
+	for(uint32_t ch = 0; ch < state->channels; ch++) {
+		state->value[ch] = next[ch];
+		value[ch] = next[ch];
+	}
+	state->time_ms += (uint64_t) delta_ms;
+	state->delta_ms = delta_ms;
+	state->present = mask;
+	state->samples++;
+	state->bytes += pos;
+
+	*time_ms = state->time_ms;
+	*present = mask;
+	return pos;
+}
+
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Writes a LEB128 varint, 7 bits per byte with the top bit set on all but the last
+ *
+ * @return
+ *   bytes written, at most CODEC_VARINT_MAX_64
+ *
+ ******************************************************************************/
+uint32_t codec_put_varint(uint8_t *out, uint64_t value) {
+	uint32_t len = 0;
+
+	while(value >= 0x80) {
+		out[len++] = (uint8_t) (value | 0x80);
+		value >>= 7;
+	}
+	out[len++] = (uint8_t) value;
+	return len;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Reads a LEB128 varint
+ *
+ * @return
+ *   bytes read, 0 if it runs past len or past CODEC_VARINT_MAX_64 bytes
+ *
+ ******************************************************************************/
+uint32_t codec_get_varint(const uint8_t *in, uint32_t len, uint64_t *value) {
+	uint64_t result = 0;
+
+	for(uint32_t i = 0; i < len && i < CODEC_VARINT_MAX_64; i++) {
+		result |= (uint64_t) (in[i] & 0x7F) << (7 * i);
+		if(!(in[i] & 0x80)) {
+			*value = result;
+			return i + 1;
+		}
+	}
+	return 0;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Maps signed to unsigned so small changes of either sign stay small: 0, -1, 1, -2...
+ *
+ ******************************************************************************/
+uint64_t codec_zigzag(int64_t value) {
+	return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Inverse of codec_zigzag()
+ *
+ ******************************************************************************/
+int64_t codec_unzigzag(uint64_t value) {
+	return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+}
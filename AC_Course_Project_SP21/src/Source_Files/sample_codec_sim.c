@@ -0,0 +1,344 @@
+/**
+ * @file
+ * 	sample_codec_sim.c
+ * @author
+ * 	Adam Chehadi
+ * @date
+ * 	05/24/2021
+ * @brief
+ *	Contains the host decoder of #PACK frames and the packing ratio of a sample trace
+ *
+ * @details
+ *	Only built with SAMPLE_CODEC_SIM defined, the firmware build compiles it to nothing.
+ *	From src:
+ *
+ *	gcc -DSAMPLE_CODEC_SIM -IHost_Files -IHeader_Files Source_Files/sample_codec_sim.c Source_Files/sample_codec.c -o sample_codec_sim
+ *
+ *	./sample_codec_sim [trace]
+ *		Packs a trace of "number,boot,ms,rh x10,F x10,lux" lines, the #LAST format, into
+ *		frames the way app_packed_frame() does, decodes them again with codec_decode()
+ *		and checks every record came back.  Prints the packing ratio against the text
+ *		lines and returns non-zero on a mismatch.  The default trace is
+ *		Host_Files/sample_trace.csv.
+ *
+ *	./sample_codec_sim -p capture
+ *		Decodes a capture of the bytes a #PACK answer sent and prints the records as
+ *		#LAST lines.  Records the journal skipped for a failed check leave no gap, so
+ *		the numbers after one are counted from the frame header.
+ */
+
+#ifdef SAMPLE_CODEC_SIM
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sample_codec.h"
+#include "journal.h"
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+#define SIM_TRACE				"Host_Files/sample_trace.csv"
+#define SIM_RECORDS_MAX			20000
+#define SIM_PACKED_MAX			(2048 - 48)		// packed bytes per frame, app_packed_frame()
+#define SIM_CHANNELS			3				// humidity, temperature and light
+#define SIM_HEADER_MAX			48
+
+typedef struct {
+	uint32_t		number;
+	JOURNAL_RECORD	record;
+} SIM_RECORD;
+
+static SIM_RECORD	sim_trace[SIM_RECORDS_MAX];
+static SIM_RECORD	sim_decoded[SIM_RECORDS_MAX];
+static uint8_t		sim_frames[SIM_RECORDS_MAX * (CODEC_MAX_SAMPLE_BYTES + SIM_HEADER_MAX)];
+
+
+//***********************************************************************************
+// Private function prototypes
+//***********************************************************************************
+static uint32_t sim_read_trace(const char *path, uint32_t *text_bytes);
+static uint32_t sim_pack(const SIM_RECORD *trace, uint32_t count, uint8_t *frames, uint32_t *num_frames);
+static uint32_t sim_unpack(const uint8_t *frames, uint32_t len, SIM_RECORD *out);
+static uint32_t sim_line(char *line, const SIM_RECORD *record);
+static bool sim_same(const SIM_RECORD *a, const SIM_RECORD *b);
+
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Round trip and ratio of a trace, or decode of a #PACK capture
+ *
+ * @return
+ *   0 if every record came back
+ *
+ ******************************************************************************/
+int main(int argc, char **argv) {
+	char line[80];
+	uint32_t count;
+	uint32_t decoded;
+	uint32_t text_bytes = 0;
+	uint32_t packed_bytes;
+	uint32_t num_frames = 0;
+	uint32_t mismatched = 0;
+	FILE *file;
+
+	if(argc > 2 && !strcmp(argv[1], "-p")) {
+		file = fopen(argv[2], "rb");
+		if(!file) {
+			perror(argv[2]);
+			return 1;
+		}
+		packed_bytes = (uint32_t) fread(sim_frames, 1, sizeof(sim_frames), file);
+		fclose(file);
+		decoded = sim_unpack(sim_frames, packed_bytes, sim_decoded);
+		for(uint32_t i = 0; i < decoded; i++) {
+			sim_line(line, &sim_decoded[i]);
+			fputs(line, stdout);
+		}
+		return 0;
+	}
+
+	count = sim_read_trace(argc > 1 ? argv[1] : SIM_TRACE, &text_bytes);
+	if(!count) {
+		return 1;
+	}
+	packed_bytes = sim_pack(sim_trace, count, sim_frames, &num_frames);
+	decoded = sim_unpack(sim_frames, packed_bytes, sim_decoded);
+
+	for(uint32_t i = 0; i < count; i++) {
+		if(i >= decoded || !sim_same(&sim_trace[i], &sim_decoded[i])) {
+			mismatched++;
+		}
+	}
+
+	printf("%lu records, %lu decoded, %lu mismatched\n", (unsigned long) count, (unsigned long) decoded,
+			(unsigned long) mismatched);
+	printf("text %lu bytes, journal %lu bytes, packed %lu bytes in %lu frames, headers included\n",
+			(unsigned long) text_bytes, (unsigned long) (count * sizeof(JOURNAL_RECORD)),
+			(unsigned long) packed_bytes, (unsigned long) num_frames);
+	printf("%.2f bytes per record, ratio %.2f against text and %.2f against the journal\n",
+			(double) packed_bytes / count, (double) text_bytes / packed_bytes,
+			(double) count * sizeof(JOURNAL_RECORD) / packed_bytes);
+	return (mismatched || decoded != count) ? 1 : 0;
+}
+
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Reads a trace of #LAST lines, an empty field is a reading not taken
+ *
+ * @param[in] path
+ *   trace file
+ *
+ * @param[out] text_bytes
+ *   size of the lines, newlines included
+ *
+ * @return
+ *   records read, 0 on an error
+ *
+ ******************************************************************************/
+uint32_t sim_read_trace(const char *path, uint32_t *text_bytes) {
+	static const uint8_t bit[SIM_CHANNELS] = { JOURNAL_HUMIDITY, JOURNAL_TEMPERATURE, JOURNAL_LIGHT };
+	char line[128];
+	char *field[6];
+	char *pos;
+	uint32_t count = 0;
+	SIM_RECORD *out;
+	FILE *file = fopen(path, "r");
+
+	if(!file) {
+		perror(path);
+		return 0;
+	}
+	while(count < SIM_RECORDS_MAX && fgets(line, sizeof(line), file)) {
+		*text_bytes += strlen(line);
+		pos = line;
+		for(uint32_t i = 0; i < 6; i++) {
+			field[i] = pos;
+			pos += strcspn(pos, ",\r\n");
+			if(*pos) {
+				*pos++ = '\0';
+			}
+		}
+
+		out = &sim_trace[count++];
+		memset(out, 0, sizeof(*out));
+		out->number = strtoul(field[0], NULL, 10);
+		out->record.boot = (uint8_t) strtoul(field[1], NULL, 10);
+		out->record.time_ms = strtoul(field[2], NULL, 10);
+		for(uint32_t ch = 0; ch < SIM_CHANNELS; ch++) {
+			if(*field[3 + ch]) {
+				out->record.present |= bit[ch];
+			}
+		}
+		out->record.humidity = (int16_t) strtol(field[3], NULL, 10);
+		out->record.temperature = (int16_t) strtol(field[4], NULL, 10);
+		out->record.light = strtoul(field[5], NULL, 10);
+	}
+	fclose(file);
+	return count;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Packs records into #PACK frames
+ *
+ * @details
+ *   As app_packed_frame(): a "PACK number,boot,records,bytes" line and the records
+ *   of one boot packed as a stream of their own, up to SIM_PACKED_MAX bytes.
+ *
+ * @return
+ *   bytes of all frames
+ *
+ ******************************************************************************/
+uint32_t sim_pack(const SIM_RECORD *trace, uint32_t count, uint8_t *frames, uint32_t *num_frames) {
+	static uint8_t packed[SIM_PACKED_MAX];
+	CODEC_STATE codec;
+	int32_t value[SIM_CHANNELS];
+	uint32_t total = 0;
+	uint32_t len;
+	uint32_t i = 0;
+	uint32_t first;
+
+	while(i < count) {
+		codec_reset(&codec, SIM_CHANNELS);
+		first = i;
+		len = 0;
+		while(i < count && trace[i].record.boot == trace[first].record.boot && len + CODEC_MAX_SAMPLE_BYTES <= sizeof(packed)) {
+			value[0] = trace[i].record.humidity;
+			value[1] = trace[i].record.temperature;
+			value[2] = (int32_t) trace[i].record.light;
+			len += codec_encode(&codec, trace[i].record.time_ms, trace[i].record.present, value, &packed[len]);
+			i++;
+		}
+		total += sprintf((char *) &frames[total], "PACK %lu,%ld,%lu,%lu\n", (unsigned long) trace[first].number,
+				(long) trace[first].record.boot, (unsigned long) codec.samples, (unsigned long) len);
+		memcpy(&frames[total], packed, len);
+		total += len;
+		(*num_frames)++;
+	}
+	return total;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Decodes #PACK frames
+ *
+ * @details
+ *   Bytes outside a frame, the text lines around a #PACK answer, are skipped.
+ *
+ * @return
+ *   records decoded
+ *
+ ******************************************************************************/
+uint32_t sim_unpack(const uint8_t *frames, uint32_t len, SIM_RECORD *out) {
+	CODEC_STATE codec;
+	unsigned long first;
+	long boot;
+	unsigned long records;
+	unsigned long bytes;
+	uint64_t time_ms;
+	uint8_t present;
+	int32_t value[SIM_CHANNELS];
+	uint32_t pos = 0;
+	uint32_t used;
+	uint32_t count = 0;
+	const uint8_t *eol;
+
+	while(pos < len) {
+		eol = memchr(&frames[pos], '\n', len - pos);
+		if(!eol) {
+			break;
+		}
+		if(sscanf((const char *) &frames[pos], "PACK %lu,%ld,%lu,%lu", &first, &boot, &records, &bytes) != 4) {
+			pos = (uint32_t) (eol - frames) + 1;
+			continue;
+		}
+		pos = (uint32_t) (eol - frames) + 1;
+		if(bytes > len - pos) {
+			break;
+		}
+
+		codec_reset(&codec, SIM_CHANNELS);
+		for(uint32_t i = 0; i < records && count < SIM_RECORDS_MAX; i++) {
+			used = codec_decode(&codec, &frames[pos], (uint32_t) bytes, &time_ms, &present, value);
+			if(!used || used > bytes) {
+				break;
+			}
+			pos += used;
+			bytes -= used;
+
+			memset(&out[count], 0, sizeof(out[count]));
+			out[count].number = (uint32_t) (first + i);
+			out[count].record.boot = (uint8_t) boot;
+			out[count].record.time_ms = (uint32_t) time_ms;
+			out[count].record.present = present;
+			out[count].record.humidity = (int16_t) value[0];
+			out[count].record.temperature = (int16_t) value[1];
+			out[count].record.light = (uint32_t) value[2];
+			count++;
+		}
+		pos += bytes;
+	}
+	return count;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Formats a record as a #LAST line, as app_journal_line() does
+ *
+ ******************************************************************************/
+uint32_t sim_line(char *line, const SIM_RECORD *record) {
+	const JOURNAL_RECORD *r = &record->record;
+	uint32_t line_len;
+
+	line_len = sprintf(line, "%lu,%u,%lu,", (unsigned long) record->number, r->boot, (unsigned long) r->time_ms);
+	if(r->present & JOURNAL_HUMIDITY) {
+		line_len += sprintf(&line[line_len], "%d", r->humidity);
+	}
+	line[line_len++] = ',';
+	if(r->present & JOURNAL_TEMPERATURE) {
+		line_len += sprintf(&line[line_len], "%d", r->temperature);
+	}
+	line[line_len++] = ',';
+	if(r->present & JOURNAL_LIGHT) {
+		line_len += sprintf(&line[line_len], "%lu", (unsigned long) r->light);
+	}
+	line[line_len++] = '\n';
+	line[line_len] = '\0';
+	return line_len;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns true if two records hold the same sample, absent readings are not compared
+ *
+ ******************************************************************************/
+bool sim_same(const SIM_RECORD *a, const SIM_RECORD *b) {
+	const JOURNAL_RECORD *x = &a->record;
+	const JOURNAL_RECORD *y = &b->record;
+
+	return a->number == b->number && x->boot == y->boot && x->time_ms == y->time_ms && x->present == y->present
+			&& (!(x->present & JOURNAL_HUMIDITY) || x->humidity == y->humidity)
+			&& (!(x->present & JOURNAL_TEMPERATURE) || x->temperature == y->temperature)
+			&& (!(x->present & JOURNAL_LIGHT) || x->light == y->light);
+}
+
+#endif
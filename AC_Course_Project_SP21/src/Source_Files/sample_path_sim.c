@@ -0,0 +1,223 @@
+/**
+ * @file
+ * 	sample_path_sim.c
+ * @author
+ * 	Adam Chehadi
+ * @date
+ * 	05/24/2021
+ * @brief
+ *	Contains the host model of one sample, the serialized reads against the concurrent ones
+ *
+ * @details
+ *	Only built with SAMPLE_PATH_SIM defined, the firmware build compiles it to nothing.
+ *	From src:
+ *
+ *	gcc -DSAMPLE_PATH_SIM Source_Files/sample_path_sim.c -o sample_path_sim
+ *
+ *	Replays the bus transactions of one LETIMER0 sample on a timeline, for every SI7021
+ *	resolution:
+ *
+ *	serialized	the underflow starts the SI7021 humidity read then waits timer_delay(15)
+ *				before it starts the VEML7700, and the humidity callback starts the
+ *				temperature read then waits timer_delay(15) again
+ *	concurrent	both buses start from the underflow and the temperature read follows the
+ *				humidity callback straight away, SAMPLE_DONE_CB ends the sample
+ *
+ *	For each it prints the time from the underflow until every reading is in and the
+ *	time an I2C transfer is in flight, which blocks EM2 through I2C_EM_BLOCK and keeps
+ *	the HF clocks running.  timer_delay() sleeps on the timebase, so a delay with no
+ *	transfer in flight is spent in EM2 but holds the main loop.
+ *
+ *	The humidity read is the no hold command polled with NACK retries, i2c_nack() in
+ *	Wait_Read, so the conversion is spent on the bus.  Interrupt and callback
+ *	run times are left out, they are microseconds against milliseconds.
+ */
+
+#ifdef SAMPLE_PATH_SIM
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include <stdio.h>
+#include <stdint.h>
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+#define SIM_I2C_HZ				392157.0	// I2C_FREQ_FAST_MAX, SI7021_FREQ and VEML_FREQ
+#define SIM_DELAY_US			15000.0		// timer_delay(15) of the serialized path
+#define SIM_RESOLUTIONS			4
+
+// Conversion times in 0.1 ms by RES1:RES0 index, conv_rh_time and conv_temp_time of SI7021.c
+static const uint8_t sim_conv_rh[SIM_RESOLUTIONS] = { 120, 31, 45, 70 };
+static const uint8_t sim_conv_temp[SIM_RESOLUTIONS] = { 108, 38, 62, 24 };
+static const char *sim_res_name[SIM_RESOLUTIONS] = { "RH12 T14", "RH8 T12", "RH10 T13", "RH11 T11" };
+
+typedef struct {
+	double			done_us;			// underflow to the last reading
+	double			bus_us;				// an I2C transfer in flight, EM2 blocked
+} SIM_PATH;
+
+
+//***********************************************************************************
+// Private function prototypes
+//***********************************************************************************
+static double sim_bits(double bits);
+static double sim_register_read_us(uint32_t bytes);
+static double sim_humidity_us(uint32_t res);
+static double sim_union_us(const double (*span)[2], uint32_t spans);
+static SIM_PATH sim_serialized(uint32_t res);
+static SIM_PATH sim_concurrent(uint32_t res);
+
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Prints both paths for every resolution
+ *
+ * @return
+ *   0
+ *
+ ******************************************************************************/
+int main(void) {
+	SIM_PATH before;
+	SIM_PATH after;
+
+	printf("resolution     serialized done / bus    concurrent done / bus\n");
+	for(uint32_t res = 0; res < SIM_RESOLUTIONS; res++) {
+		before = sim_serialized(res);
+		after = sim_concurrent(res);
+		printf("%-10s %12.2f ms / %5.2f ms %12.2f ms / %5.2f ms%s\n", sim_res_name[res],
+				before.done_us / 1000, before.bus_us / 1000, after.done_us / 1000, after.bus_us / 1000,
+				res == 1 ? "   RES_8_12_BIT, left by i2c_test()" : "");
+	}
+	return 0;
+}
+
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Time on the bus of a number of bit periods, in us
+ *
+ ******************************************************************************/
+double sim_bits(double bits) {
+	return bits * 1e6 / SIM_I2C_HZ;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   A register read, start, address, register, repeated start, address, data, stop
+ *
+ ******************************************************************************/
+double sim_register_read_us(uint32_t bytes) {
+	return sim_bits(1 + 9 + 9 + 1 + 9 + 9.0 * bytes + 1);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   The no hold humidity read, the command, NACK polls through the conversion, then
+ *   the two data bytes
+ *
+ * @details
+ *   A poll is a start and the address byte, the conversion ends on average half way
+ *   through one.
+ *
+ ******************************************************************************/
+double sim_humidity_us(uint32_t res) {
+	double poll = sim_bits(1 + 9);
+	double conversion = (sim_conv_rh[res] + sim_conv_temp[res]) * 100.0;
+
+	return sim_bits(1 + 9 + 9) + conversion + poll / 2 + sim_bits(1 + 9 + 2 * 9 + 1);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Length of the union of time spans, spans sorted by start
+ *
+ ******************************************************************************/
+double sim_union_us(const double (*span)[2], uint32_t spans) {
+	double total = 0;
+	double start = span[0][0];
+	double end = span[0][1];
+
+	for(uint32_t i = 1; i < spans; i++) {
+		if(span[i][0] > end) {
+			total += end - start;
+			start = span[i][0];
+		}
+		if(span[i][1] > end) {
+			end = span[i][1];
+		}
+	}
+	return total + end - start;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   The path before SAMPLE_DONE_CB, every read followed by timer_delay(15)
+ *
+ * @details
+ *   The main loop is held in each delay, so the VEML7700 starts 15 ms after the
+ *   SI7021 and the humidity callback only runs once the first delay returns.  The
+ *   temperature callback runs when the second delay returns.
+ *
+ ******************************************************************************/
+SIM_PATH sim_serialized(uint32_t res) {
+	SIM_PATH path;
+	double humidity_done = sim_humidity_us(res);
+	double humidity_cb = humidity_done > SIM_DELAY_US ? humidity_done : SIM_DELAY_US;
+	double veml_done = SIM_DELAY_US + sim_register_read_us(2);
+	double temperature_cb = humidity_cb + SIM_DELAY_US;
+	double span[3][2] = {
+		{ 0, humidity_done },
+		{ SIM_DELAY_US, veml_done },
+		{ humidity_cb, humidity_cb + sim_register_read_us(2) }
+	};
+
+	if(span[1][0] > span[2][0]) {
+		double swap[2] = { span[1][0], span[1][1] };
+		span[1][0] = span[2][0];
+		span[1][1] = span[2][1];
+		span[2][0] = swap[0];
+		span[2][1] = swap[1];
+	}
+	path.done_us = temperature_cb > veml_done ? temperature_cb : veml_done;
+	path.bus_us = sim_union_us(span, 3);
+	return path;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   The path with SAMPLE_DONE_CB, both buses started together
+ *
+ ******************************************************************************/
+SIM_PATH sim_concurrent(uint32_t res) {
+	SIM_PATH path;
+	double humidity_done = sim_humidity_us(res);
+	double temperature_done = humidity_done + sim_register_read_us(2);
+	double veml_done = sim_register_read_us(2);
+	double span[3][2] = {
+		{ 0, humidity_done },
+		{ 0, veml_done },
+		{ humidity_done, temperature_done }
+	};
+
+	path.done_us = temperature_done > veml_done ? temperature_done : veml_done;
+	path.bus_us = sim_union_us(span, 3);
+	return path;
+}
+
+#endif
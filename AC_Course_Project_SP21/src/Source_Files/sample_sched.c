@@ -0,0 +1,249 @@
+/**
+ * @file
+ * 	sample_sched.c
+ * @author
+ * 	Adam Chehadi
+ * @date
+ * 	05/17/2021
+ * @brief
+ *	Contains the multi-rate sample schedule, every sensor group is sampled at its own
+ *	period and phase on the RTCC timebase
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "sample_sched.h"
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+static SAMPLE_SCHED_ENTRY	sched[SAMPLE_SCHED_MAX];
+static uint32_t				sched_due_cb;
+static uint64_t				sched_epoch;			// timebase tick every phase is measured from
+static uint32_t				sched_stretch_num;
+static uint32_t				sched_stretch_den;
+static bool					sched_running;
+
+
+//***********************************************************************************
+// Private function prototypes
+//***********************************************************************************
+static uint64_t sample_sched_period_ticks(const SAMPLE_SCHED_ENTRY *entry);
+static void sample_sched_align(SAMPLE_SCHED_ENTRY *entry, uint64_t now);
+static void sample_sched_arm(void);
+
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Sample schedule open function
+ *
+ * @details
+ * 	 Clears every entry.  The schedule owns compare channel TIMEBASE_SCHED_CC and
+ * 	 raises due_cb each time one or more entries are due.
+ *
+ * @param[in] due_cb
+ *   scheduler event raised when entries are due, collected with sample_sched_due()
+ *
+ ******************************************************************************/
+void sample_sched_open(uint32_t due_cb) {
+	EFM_ASSERT(timebase_is_open());
+
+	for(uint32_t i = 0; i < SAMPLE_SCHED_MAX; i++) {
+		sched[i].groups = 0;
+	}
+	sched_due_cb = due_cb;
+	sched_stretch_num = 1;
+	sched_stretch_den = 1;
+	sched_running = false;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Sets the period and phase of a sensor group
+ *
+ * @details
+ * 	 An entry with the same groups is updated, otherwise a free entry is taken.  Once
+ * 	 the schedule is running the entry keeps its phase relative to the schedule start,
+ * 	 so entries with periods that are multiples of each other keep coinciding.
+ *
+ * @param[in] groups
+ *   APP_SENSOR_xxx bits sampled together by the entry
+ *
+ * @param[in] period_ms
+ *   sample period, at least SAMPLE_SCHED_MERGE_MS
+ *
+ * @param[in] phase_ms
+ *   delay of the first sample after sample_sched_start()
+ *
+ ******************************************************************************/
+void sample_sched_set(uint32_t groups, uint32_t period_ms, uint32_t phase_ms) {
+	SAMPLE_SCHED_ENTRY *entry = 0;
+
+	EFM_ASSERT(groups);
+	EFM_ASSERT(period_ms >= SAMPLE_SCHED_MERGE_MS);
+
+	for(uint32_t i = 0; i < SAMPLE_SCHED_MAX; i++) {
+		if(sched[i].groups == groups) {
+			entry = &sched[i];
+			break;
+		}
+		if(!entry && !sched[i].groups) {
+			entry = &sched[i];
+		}
+	}
+	EFM_ASSERT(entry);
+
+	entry->groups = groups;
+	entry->period_ms = period_ms;
+	entry->phase_ms = phase_ms;
+
+	if(sched_running) {
+		sample_sched_align(entry, timebase_ticks());
+		sample_sched_arm();
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Stretches every period of the schedule by num / den
+ *
+ * @details
+ * 	 Lets one rate controller slow the whole schedule down without losing the ratios
+ * 	 between the entries.  The stretch takes effect from each entry's next sample.
+ *
+ * @param[in] num
+ *   stretch numerator
+ *
+ * @param[in] den
+ *   stretch denominator, num / den is at least 1
+ *
+ ******************************************************************************/
+void sample_sched_stretch(uint32_t num, uint32_t den) {
+	EFM_ASSERT(den && num >= den);
+
+	sched_stretch_num = num;
+	sched_stretch_den = den;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Starts the schedule
+ *
+ * @details
+ * 	 Every entry is first due its phase after now.
+ *
+ ******************************************************************************/
+void sample_sched_start(void) {
+	sched_epoch = timebase_ticks();
+	for(uint32_t i = 0; i < SAMPLE_SCHED_MAX; i++) {
+		if(sched[i].groups) {
+			sched[i].next_due = sched_epoch + TIMEBASE_MS_TO_TICKS(sched[i].phase_ms);
+		}
+	}
+	sched_running = true;
+	sample_sched_arm();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Collects the sensor groups due at this wake
+ *
+ * @details
+ * 	 Called from the due_cb callback.  Every entry due now or within SAMPLE_SCHED_MERGE_MS
+ * 	 is taken, so entries whose due times coincide or nearly do are read in the same
+ * 	 wake and the same sample.  Taken entries move on by their period, skipping any
+ * 	 period already missed, and the alarm is armed for the earliest next due time.
+ *
+ * @return
+ *   APP_SENSOR_xxx bits of the groups to sample
+ *
+ ******************************************************************************/
+uint32_t sample_sched_due(void) {
+	uint64_t now = timebase_ticks();
+	uint64_t merge = now + TIMEBASE_MS_TO_TICKS(SAMPLE_SCHED_MERGE_MS);
+	uint32_t groups = 0;
+
+	EFM_ASSERT(sched_running);
+
+	for(uint32_t i = 0; i < SAMPLE_SCHED_MAX; i++) {
+		if(sched[i].groups && (sched[i].next_due <= merge)) {
+			groups |= sched[i].groups;
+			sched[i].next_due += sample_sched_period_ticks(&sched[i]);
+			if(sched[i].next_due <= merge) {
+				sample_sched_align(&sched[i], merge);
+			}
+		}
+	}
+
+	sample_sched_arm();
+	return groups;
+}
+
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the stretched period of an entry in timebase ticks
+ *
+ ******************************************************************************/
+uint64_t sample_sched_period_ticks(const SAMPLE_SCHED_ENTRY *entry) {
+	uint64_t period_ms = (uint64_t) entry->period_ms * sched_stretch_num / sched_stretch_den;
+
+	return TIMEBASE_MS_TO_TICKS(period_ms);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Moves an entry to its first due time after a tick, on its phase grid
+ *
+ * @param[in] entry
+ *   entry to align
+ *
+ * @param[in] now
+ *   the entry is next due strictly after this tick
+ *
+ ******************************************************************************/
+void sample_sched_align(SAMPLE_SCHED_ENTRY *entry, uint64_t now) {
+	uint64_t first = sched_epoch + TIMEBASE_MS_TO_TICKS(entry->phase_ms);
+	uint64_t period = sample_sched_period_ticks(entry);
+
+	if(now < first) {
+		entry->next_due = first;
+	} else {
+		entry->next_due = first + ((now - first) / period + 1) * period;
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Arms the schedule compare for the earliest due entry
+ *
+ ******************************************************************************/
+void sample_sched_arm(void) {
+	uint64_t next = UINT64_MAX;
+
+	for(uint32_t i = 0; i < SAMPLE_SCHED_MAX; i++) {
+		if(sched[i].groups && (sched[i].next_due < next)) {
+			next = sched[i].next_due;
+		}
+	}
+
+	if(next != UINT64_MAX) {
+		timebase_alarm_at(TIMEBASE_SCHED_CC, next, sched_due_cb);
+	}
+}
@@ -0,0 +1,132 @@
+/**
+ * @file
+ * 	sample_store.c
+ * @author
+ * 	Adam Chehadi
+ * @date
+ * 	05/17/2021
+ * @brief
+ *	Contains the double-buffered sample records that the I2C interrupts publish and the
+ *	main loop reads without masking interrupts
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "sample_store.h"
+
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Clears a sample record
+ *
+ * @param[in] record
+ *   record to clear, nothing is published until the first sample_store_publish()
+ *
+ ******************************************************************************/
+void sample_store_init(SAMPLE_RECORD *record) {
+	record->seq = 0;
+	for(uint32_t i = 0; i < 2; i++) {
+		record->slot[i].raw = 0;
+		record->slot[i].ticks = 0;
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the raw word of the slot the next reading is written into
+ *
+ * @details
+ * 	 The staged slot is never the published one, so the I2C interrupt can assemble the
+ * 	 reading a byte at a time while the main loop reads the last published value.
+ *
+ * @note
+ *   Only one transfer may stage into a record at a time.
+ *
+ * @param[in] record
+ *   record the transfer writes
+ *
+ * @return
+ *   destination of the transfer's raw data
+ *
+ ******************************************************************************/
+uint32_t *sample_store_stage(SAMPLE_RECORD *record) {
+	return &record->slot[(record->seq + 1) & 1].raw;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Publishes the staged slot
+ *
+ * @details
+ * 	 Called from the interrupt that completed the transfer.  The slot is stamped and
+ * 	 completed before the sequence number flips it into view.
+ *
+ * @param[in] record
+ *   record whose staged slot holds a complete reading
+ *
+ ******************************************************************************/
+void sample_store_publish(SAMPLE_RECORD *record) {
+	uint32_t seq = record->seq;
+
+	record->slot[(seq + 1) & 1].ticks = timebase_ticks();
+	__DMB();
+	record->seq = seq + 1;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Reads the published reading of a record
+ *
+ * @details
+ * 	 Lock free: the slot is copied and the copy is retried if the sequence number
+ * 	 moved meanwhile, which is the only way the writer can have started staging into
+ * 	 the slot being copied.  Interrupts are never masked, and with one publish per
+ * 	 I2C transaction a retry is rare and a second one practically impossible.
+ *
+ * @param[in] record
+ *   record to read
+ *
+ * @param[out] ticks
+ *   timebase of the reading, may be 0
+ *
+ * @return
+ *   raw reading
+ *
+ ******************************************************************************/
+uint32_t sample_store_read(const SAMPLE_RECORD *record, uint64_t *ticks) {
+	uint32_t seq;
+	SAMPLE_SLOT copy;
+
+	do {
+		seq = record->seq;
+		__DMB();
+		copy = record->slot[seq & 1];
+		__DMB();
+	} while(seq != record->seq);
+
+	if(ticks) {
+		*ticks = copy.ticks;
+	}
+	return copy.raw;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the number of readings published to a record
+ *
+ * @details
+ * 	 Lets a reader tell whether a new reading arrived since it last looked.
+ *
+ ******************************************************************************/
+uint32_t sample_store_seq(const SAMPLE_RECORD *record) {
+	return record->seq;
+}
@@ -0,0 +1,430 @@
+/**
+ * @file
+ * 	sensor.c
+ * @author
+ * 	Adam Chehadi
+ * @date
+ * 	05/16/2021
+ * @brief
+ *	Contains the sensor registry and the sampling engine that walks it
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "sensor.h"
+#include "i2c.h"
+#include "SI7021.h"
+#include "veml.h"
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+// One entry per reading, in SENSOR_xxx order.  A new sensor only needs its const
+// descriptor added here.
+static const SENSOR_DESC * const sensor_registry[SENSOR_NUM] = {
+	&si7021_humidity_sensor,
+	&si7021_temperature_sensor,
+	&veml_light_sensor
+};
+
+static SENSOR_SAMPLE	sample;
+static uint32_t			measure_started;		// registry bits converted ahead by the pipeline
+static uint32_t			sensor_measure_cb;
+static uint32_t			sensor_done_cb;
+static bool				sensor_pipeline;
+
+static SENSOR_CACHE		cache[SENSOR_NUM];
+static uint32_t			cache_waiters[SENSOR_NUM];	// ready events of requests for the next reading
+static uint32_t			cache_requested;			// groups to sample once the open sample is released
+
+
+//***********************************************************************************
+// Private function prototypes
+//***********************************************************************************
+static void sensor_launch(I2C_TypeDef *bus, int32_t after);
+static void sensor_launch_all(void);
+
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Sensor engine open function
+ *
+ * @details
+ * 	 Opens every registered device and records the events the engine raises.
+ *
+ * @param[in] measure_cb
+ *   event raised when the conversions started by a sample have had their time,
+ *   its callback must call sensor_measure_done()
+ *
+ * @param[in] sample_done_cb
+ *   event raised once every reading of a sample is converted
+ *
+ * @param[in] pipeline
+ *   start the next conversion of every sensor that has a start_measure() as soon as
+ *   a sample is done, so the next sample only fetches it
+ *
+ ******************************************************************************/
+void sensor_open(uint32_t measure_cb, uint32_t sample_done_cb, bool pipeline) {
+	sensor_measure_cb = measure_cb;
+	sensor_done_cb = sample_done_cb;
+	sensor_pipeline = pipeline;
+	measure_started = 0;
+	sample.open = false;
+	cache_requested = 0;
+
+	for(uint32_t i = 0; i < SENSOR_NUM; i++) {
+		cache[i].valid = false;
+		cache_waiters[i] = 0;
+		if(sensor_registry[i]->open) {
+			sensor_registry[i]->open();
+		}
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the descriptor of a registered reading
+ *
+ * @param[in] index
+ *   SENSOR_xxx index
+ *
+ ******************************************************************************/
+const SENSOR_DESC *sensor_get(uint32_t index) {
+	EFM_ASSERT(index < SENSOR_NUM);
+	return sensor_registry[index];
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Starts a sample of the enabled sensors
+ *
+ * @details
+ * 	 Sensors that convert on command and were not converted ahead by the pipeline get
+ * 	 their start_measure(), and the timebase alarm raises the measure event after the
+ * 	 longest of their measure times.  Without anything to wait for the reads are launched
+ * 	 right away, the first reading of every bus at the same time.
+ *
+ * @note
+ *   Without the timebase the reads are launched immediately and rely on the device
+ *   holding off the read until it has converted.
+ *
+ * @param[in] groups
+ *   APP_SENSOR_xxx bits of the enabled sensors
+ *
+ * @return
+ *   false if the previous sample is still open
+ *
+ ******************************************************************************/
+bool sensor_sample_start(uint32_t groups) {
+	uint32_t wait_ms = 0;
+	const SENSOR_DESC *desc;
+
+	if(!sensor_sample_open(groups)) {
+		return false;
+	}
+
+	for(uint32_t i = 0; i < SENSOR_NUM; i++) {
+		desc = sensor_registry[i];
+		if((sample.launched & (1 << i)) && desc->start_measure && !(measure_started & (1 << i))) {
+			while(check_busy(desc->bus));
+			desc->start_measure();
+			if(desc->measure_time_ms && desc->measure_time_ms() > wait_ms) {
+				wait_ms = desc->measure_time_ms();
+			}
+		}
+	}
+	measure_started &= ~sample.launched;		// others keep their conversion for their next sample
+
+	if(wait_ms && timebase_is_open()) {
+		timebase_alarm_ms(wait_ms, sensor_measure_cb);
+	} else {
+		sensor_launch_all();
+	}
+	return true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Opens a sample without launching any read
+ *
+ * @details
+ * 	 For reads that are started by hardware, the first one to complete opens the sample
+ * 	 and sensor_read_done() launches the rest of each bus.
+ *
+ * @param[in] groups
+ *   APP_SENSOR_xxx bits of the enabled sensors
+ *
+ * @return
+ *   false if a sample is already open
+ *
+ ******************************************************************************/
+bool sensor_sample_open(uint32_t groups) {
+	if(sample.open) {
+		return false;
+	}
+
+	sample.open = true;
+	sample.launched = 0;
+	for(uint32_t i = 0; i < SENSOR_NUM; i++) {
+		if(sensor_registry[i]->group & groups) {
+			sample.launched |= 1 << i;
+		}
+	}
+	sample.pending = sample.launched;
+	sample.start_ticks = timebase_ticks();
+
+	if(!sample.pending) {
+		sample.done_ticks = sample.start_ticks;
+		add_scheduled_event(sensor_done_cb);
+	}
+	return true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Launches the reads once the conversions of the sample have had their time
+ *
+ ******************************************************************************/
+void sensor_measure_done(void) {
+	EFM_ASSERT(sample.open);
+	sensor_launch_all();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Converts a finished read and launches the next reading on the same bus
+ *
+ * @details
+ * 	 The reading is converted right away since devices such as the SI7021 read every
+ * 	 value into the same buffer, and the cache is refreshed with it.  The sample done
+ * 	 event is raised once, when the last bus finishes, together with the ready event
+ * 	 of every request that waited on a reading of the sample.  With the pipeline on
+ * 	 the next conversions are started then.
+ *
+ * @param[in] done_cb
+ *   done event of the read that finished
+ *
+ ******************************************************************************/
+void sensor_read_done(uint32_t done_cb) {
+	const SENSOR_DESC *desc;
+
+	for(uint32_t i = 0; i < SENSOR_NUM; i++) {
+		desc = sensor_registry[i];
+		if(desc->done_cb == done_cb && (sample.pending & (1 << i))) {
+			sample.value[i] = desc->convert();
+			sample.pending &= ~(1 << i);
+			cache[i].value = sample.value[i];
+			cache[i].ticks = sample.start_ticks;
+			cache[i].valid = true;
+			sensor_launch(desc->bus, i);
+			break;
+		}
+	}
+
+	if(sample.open && !sample.pending) {
+		sample.done_ticks = timebase_ticks();
+
+		if(sensor_pipeline) {
+			for(uint32_t i = 0; i < SENSOR_NUM; i++) {
+				desc = sensor_registry[i];
+				if((sample.launched & (1 << i)) && desc->start_measure) {
+					while(check_busy(desc->bus));
+					desc->start_measure();
+					measure_started |= 1 << i;
+				}
+			}
+		}
+		for(uint32_t i = 0; i < SENSOR_NUM; i++) {
+			if((sample.launched & (1 << i)) && cache_waiters[i]) {
+				add_scheduled_event(cache_waiters[i]);
+				cache_waiters[i] = 0;
+			}
+		}
+		add_scheduled_event(sensor_done_cb);
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the sample being reported
+ *
+ ******************************************************************************/
+const SENSOR_SAMPLE *sensor_sample(void) {
+	return &sample;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Closes the sample once it has been reported
+ *
+ * @details
+ * 	 Requests for stale readings that arrived while the sample was open, and that it
+ * 	 did not read, are sampled next.
+ *
+ ******************************************************************************/
+void sensor_sample_release(void) {
+	uint32_t groups = cache_requested;
+
+	sample.open = false;
+	cache_requested = 0;
+	if(groups) {
+		sensor_sample_start(groups);
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns a cached reading if it is fresh enough
+ *
+ * @param[in] index
+ *   SENSOR_xxx index
+ *
+ * @param[in] max_age_ms
+ *   freshness window, the reading's sample must have launched at most this long ago
+ *
+ * @param[out] value
+ *   the cached reading when true is returned
+ *
+ * @return
+ *   true if the reading was served from RAM
+ *
+ ******************************************************************************/
+bool sensor_cached(uint32_t index, uint32_t max_age_ms, float *value) {
+	EFM_ASSERT(index < SENSOR_NUM);
+
+	if(!cache[index].valid || (timebase_ticks() - cache[index].ticks > TIMEBASE_MS_TO_TICKS(max_age_ms))) {
+		return false;
+	}
+	*value = cache[index].value;
+	return true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the cache entry of a reading, whatever its age
+ *
+ * @param[in] index
+ *   SENSOR_xxx index
+ *
+ ******************************************************************************/
+const SENSOR_CACHE *sensor_cache(uint32_t index) {
+	EFM_ASSERT(index < SENSOR_NUM);
+	return &cache[index];
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Requests a reading no older than a freshness window
+ *
+ * @details
+ * 	 A fresh cached reading raises ready_cb right away.  Otherwise the request waits on
+ * 	 the next reading of the sensor, and every request that is waiting shares one bus
+ * 	 read: the open sample if it reads the sensor, else one sample of the sensor's
+ * 	 group started now or as soon as the open sample is released.
+ *
+ * @note
+ *   The ready callback collects the value with sensor_cached().  Must not be used
+ *   while the reads are started by hardware.
+ *
+ * @param[in] index
+ *   SENSOR_xxx index
+ *
+ * @param[in] max_age_ms
+ *   freshness window
+ *
+ * @param[in] ready_cb
+ *   event raised once a fresh reading is cached
+ *
+ * @return
+ *   true if the reading was fresh and no bus read is needed
+ *
+ ******************************************************************************/
+bool sensor_request(uint32_t index, uint32_t max_age_ms, uint32_t ready_cb) {
+	float value;
+
+	if(sensor_cached(index, max_age_ms, &value)) {
+		add_scheduled_event(ready_cb);
+		return true;
+	}
+
+	if(cache_waiters[index] == 0) {
+		if(!sample.open) {
+			sensor_sample_start(sensor_registry[index]->group);
+		} else if(!(sample.pending & (1 << index))) {
+			cache_requested |= sensor_registry[index]->group;
+		}
+	}
+	cache_waiters[index] |= ready_cb;
+	return false;
+}
+
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Starts the next reading of the sample on a bus
+ *
+ * @param[in] bus
+ *   I2C bus to continue
+ *
+ * @param[in] after
+ *   registry index that just finished on the bus, -1 to start the bus
+ *
+ ******************************************************************************/
+void sensor_launch(I2C_TypeDef *bus, int32_t after) {
+	const SENSOR_DESC *desc;
+
+	for(int32_t i = after + 1; i < SENSOR_NUM; i++) {
+		desc = sensor_registry[i];
+		if(desc->bus == bus && (sample.pending & (1 << i))) {
+			while(check_busy(bus));
+			desc->read(desc->done_cb);
+			return;
+		}
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Starts the first reading of the sample on every bus
+ *
+ ******************************************************************************/
+void sensor_launch_all(void) {
+	bool bus_started;
+
+	for(uint32_t i = 0; i < SENSOR_NUM; i++) {
+		if(!(sample.pending & (1 << i))) {
+			continue;
+		}
+
+		bus_started = false;
+		for(uint32_t j = 0; j < i; j++) {
+			if((sample.pending & (1 << j)) && sensor_registry[j]->bus == sensor_registry[i]->bus) {
+				bus_started = true;
+			}
+		}
+		if(!bus_started) {
+			sensor_launch(sensor_registry[i]->bus, (int32_t) i - 1);
+		}
+	}
+}
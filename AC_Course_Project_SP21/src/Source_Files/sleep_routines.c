@@ -39,12 +39,14 @@
 // Include files
 //***********************************************************************************
 #include "sleep_routines.h"
+#include "timebase.h"
 
 
 //***********************************************************************************
 // Private variables
 //***********************************************************************************
 static int lowest_energy_mode[MAX_ENERGY_MODES];
+static uint64_t sleep_ticks[MAX_ENERGY_MODES];		// timebase ticks spent in each mode by enter_sleep()
 
 
 //***********************************************************************************
@@ -130,9 +132,16 @@ void sleep_unblock_mode(uint32_t EM) {
  *
  ******************************************************************************/
 void enter_sleep(void) {
+	uint32_t entered = EM0;
+	uint64_t start = 0;
+
 	CORE_DECLARE_IRQ_STATE;
 	CORE_ENTER_CRITICAL();
 
+	if (timebase_is_open()) {
+		start = timebase_ticks();
+	}
+
 	if (lowest_energy_mode[EM0] > 0) {
 //		nothing
 	}
@@ -141,12 +150,20 @@ void enter_sleep(void) {
 	}
 	else if (lowest_energy_mode[EM2] > 0) {
 		EMU_EnterEM1();
+		entered = EM1;
 	}
 	else if (lowest_energy_mode[EM3] > 0) {
 		EMU_EnterEM2(true);
+		entered = EM2;
 	}
 	else {
 		EMU_EnterEM3(true);
+		entered = EM3;
+	}
+
+	// The wake-up interrupt is still pending here, so this is the time of the wake-up
+	if ((entered != EM0) && timebase_is_open()) {
+		sleep_ticks[entered] += timebase_ticks() - start;
 	}
 
 	CORE_EXIT_CRITICAL();
@@ -172,3 +189,40 @@ uint32_t current_block_energy_mode(void) {
 	}
 	return (MAX_ENERGY_MODES - 1);
 }
+
+
+/***************************************************************************//**
+ * @brief
+ *	Returns the time spent in an energy mode
+ *
+ * @details
+ *	Sleep is timed on the timebase around the EMU_EnterEMx() call, so EM0 is the time
+ *	since timebase_open() that was not spent asleep.  The timebase blocks EM3, where the
+ *	LFXO stops, so no time is counted there while it runs.
+ *
+ * @param[in] EM
+ *	Energy Mode, EM0 to EM3
+ *
+ * @return
+ *	milliseconds in the mode since timebase_open()
+ *
+ ******************************************************************************/
+uint64_t sleep_residency_ms(uint32_t EM) {
+	uint64_t ticks;
+
+	EFM_ASSERT(EM < EM4);
+
+	CORE_DECLARE_IRQ_STATE;
+	CORE_ENTER_CRITICAL();
+
+	if (EM == EM0) {
+		ticks = timebase_ticks() - sleep_ticks[EM1] - sleep_ticks[EM2] - sleep_ticks[EM3];
+	}
+	else {
+		ticks = sleep_ticks[EM];
+	}
+
+	CORE_EXIT_CRITICAL();
+
+	return TIMEBASE_TICKS_TO_MS(ticks);
+}
@@ -0,0 +1,79 @@
+/**
+ * @file
+ * 	supply.c
+ * @author
+ * 	Adam Chehadi
+ * @date
+ * 	05/24/2021
+ * @brief
+ *	Contains the driver that measures the supply voltage with ADC0
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "supply.h"
+
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Sets up ADC0 to measure AVDD
+ *
+ * @details
+ * 	 On the Pearl Gecko board AVDD is the battery, the DCDC runs the core from it, so
+ * 	 AVDD is converted against the internal 5 V reference.  The ADC warms up for every
+ * 	 conversion and its clock is only on during supply_mv(), so it draws nothing
+ * 	 between readings.
+ *
+ ******************************************************************************/
+void supply_open(void) {
+	ADC_Init_TypeDef init = ADC_INIT_DEFAULT;
+	ADC_InitSingle_TypeDef single = ADC_INITSINGLE_DEFAULT;
+
+	CMU_ClockEnable(SUPPLY_ADC_CLOCK, true);
+
+	init.timebase = ADC_TimebaseCalc(0);
+	init.prescale = ADC_PrescaleCalc(SUPPLY_ADC_HZ, 0);
+	init.warmUpMode = adcWarmupNormal;
+	ADC_Init(SUPPLY_ADC, &init);
+
+	single.reference = adcRef5V;
+	single.posSel = adcPosSelAVDD;
+	single.negSel = adcNegSelVSS;
+	single.acqTime = adcAcqTime16;
+	single.resolution = adcRes12Bit;
+	ADC_InitSingle(SUPPLY_ADC, &single);
+
+	CMU_ClockEnable(SUPPLY_ADC_CLOCK, false);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Measures the supply voltage
+ *
+ * @note
+ *   Busy waits the few tens of microseconds of one conversion in EM0.
+ *
+ * @return
+ *   AVDD in millivolts
+ *
+ ******************************************************************************/
+uint32_t supply_mv(void) {
+	uint32_t sample;
+
+	CMU_ClockEnable(SUPPLY_ADC_CLOCK, true);
+
+	ADC_IntClear(SUPPLY_ADC, ADC_IF_SINGLE);
+	ADC_Start(SUPPLY_ADC, adcStartSingle);
+	while(!(ADC_IntGet(SUPPLY_ADC) & ADC_IF_SINGLE));
+	sample = ADC_DataSingleGet(SUPPLY_ADC);
+
+	CMU_ClockEnable(SUPPLY_ADC_CLOCK, false);
+
+	return sample * SUPPLY_REF_MV / SUPPLY_FULL_SCALE;
+}
@@ -0,0 +1,257 @@
+/**
+ * @file
+ * 	timebase.c
+ * @author
+ * 	Adam Chehadi
+ * @date
+ * 	05/09/2021
+ * @brief
+ *	Contains the monotonic low energy timebase built on the RTCC and the LFXO
+ */
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "timebase.h"
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+static volatile uint32_t	timebase_overflows;
+static bool					timebase_opened = false;
+static uint32_t				alarm_event[TIMEBASE_NUM_CC];
+
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Timebase open function
+ *
+ * @details
+ * 	 Starts the 32-bit RTCC counter from the 32.768 kHz LFXO with no prescaler and
+ * 	 enables the overflow interrupt that extends it to 64 bits.  Compare channel
+ * 	 TIMEBASE_DELAY_CC is set up for timebase_delay_ms() and the other channels for
+ * 	 timebase_alarm_at().
+ *
+ * @note
+ *   cmu_open() must have routed the LFXO to the LFE clock branch.  The timebase
+ *   blocks EM3 since the LFXO does not run there.
+ *
+ ******************************************************************************/
+void timebase_open(void) {
+	RTCC_Init_TypeDef rtcc_init_values = RTCC_INIT_DEFAULT;
+	RTCC_CCChConf_TypeDef rtcc_compare = RTCC_CH_INIT_COMPARE_DEFAULT;
+
+	if(timebase_opened) {
+		return;
+	}
+
+	CMU_ClockEnable(cmuClock_RTCC, true);
+
+	rtcc_init_values.enable = false;
+	rtcc_init_values.debugRun = false;
+	rtcc_init_values.presc = rtccCntPresc_1;
+	rtcc_init_values.prescMode = rtccCntTickPresc;
+	RTCC_Init(&rtcc_init_values);
+	for(uint32_t cc = 0; cc < TIMEBASE_NUM_CC; cc++) {
+		RTCC_ChannelInit(cc, &rtcc_compare);
+	}
+
+	timebase_overflows = 0;
+	RTCC->CNT = 0;
+
+	RTCC_IntClear(_RTCC_IF_MASK);
+	RTCC_IntEnable(RTCC_IEN_OF);
+	NVIC_EnableIRQ(RTCC_IRQn);
+
+	sleep_block_mode(TIMEBASE_EM);
+	RTCC_Enable(true);
+	timebase_opened = true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns whether timebase_open() has run
+ *
+ ******************************************************************************/
+bool timebase_is_open(void) {
+	return timebase_opened;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the 64-bit tick count of the timebase
+ *
+ * @details
+ * 	 The low word is the RTCC counter and the high word counts RTCC overflows.  If the
+ * 	 counter has wrapped but the overflow interrupt has not been serviced yet, the
+ * 	 pending flag is folded in so the count never goes backwards.
+ *
+ * @return
+ *   ticks of TIMEBASE_HZ since timebase_open()
+ *
+ ******************************************************************************/
+uint64_t timebase_ticks(void) {
+	uint32_t high;
+	uint32_t low;
+
+	CORE_DECLARE_IRQ_STATE;
+	CORE_ENTER_CRITICAL();
+
+	high = timebase_overflows;
+	low = RTCC_CounterGet();
+	if((RTCC->IF & RTCC_IF_OF) && (low < 0x80000000)) {
+		high++;
+	}
+
+	CORE_EXIT_CRITICAL();
+
+	return ((uint64_t) high << 32) | low;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the timebase in milliseconds
+ *
+ * @return
+ *   milliseconds since timebase_open()
+ *
+ ******************************************************************************/
+uint64_t timebase_ms(void) {
+	return TIMEBASE_TICKS_TO_MS(timebase_ticks());
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Waits at least ms_delay milliseconds in the lowest allowed energy mode
+ *
+ * @details
+ * 	 Arms an RTCC compare at the deadline and sleeps through enter_sleep() until it
+ * 	 has passed.  Other interrupts that wake the core are serviced while waiting.
+ *
+ * @param[in] ms_delay
+ *   delay in milliseconds
+ *
+ ******************************************************************************/
+void timebase_delay_ms(uint32_t ms_delay) {
+	uint64_t deadline;
+
+	EFM_ASSERT(timebase_opened);
+
+	deadline = timebase_ticks() + TIMEBASE_MS_TO_TICKS(ms_delay);
+
+	RTCC_ChannelCCVSet(TIMEBASE_DELAY_CC, (uint32_t) deadline);
+	RTCC_IntClear(RTCC_IF_CC0 << TIMEBASE_DELAY_CC);
+	RTCC_IntEnable(RTCC_IEN_CC0 << TIMEBASE_DELAY_CC);
+
+	while(timebase_ticks() < deadline) {
+		CORE_DECLARE_IRQ_STATE;
+		CORE_ENTER_CRITICAL();
+		if(timebase_ticks() < deadline) {
+			enter_sleep();
+		}
+		CORE_EXIT_CRITICAL();
+	}
+
+	RTCC_IntDisable(RTCC_IEN_CC0 << TIMEBASE_DELAY_CC);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Raises a scheduler event after at least ms_delay milliseconds
+ *
+ * @details
+ * 	 The non-blocking counterpart of timebase_delay_ms() on TIMEBASE_ALARM_CC.  The
+ * 	 caller returns to the main loop and sleeps until the event is raised.
+ *
+ * @note
+ *   There is a single alarm on the channel, it must have fired before it is armed again.
+ *
+ * @param[in] ms_delay
+ *   delay in milliseconds, at least one tick is always waited
+ *
+ * @param[in] alarm_cb
+ *   scheduler event raised at the deadline
+ *
+ ******************************************************************************/
+void timebase_alarm_ms(uint32_t ms_delay, uint32_t alarm_cb) {
+	EFM_ASSERT(!(RTCC->IEN & (RTCC_IEN_CC0 << TIMEBASE_ALARM_CC)));
+
+	timebase_alarm_at(TIMEBASE_ALARM_CC, timebase_ticks() + TIMEBASE_MS_TO_TICKS(ms_delay) + 1, alarm_cb);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Raises a scheduler event at an absolute timebase tick
+ *
+ * @details
+ * 	 The RTCC compare wakes the core from EM2 at the deadline and the interrupt handler
+ * 	 adds alarm_cb.  Arming a channel again replaces its previous deadline.  A deadline
+ * 	 that has already passed raises the event right away.
+ *
+ * @note
+ *   The compare matches the low 32 bits, so the deadline must be less than 36 hours out.
+ *
+ * @param[in] cc
+ *   RTCC compare channel owned by the caller, not TIMEBASE_DELAY_CC
+ *
+ * @param[in] deadline
+ *   timebase tick at which the event is raised
+ *
+ * @param[in] alarm_cb
+ *   scheduler event raised at the deadline
+ *
+ ******************************************************************************/
+void timebase_alarm_at(uint32_t cc, uint64_t deadline, uint32_t alarm_cb) {
+	EFM_ASSERT(timebase_opened);
+	EFM_ASSERT(cc < TIMEBASE_NUM_CC && cc != TIMEBASE_DELAY_CC);
+
+	alarm_event[cc] = alarm_cb;
+	RTCC_ChannelCCVSet(cc, (uint32_t) deadline);
+	RTCC_IntClear(RTCC_IF_CC0 << cc);
+	RTCC_IntEnable(RTCC_IEN_CC0 << cc);
+
+	// The compare only fires on a match, so a deadline that passed while arming would be missed
+	if(timebase_ticks() >= deadline) {
+		RTCC_IntDisable(RTCC_IEN_CC0 << cc);
+		RTCC_IntClear(RTCC_IF_CC0 << cc);
+		add_scheduled_event(alarm_cb);
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   RTCC Interrupt Service Routine
+ *
+ * @details
+ * 	 Counts counter overflows for the upper 32 bits of the timebase.  The delay
+ * 	 compare interrupt only needs to wake the core, the alarm compares are single shot
+ * 	 and raise the event they were armed with.
+ *
+ ******************************************************************************/
+void RTCC_IRQHandler(void) {
+	uint32_t int_flag;
+	int_flag = RTCC->IF & RTCC->IEN;
+	RTCC->IFC = int_flag;
+
+	if(int_flag & RTCC_IF_OF) {
+		timebase_overflows++;
+	}
+	for(uint32_t cc = 0; cc < TIMEBASE_NUM_CC; cc++) {
+		if(cc != TIMEBASE_DELAY_CC && (int_flag & (RTCC_IF_CC0 << cc))) {
+			RTCC_IntDisable(RTCC_IEN_CC0 << cc);
+			add_scheduled_event(alarm_event[cc]);
+		}
+	}
+}
@@ -11,7 +11,53 @@
 
 #include "veml.h"
 
-static uint32_t light_data;
+static SAMPLE_RECORD	light_record;		// published by the I2C0 interrupt
+static uint32_t config_data;
+
+static VEML_GAIN	veml_gain = VemlGain1;
+static VEML_IT		veml_it = VemlIt100;
+static uint32_t		veml_range = VEML_RANGE_DEFAULT;
+static bool			veml_int_en = false;
+static uint32_t		veml_psm;			// power save register as last set by veml_set_psm()
+static VEML_IT		burst_saved_it;
+static uint32_t		status_data;
+
+typedef struct {
+	VEML_GAIN		gain;
+	VEML_IT			it;
+} VEML_RANGE;
+
+// Auto-range steps from the most to the least sensitive, neighbours differ by at most 4x
+static const VEML_RANGE veml_ranges[] = {
+	{ VemlGain2,	VemlIt800 },		// 0.0036 lux per count
+	{ VemlGain2,	VemlIt400 },
+	{ VemlGain2,	VemlIt200 },
+	{ VemlGain2,	VemlIt100 },
+	{ VemlGain1,	VemlIt100 },		// 0.0576, power-on default
+	{ VemlGain1_4,	VemlIt100 },
+	{ VemlGain1_8,	VemlIt100 },
+	{ VemlGain1_8,	VemlIt50 },
+	{ VemlGain1_8,	VemlIt25 }			// 1.8432, 120 klux full scale
+};
+
+#define VEML_NUM_RANGES		(sizeof(veml_ranges) / sizeof(veml_ranges[0]))
+
+static uint32_t veml_gain_x8(VEML_GAIN gain);
+static void veml_conf_write(void);
+
+// Integrates continuously, a read returns the last completed integration
+const SENSOR_DESC veml_light_sensor = {
+	.name = "light",
+	.format = "light = %.0f lux\n",
+	.bus = VEML_I2C,
+	.group = APP_SENSOR_VEML,
+	.done_cb = VEML_CB,
+	.open = veml_open,
+	.start_measure = 0,
+	.measure_time_ms = veml_integration_ms,
+	.read = veml_read,
+	.convert = compute_lux
+};
 
 
 /***************************************************************************//**
@@ -43,6 +89,22 @@ void veml_i2c_open() {
 }
 
 
+/***************************************************************************//**
+ * @brief
+ *   VEML Open Function
+ *
+ * @details
+ * 	 Opens the I2C bus and applies the default gain, integration time and power save mode from app.h.
+ *
+ ******************************************************************************/
+void veml_open(void) {
+	sample_store_init(&light_record);
+	veml_i2c_open();
+	veml_configure(VEML_DEFAULT_GAIN, VEML_DEFAULT_IT);
+	veml_set_psm(VEML_PSM_ENABLED, VEML_DEFAULT_PSM);
+}
+
+
 /***************************************************************************//**
  * @brief
  *   VEML Read Function
@@ -56,26 +118,338 @@ void veml_i2c_open() {
  *
  ******************************************************************************/
 void veml_read(uint32_t veml_read_cb) {
-	i2c_start(VEML_I2C, VEML_ADDR, VEML_READ, VEML_RW_R, &light_data, VEML_CB, I2C_BYTES_2);
-	timer_delay(15);
+	i2c_read_record(VEML_I2C, VEML_ADDR, VEML_READ, &light_record, VEML_CB, I2C_BYTES_2);
 }
 
 
 /***************************************************************************//**
  * @brief
- *   VEML Write Function
+ *   VEML Armed Read Function
  *
  * @details
- * 	 Calls i2c_start will proper initialization values to start the I2C peripheral
+ * 	 Calls i2c_arm with the same values as veml_read so the next hardware trigger of I2C0
+ * 	 starts the light read without the CPU.
  *
  * @note
  *   This function does not have any return values. The input value is the external device
  *   callback in the event to be serviced.
  *
  ******************************************************************************/
-void veml_write() {
-	i2c_start(VEML_I2C, VEML_ADDR, VEML_CONFIG, VEML_RW_W, &light_data, VEML_CB, I2C_BYTES_2);
-	timer_delay(15);
+void veml_arm(uint32_t veml_read_cb) {
+	i2c_arm_record(VEML_I2C, VEML_ADDR, VEML_READ, &light_record, VEML_CB, I2C_BYTES_2);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   VEML Write Function
+ *
+ * @details
+ * 	 Writes one 16-bit VEML7700 register, low byte first, and waits for the write to complete.
+ *
+ * @note
+ *   Blocks on the I2C0 bus, call it between samples.
+ *
+ * @param[in] reg
+ *   VEML7700 command code of the register
+ *
+ * @param[in] value
+ *   register value
+ *
+ ******************************************************************************/
+void veml_write(uint32_t reg, uint32_t value) {
+	while(check_busy(VEML_I2C));
+	config_data = value;
+	i2c_start(VEML_I2C, VEML_ADDR, reg, VEML_RW_W, &config_data, 0, I2C_BYTES_2);
+	while(check_busy(VEML_I2C));
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   VEML Configure Function
+ *
+ * @details
+ * 	 Writes the gain and integration time to ALS_CONF_0 with the sensor powered on, keeping the threshold
+ * 	 interrupt setting.  compute_lux() scales by the coefficient of the new setting.
+ *
+ * @note
+ *   A reading integrated across the change mixes both settings, so the first sample after a
+ *   change can be off.
+ *
+ * @param[in] gain
+ *   ALS gain
+ *
+ * @param[in] it
+ *   ALS integration time
+ *
+ ******************************************************************************/
+void veml_configure(VEML_GAIN gain, VEML_IT it) {
+	veml_gain = gain;
+	veml_it = it;
+	veml_conf_write();
+
+	for(uint32_t i = 0; i < VEML_NUM_RANGES; i++) {
+		if(veml_ranges[i].gain == gain && veml_ranges[i].it == it) {
+			veml_range = i;
+		}
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   VEML Power Save Mode Function
+ *
+ * @details
+ * 	 In power save mode the VEML7700 idles for the PSM time between measurements, so a new reading
+ * 	 is available every integration time plus PSM time at a fraction of the continuous current.
+ *
+ * @param[in] enable
+ *   true enables power save mode
+ *
+ * @param[in] mode
+ *   idle time between measurements
+ *
+ ******************************************************************************/
+void veml_set_psm(bool enable, VEML_PSM_MODE mode) {
+	veml_psm = ((uint32_t) mode << VEML_PSM_MODE_SHIFT) | (enable ? VEML_PSM_EN : 0);
+	veml_write(VEML_PSM, veml_psm);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   VEML Auto-Range Function
+ *
+ * @details
+ * 	 Steps one entry through the range table based on the last raw reading, towards less sensitivity
+ * 	 when it is close to saturating and towards more when it uses little of the 16-bit range.  One
+ * 	 step changes sensitivity by at most 4x, so VEML_RANGE_LOW x 4 staying below VEML_RANGE_HIGH keeps
+ * 	 the ranging from oscillating.
+ *
+ * @note
+ *   Call it after compute_lux() and before the next read is started, it writes ALS_CONF_0 when the
+ *   range changes.
+ *
+ * @return
+ *   true if the range was changed
+ *
+ ******************************************************************************/
+bool veml_autorange(void) {
+	uint32_t range = veml_range;
+	uint32_t light_data = sample_store_read(&light_record, 0);
+
+	if(light_data > VEML_RANGE_HIGH && range < VEML_NUM_RANGES - 1) {
+		range++;
+	} else if(light_data < VEML_RANGE_LOW && range > 0) {
+		range--;
+	} else {
+		return false;
+	}
+
+	veml_configure(veml_ranges[range].gain, veml_ranges[range].it);
+	return true;
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   VEML Threshold Window Function
+ *
+ * @details
+ * 	 Writes the ALS_WL and ALS_WH thresholds in raw counts and enables the threshold interrupt.  Once
+ * 	 VEML_PERS_2 readings in a row fall outside the window the VEML pulls its INT pin low and sets the
+ * 	 matching ALS_INT bit until veml_int_status() reads it.
+ *
+ * @param[in] low
+ *   low threshold in counts
+ *
+ * @param[in] high
+ *   high threshold in counts
+ *
+ ******************************************************************************/
+void veml_window_set(uint32_t low, uint32_t high) {
+	veml_write(VEML_ALS_WL, low & 0xFFFF);
+	veml_write(VEML_ALS_WH, high & 0xFFFF);
+
+	if(!veml_int_en) {
+		veml_int_en = true;
+		veml_conf_write();
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   VEML Centered Threshold Window Function
+ *
+ * @details
+ * 	 Re-arms the window pct percent either side of the last raw reading, at least VEML_WINDOW_MIN
+ * 	 counts wide, so the next interrupt means the light moved by about pct percent.
+ *
+ * @param[in] pct
+ *   half width of the window in percent of the reading
+ *
+ ******************************************************************************/
+void veml_window_center(uint32_t pct) {
+	uint32_t light_data = sample_store_read(&light_record, 0);
+	uint32_t delta = (light_data * pct) / 100;
+	uint32_t low;
+	uint32_t high;
+
+	if(delta < VEML_WINDOW_MIN) {
+		delta = VEML_WINDOW_MIN;
+	}
+
+	low = (light_data > delta) ? light_data - delta : 0;
+	high = light_data + delta;
+	if(high > 0xFFFF) {
+		high = 0xFFFF;
+	}
+
+	veml_window_set(low, high);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   VEML Threshold Window Close Function
+ *
+ ******************************************************************************/
+void veml_window_close(void) {
+	veml_int_en = false;
+	veml_conf_write();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   VEML Interrupt Status Function
+ *
+ * @details
+ * 	 Reads ALS_INT, which also clears the status and releases the INT pin.
+ *
+ * @note
+ *   Blocks on the I2C0 bus.
+ *
+ * @return
+ *   VEML_INT_TH_HIGH and/or VEML_INT_TH_LOW
+ *
+ ******************************************************************************/
+uint32_t veml_int_status(void) {
+	while(check_busy(VEML_I2C));
+	i2c_start(VEML_I2C, VEML_ADDR, VEML_ALS_INT, VEML_RW_R, &status_data, 0, I2C_BYTES_2);
+	while(check_busy(VEML_I2C));
+
+	return status_data & (VEML_INT_TH_HIGH | VEML_INT_TH_LOW);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   VEML Integration Time Function
+ *
+ * @return
+ *   integration time of the current setting in milliseconds
+ *
+ ******************************************************************************/
+uint32_t veml_integration_ms(void) {
+	switch(veml_it) {
+		case VemlIt25:
+			return 25;
+		case VemlIt50:
+			return 50;
+		case VemlIt200:
+			return 200;
+		case VemlIt400:
+			return 400;
+		case VemlIt800:
+			return 800;
+		case VemlIt100:
+		default:
+			return 100;
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   VEML Burst Begin Function
+ *
+ * @details
+ * 	 Switches to the shortest integration time, keeping the gain, and turns power save
+ * 	 mode off so the VEML7700 does not idle between measurements.  A new reading is
+ * 	 then ready as often as the VEML7700 can make one.  That is 25 ms, 40 readings a
+ * 	 second, so nothing faster than 20 Hz can be resolved, and each reading is the
+ * 	 average over its 25 ms.
+ *
+ * @note
+ *   Blocks on the I2C0 bus.  The sensor engine must not read the VEML until
+ *   veml_burst_end().
+ *
+ * @return
+ *   period of the readings in milliseconds
+ *
+ ******************************************************************************/
+uint32_t veml_burst_begin(void) {
+	burst_saved_it = veml_it;
+	veml_it = VemlIt25;
+	veml_conf_write();
+	veml_write(VEML_PSM, veml_psm & ~VEML_PSM_EN);
+	return veml_integration_ms();
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   VEML Burst End Function
+ *
+ * @details
+ * 	 Restores the integration time and power save mode from before veml_burst_begin().
+ *
+ ******************************************************************************/
+void veml_burst_end(void) {
+	veml_it = burst_saved_it;
+	veml_conf_write();
+	veml_write(VEML_PSM, veml_psm);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   VEML Burst Read Function
+ *
+ * @details
+ * 	 The same read as veml_read() with its own done event, so burst readings do not go
+ * 	 to the sensor engine.  veml_counts() returns the result.
+ *
+ * @param[in] done_cb
+ *   event raised once the reading is in
+ *
+ ******************************************************************************/
+void veml_burst_read(uint32_t done_cb) {
+	i2c_read_record(VEML_I2C, VEML_ADDR, VEML_READ, &light_record, done_cb, I2C_BYTES_2);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the last raw ALS reading in counts
+ *
+ ******************************************************************************/
+uint32_t veml_counts(void) {
+	return sample_store_read(&light_record, 0);
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the lux per count of the current gain and integration time
+ *
+ ******************************************************************************/
+float veml_lux_per_count(void) {
+	return VEML_RES_MAX * (16.0 / veml_gain_x8(veml_gain)) * (800.0 / veml_integration_ms());
 }
 
 
@@ -85,13 +459,54 @@ void veml_write() {
  *
  * @details
  * 	 This function takes the light sensor measurement from the I2C peripheral and converts that value
- * 	 into a float lux value.
+ * 	 into a float lux value.  The lux per count scales from 0.0036 at gain x2 and 800 ms inversely with
+ * 	 both gain and integration time, and readings above 1000 lux get the polynomial correction from the
+ * 	 Vishay application note for the non-linearity at high illuminance.
  *
  * @note
  *   This function does not have any input values.
  *
  ******************************************************************************/
 float compute_lux() {
-	float result = light_data * 0.0576;
+	float result = sample_store_read(&light_record, 0) * veml_lux_per_count();
+
+	if(result > VEML_LINEAR_LUX) {
+		result = (((6.0135e-13 * result - 9.3924e-9) * result + 8.1488e-5) * result + 1.0023) * result;
+	}
 	return result;
 }
+
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the ALS gain in eighths
+ *
+ ******************************************************************************/
+uint32_t veml_gain_x8(VEML_GAIN gain) {
+	switch(gain) {
+		case VemlGain2:
+			return 16;
+		case VemlGain1_8:
+			return 1;
+		case VemlGain1_4:
+			return 2;
+		case VemlGain1:
+		default:
+			return 8;
+	}
+}
+
+
+/***************************************************************************//**
+ * @brief
+ *   Writes ALS_CONF_0 from the current gain, integration time and interrupt setting
+ *
+ ******************************************************************************/
+void veml_conf_write(void) {
+	uint32_t conf = ((uint32_t) veml_gain << VEML_CONF_GAIN_SHIFT) | ((uint32_t) veml_it << VEML_CONF_IT_SHIFT);
+
+	if(veml_int_en) {
+		conf |= (VEML_PERS_2 << VEML_CONF_PERS_SHIFT) | VEML_CONF_INT_EN;
+	}
+	veml_write(VEML_CONFIG, conf);
+}
@@ -58,11 +58,44 @@ int main(void)
 	  if (get_scheduled_events() & VEML_CB) {
 		  scheduled_veml_read_cb();
 	  }
+	  if (get_scheduled_events() & SENSOR_MEASURE_CB) {
+		  scheduled_sensor_measure_cb();
+	  }
+	  if (get_scheduled_events() & VEML_INT_CB) {
+		  scheduled_veml_int_cb();
+	  }
+	  if (get_scheduled_events() & SCHED_DUE_CB) {
+		  scheduled_sched_due_cb();
+	  }
+	  if (get_scheduled_events() & SENSOR_READY_CB) {
+		  scheduled_sensor_ready_cb();
+	  }
+	  if (get_scheduled_events() & BLE_LINK_CB) {
+		  scheduled_ble_link_cb();
+	  }
+	  if (get_scheduled_events() & BLE_DRAIN_CB) {
+		  scheduled_ble_drain_cb();
+	  }
+	  if (get_scheduled_events() & QUERY_TX_CB) {
+		  scheduled_query_tx_cb();
+	  }
+	  if (get_scheduled_events() & BURST_TICK_CB) {
+		  scheduled_burst_tick_cb();
+	  }
+	  if (get_scheduled_events() & BURST_READ_CB) {
+		  scheduled_burst_read_cb();
+	  }
+	  if (get_scheduled_events() & SAMPLE_DONE_CB) {
+		  scheduled_sample_done_cb();
+	  }
 	  if (get_scheduled_events() & BOOT_UP_CB) {
 		  scheduled_boot_up_cb();
 	  }
 	  if (get_scheduled_events() & BLE_TX_DONE_CB) {
 		  scheduled_ble_tx_done_cb();
 	  }
+	  if (get_scheduled_events() & BLE_RX_DONE_CB) {
+		  scheduled_ble_rx_done_cb();
+	  }
   }
 }